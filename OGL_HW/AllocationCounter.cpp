@@ -0,0 +1,101 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef COUNT_ALLOCATIONS
+
+namespace
+{
+	std::atomic<uint64_t> g_allocations{ 0 };
+	std::atomic<uint64_t> g_bytes{ 0 };
+
+	void* CountedAllocate(size_t size)
+	{
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+		g_bytes.fetch_add(size, std::memory_order_relaxed);
+		return std::malloc(size == 0 ? 1 : size);
+	}
+
+	void* CountedAllocateAligned(size_t size, size_t alignment)
+	{
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+		g_bytes.fetch_add(size, std::memory_order_relaxed);
+#ifdef _MSC_VER
+		return _aligned_malloc(size == 0 ? 1 : size, alignment);
+#else
+		// aligned_alloc wants a multiple of the alignment
+		return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+	}
+
+	void FreeAligned(void* pointer)
+	{
+#ifdef _MSC_VER
+		_aligned_free(pointer);
+#else
+		std::free(pointer);
+#endif
+	}
+}
+
+// the array, nothrow and sized forms of the standard library all end up in these
+void* operator new(size_t size)
+{
+	if (void* pointer = CountedAllocate(size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	if (void* pointer = CountedAllocateAligned(size, static_cast<size_t>(alignment)))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+	FreeAligned(pointer);
+}
+
+// the sized forms are chosen by the compiler when it knows the size, they must free the same way
+void operator delete(void* pointer, size_t) noexcept
+{
+	operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(pointer, alignment);
+}
+
+bool AllocationCounter::Enabled()
+{
+	return true;
+}
+
+AllocationCounter::Totals AllocationCounter::Now()
+{
+	return { g_allocations.load(std::memory_order_relaxed), g_bytes.load(std::memory_order_relaxed) };
+}
+
+#else
+
+bool AllocationCounter::Enabled()
+{
+	return false;
+}
+
+AllocationCounter::Totals AllocationCounter::Now()
+{
+	return { 0, 0 };
+}
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+	Counts every operator new of the process when built with COUNT_ALLOCATIONS (the Debug configurations
+	define it): the replacement operators in AllocationCounter.cpp bump two atomics and forward to malloc.
+	Memory that never goes through operator new (malloc in ImGui, SDL or the driver) is not seen.
+*/
+class AllocationCounter final
+{
+public:
+	struct Totals
+	{
+		uint64_t	allocations;
+		uint64_t	bytes;
+	};
+
+	static bool Enabled();
+	// since the start of the process, all threads
+	static Totals Now();
+};
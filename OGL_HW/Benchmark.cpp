@@ -0,0 +1,285 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "AllocationCounter.h"
+
+namespace
+{
+	bool ParseInt(const char* text, int minimum, int& value)
+	{
+		char* end = nullptr;
+		long parsed = std::strtol(text, &end, 10);
+		if (end == text || *end != '\0' || parsed < minimum)
+			return false;
+		value = static_cast<int>(parsed);
+		return true;
+	}
+
+	double Percentile(const std::vector<double>& sorted, double p)
+	{
+		size_t index = static_cast<size_t>(std::ceil(p * sorted.size())) - 1;
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	void WriteSamples(std::ostream& out, const std::vector<double>& values)
+	{
+		out << "[";
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			out << (i == 0 ? "" : ",");
+			if (std::isnan(values[i]))
+				out << "null";
+			else
+				out << values[i];
+		}
+		out << "]";
+	}
+}
+
+bool ParseBenchmarkOptions(int argc, char* argv[], BenchmarkOptions& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--benchmark")
+		{
+			options.enabled = true;
+			continue;
+		}
+		if (arg == "--job-benchmark")
+		{
+			options.jobBenchmark = true;
+			continue;
+		}
+		if (arg == "--zero-allocations")
+		{
+			options.requireZeroAllocations = true;
+			continue;
+		}
+		if (arg == "--serial-update")
+		{
+			options.serialUpdate = true;
+			continue;
+		}
+
+		if (i + 1 == argc)
+		{
+			std::cerr << "[Benchmark] " << arg << " is unknown or misses its value" << std::endl;
+			return false;
+		}
+		const char* value = argv[++i];
+
+		bool valid = true;
+		if (arg == "--frames")
+			valid = ParseInt(value, 1, options.frames);
+		else if (arg == "--warmup")
+			valid = ParseInt(value, 0, options.warmupFrames);
+		else if (arg == "--seed")
+		{
+			int seed = 0;
+			valid = ParseInt(value, 0, seed);
+			options.seed = static_cast<unsigned int>(seed);
+		}
+		else if (arg == "--camera")
+			options.cameraPath = value;
+		else if (arg == "--out")
+			options.outputFile = value;
+		else if (arg == "--capture")
+			valid = ParseInt(value, 0, options.captureInterval);
+		else if (arg == "--workers")
+			valid = ParseInt(value, 0, options.workerThreads);
+		else if (arg == "--size")
+		{
+			std::string size = value;
+			size_t x = size.find('x');
+			valid = x != std::string::npos
+				&& ParseInt(size.substr(0, x).c_str(), 1, options.width)
+				&& ParseInt(size.substr(x + 1).c_str(), 1, options.height);
+		}
+		else if (arg == "--swap")
+		{
+			std::string mode = value;
+			options.swapMode = mode == "immediate" ? 0 : (mode == "vsync" ? 1 : (mode == "adaptive" ? 2 : -1));
+			valid = options.swapMode >= 0;
+		}
+		else if (arg == "--frames-in-flight")
+			valid = ParseInt(value, 1, options.framesInFlight) && options.framesInFlight <= 4;
+		else if (arg == "--frame-cap")
+		{
+			char* end = nullptr;
+			options.frameCap = std::strtod(value, &end);
+			valid = end != value && *end == '\0' && options.frameCap >= 0.0;
+		}
+		else if (arg == "--timestep")
+		{
+			char* end = nullptr;
+			options.timestep = std::strtod(value, &end);
+			valid = end != value && *end == '\0' && options.timestep > 0.0;
+		}
+		else
+		{
+			std::cerr << "[Benchmark] Unknown argument " << arg << std::endl;
+			return false;
+		}
+
+		if (!valid)
+		{
+			std::cerr << "[Benchmark] Bad value for " << arg << ": " << value << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+BenchmarkReport::BenchmarkReport(const BenchmarkOptions& options) : m_options(options)
+{
+	m_cpuMs.assign(options.frames, std::numeric_limits<double>::quiet_NaN());
+	m_gpuMs.assign(options.frames, std::numeric_limits<double>::quiet_NaN());
+	m_allocations.assign(options.frames, std::numeric_limits<double>::quiet_NaN());
+	m_frameMs.assign(options.frames, std::numeric_limits<double>::quiet_NaN());
+	m_latencyMs.assign(options.frames, std::numeric_limits<double>::quiet_NaN());
+}
+
+void BenchmarkReport::AddCpuTime(uint64_t frame, double ms)
+{
+	if (frame >= static_cast<uint64_t>(m_options.warmupFrames) && frame - m_options.warmupFrames < m_cpuMs.size())
+		m_cpuMs[frame - m_options.warmupFrames] = ms;
+}
+
+void BenchmarkReport::AddGpuTime(uint64_t frame, double ms)
+{
+	if (frame >= static_cast<uint64_t>(m_options.warmupFrames) && frame - m_options.warmupFrames < m_gpuMs.size())
+		m_gpuMs[frame - m_options.warmupFrames] = ms;
+}
+
+void BenchmarkReport::AddAllocations(uint64_t frame, uint64_t allocations)
+{
+	if (frame >= static_cast<uint64_t>(m_options.warmupFrames) && frame - m_options.warmupFrames < m_allocations.size())
+		m_allocations[frame - m_options.warmupFrames] = static_cast<double>(allocations);
+}
+
+void BenchmarkReport::AddPacing(uint64_t frame, double frameMs, double latencyMs)
+{
+	if (frame >= static_cast<uint64_t>(m_options.warmupFrames) && frame - m_options.warmupFrames < m_frameMs.size())
+	{
+		m_frameMs[frame - m_options.warmupFrames] = frameMs;
+		m_latencyMs[frame - m_options.warmupFrames] = latencyMs;
+	}
+}
+
+bool BenchmarkReport::CheckAllocations() const
+{
+	if (!m_options.requireZeroAllocations)
+		return true;
+	if (!AllocationCounter::Enabled())
+	{
+		std::cerr << "[Benchmark] --zero-allocations needs a build with COUNT_ALLOCATIONS" << std::endl;
+		return false;
+	}
+
+	double total = 0;
+	int frames = 0;
+	for (double allocations : m_allocations)
+	{
+		if (!std::isnan(allocations) && allocations > 0)
+		{
+			total += allocations;
+			++frames;
+		}
+	}
+	if (frames > 0)
+		std::cerr << "[Benchmark] " << total << " allocations in " << frames << " of the measured frames" << std::endl;
+	return frames == 0;
+}
+
+BenchmarkReport::Summary BenchmarkReport::Summarize(std::vector<double> values)
+{
+	values.erase(std::remove_if(values.begin(), values.end(), [](double value) { return std::isnan(value); }), values.end());
+
+	Summary summary{};
+	if (values.empty())
+		return summary;
+
+	double sum = 0;
+	for (double value : values)
+		sum += value;
+	summary.average = sum / values.size();
+
+	std::sort(values.begin(), values.end());
+	summary.p50 = Percentile(values, 0.50);
+	summary.p95 = Percentile(values, 0.95);
+	summary.p99 = Percentile(values, 0.99);
+	summary.max = values.back();
+
+	double squares = 0;
+	for (double value : values)
+		squares += (value - summary.average) * (value - summary.average);
+	summary.stdDev = std::sqrt(squares / values.size());
+	return summary;
+}
+
+bool BenchmarkReport::Write(const std::string& renderer) const
+{
+	std::ofstream out(m_options.outputFile);
+	if (!out.is_open())
+	{
+		std::cerr << "[Benchmark] Cannot write " << m_options.outputFile << std::endl;
+		return false;
+	}
+
+	out << "{\n";
+	out << "\t\"renderer\": \"";
+	for (char c : renderer)
+		out << (c == '"' || c == '\\' ? "\\" : "") << c;
+	out << "\",\n";
+	out << "\t\"frames\": " << m_options.frames << ",\n";
+	out << "\t\"warmup_frames\": " << m_options.warmupFrames << ",\n";
+	out << "\t\"seed\": " << m_options.seed << ",\n";
+	out << "\t\"width\": " << m_options.width << ",\n";
+	out << "\t\"height\": " << m_options.height << ",\n";
+	out << "\t\"timestep\": " << m_options.timestep << ",\n";
+	out << "\t\"simulation_thread\": " << (m_options.serialUpdate ? "false" : "true") << ",\n";
+	out << "\t\"swap\": \"" << (m_options.swapMode == 1 ? "vsync" : (m_options.swapMode == 2 ? "adaptive" : "immediate")) << "\",\n";
+	out << "\t\"frames_in_flight\": " << m_options.framesInFlight << ",\n";
+	out << "\t\"frame_cap\": " << m_options.frameCap << ",\n";
+
+	for (const auto& series : { std::make_pair("cpu", &m_cpuMs), std::make_pair("gpu", &m_gpuMs),
+								std::make_pair("frame", &m_frameMs), std::make_pair("latency", &m_latencyMs) })
+	{
+		Summary summary = Summarize(*series.second);
+		out << "\t\"" << series.first << "_ms\": { \"avg\": " << summary.average << ", \"p50\": " << summary.p50
+			<< ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max
+			<< ", \"std_dev\": " << summary.stdDev << " },\n";
+	}
+
+	if (AllocationCounter::Enabled())
+	{
+		Summary summary = Summarize(m_allocations);
+		out << "\t\"allocations\": { \"avg\": " << summary.average << ", \"p50\": " << summary.p50
+			<< ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << " },\n";
+	}
+
+	out << "\t\"per_frame\": {\n\t\t\"cpu_ms\": ";
+	WriteSamples(out, m_cpuMs);
+	out << ",\n\t\t\"gpu_ms\": ";
+	WriteSamples(out, m_gpuMs);
+	out << ",\n\t\t\"frame_ms\": ";
+	WriteSamples(out, m_frameMs);
+	out << ",\n\t\t\"latency_ms\": ";
+	WriteSamples(out, m_latencyMs);
+	if (AllocationCounter::Enabled())
+	{
+		out << ",\n\t\t\"allocations\": ";
+		WriteSamples(out, m_allocations);
+	}
+	out << "\n\t}\n}\n";
+
+	std::cout << "Benchmark report written to " << m_options.outputFile << std::endl;
+	return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+	Headless benchmark runs: "--benchmark" renders a fixed number of frames offscreen (an EGL pbuffer, or a
+	hidden window where that is not available) without vsync, with a fixed timestep, a seeded scene and the camera flying along a path, so that two runs of the
+	same build render the same frames. Per frame CPU and GPU times, frame-to-frame times and input latency
+	(see FramePacer) are written as JSON with a summary.
+
+	--benchmark				turn the mode on
+	--frames <n>			measured frames (default 1800, one loop of the default path at 60 Hz)
+	--warmup <n>			frames rendered before measuring (default 60)
+	--seed <n>				seed of the scene's random numbers (default 1)
+	--camera <file>			camera path, see CameraPath.h (default: built-in loop)
+	--size <w>x<h>			framebuffer size (default 1280x720)
+	--timestep <seconds>	simulated time per frame (default 1/60)
+	--out <file>			JSON report (default benchmark.json)
+	--capture <n>			write every n-th measured frame to benchmark_<frame>.tga (default 0, none)
+	--workers <n>			job system worker threads (default: one per hardware thread besides the main one)
+	--zero-allocations		fail (exit code 1) if a measured frame allocated; needs a COUNT_ALLOCATIONS build
+	--serial-update			run CMyApp::Update on the main thread before Render instead of on the simulation thread
+							(the CPU times are the main thread's, so with the thread they leave the simulation out)
+
+	These also apply outside benchmark runs:
+	--swap <mode>			immediate, vsync or adaptive (default: immediate when benchmarking, vsync otherwise)
+	--frames-in-flight <n>	frames the GPU may be behind, 1 to 4 (default 2)
+	--frame-cap <fps>		frames per second at most (default 0, no cap)
+
+	--job-benchmark			only time the job system on 1 to 64 threads, checking every result, and exit
+*/
+struct BenchmarkOptions
+{
+	bool			enabled = false;
+	int				frames = 1800;
+	int				warmupFrames = 60;
+	unsigned int	seed = 1;
+	std::string		cameraPath;
+	int				width = 1280;
+	int				height = 720;
+	double			timestep = 1.0 / 60.0;
+	std::string		outputFile = "benchmark.json";
+	int				captureInterval = 0;
+	int				workerThreads = -1;		// job system workers, negative: one per other hardware thread
+	bool			jobBenchmark = false;	// only run JobSystem::RunScalingBenchmark
+	bool			requireZeroAllocations = false;
+	bool			serialUpdate = false;	// no simulation thread
+	int				swapMode = -1;			// a SwapMode, negative: the default of the mode
+	int				framesInFlight = 2;
+	double			frameCap = 0.0;
+};
+
+// false (after printing why) on an unknown or malformed argument
+bool ParseBenchmarkOptions(int argc, char* argv[], BenchmarkOptions& options);
+
+class BenchmarkReport final
+{
+public:
+	explicit BenchmarkReport(const BenchmarkOptions& options);
+
+	// frames are numbered from the first rendered one, warm-up frames are ignored
+	void AddCpuTime(uint64_t frame, double ms);
+	void AddGpuTime(uint64_t frame, double ms);
+	void AddAllocations(uint64_t frame, uint64_t allocations);
+	void AddPacing(uint64_t frame, double frameMs, double latencyMs);
+
+	// false (after printing why) if --zero-allocations was given and a measured frame allocated
+	bool CheckAllocations() const;
+
+	bool Write(const std::string& renderer) const;
+
+private:
+	struct Summary
+	{
+		double	average;
+		double	p50;
+		double	p95;
+		double	p99;
+		double	max;
+		double	stdDev;
+	};
+
+	static Summary Summarize(std::vector<double> values);
+
+	BenchmarkOptions		m_options;
+	std::vector<double>		m_cpuMs;	// NaN where a frame was not measured
+	std::vector<double>		m_gpuMs;
+	std::vector<double>		m_allocations;	// operator new calls, only with COUNT_ALLOCATIONS
+	std::vector<double>		m_frameMs;		// from the frame's start to the next one's
+	std::vector<double>		m_latencyMs;
+};
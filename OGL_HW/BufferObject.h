@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "GLconversions.hpp"
+#include "GpuResources.h"
 
 /*
 	BufferType is an enum class that stands for OpenGL bind targets (from https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBufferData.xhtml - OpenGL 4.6)
@@ -64,15 +65,30 @@ public:
 
 	void Clean();
 
+	// the name the buffer is listed under in GpuResources
+	void SetOwner(const std::string& owner) { GpuResources::SetOwner(GpuResources::Kind::Buffer, m_id, owner); }
+
+	// with direct state access these edit the buffer by name, otherwise they bind it to the target and leave it bound
 	template <typename T>
 	IsContiguousContainer<T> BufferData(const T& pArr);
 
 	void BufferData(GLsizeiptr pSize, const GLvoid* pSource = nullptr);
 
+	// immutable storage for data that is given once: the buffer cannot be respecified afterwards, and without
+	// GL_DYNAMIC_STORAGE_BIT in pFlags not updated either. Falls back to BufferData without ARB_buffer_storage
+	template <typename T>
+	IsContiguousContainer<T> BufferStorage(const T& pArr, GLbitfield pFlags = 0);
+
+	void BufferStorage(GLsizeiptr pSize, const GLvoid* pSource, GLbitfield pFlags = 0);
+
 	void BufferSubData(GLintptr pOffset, GLsizeiptr pSize, const GLvoid* pSource = nullptr);
 
 	inline void Bind() const;
 
+	// binds the buffer (or a range of it) to an indexed binding point, e.g. the binding point of a uniform block
+	inline void BindBase(GLuint pIndex) const;
+	inline void BindRange(GLuint pIndex, GLintptr pOffset, GLsizeiptr pSize) const;
+
 	template <typename T>
 	BufferObject& operator=(const T& pArr);
 
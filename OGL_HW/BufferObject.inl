@@ -9,7 +9,7 @@ GLuint BufferObject<target, usage>::g_lastBound = 0;
 template<BufferType target, BufferUsage usage>
 inline BufferObject<target, usage>::BufferObject()
 {
-	glGenBuffers(1, &m_id);
+	m_id = GpuResources::CreateBuffer("BufferObject");
 }
 
 template<BufferType target, BufferUsage usage>
@@ -23,10 +23,7 @@ inline BufferObject<target, usage>::~BufferObject()
 template<BufferType target, BufferUsage usage>
 inline void BufferObject<target, usage>::Clean()
 {
-	if (m_id != 0 && m_sizeInBytes != 0)
-	{
-		glDeleteBuffers(1, &m_id);
-	}
+	GpuResources::DeleteBuffer(m_id);
 }
 
 template<BufferType target, BufferUsage usage>
@@ -54,19 +51,37 @@ inline BufferObject<target, usage> & BufferObject<target, usage>::operator=(Buff
 template<BufferType target, BufferUsage usage>
 inline void BufferObject<target, usage>::BufferData(GLsizeiptr pSize, const GLvoid * pSource)
 {
-	Bind();
+	if (GpuResources::DirectStateAccess())
+		GpuResources::NamedBufferData(m_id, pSize, pSource, static_cast<GLenum>(usage));
+	else
+		GpuResources::BufferData(static_cast<GLenum>(target), m_id, pSize, pSource, static_cast<GLenum>(usage));
+	m_sizeInBytes = pSize;
+}
 
-	glBufferData(static_cast<GLenum>(target), pSize, pSource, static_cast<GLenum>(usage) );
+template<BufferType target, BufferUsage usage>
+inline void BufferObject<target, usage>::BufferStorage(GLsizeiptr pSize, const GLvoid * pSource, GLbitfield pFlags)
+{
+	if (GpuResources::DirectStateAccess())
+		GpuResources::NamedBufferStorage(m_id, pSize, pSource, pFlags);
+	else if (GLEW_ARB_buffer_storage)
+		GpuResources::BufferStorage(static_cast<GLenum>(target), m_id, pSize, pSource, pFlags);
+	else
+		GpuResources::BufferData(static_cast<GLenum>(target), m_id, pSize, pSource, static_cast<GLenum>(usage));
 	m_sizeInBytes = pSize;
 }
 
 template<BufferType target, BufferUsage usage>
 inline void BufferObject<target, usage>::BufferSubData(GLintptr pOffset, GLsizeiptr pSize, const GLvoid * pSource)
 {
+	if (GpuResources::DirectStateAccess())
+	{
+		glNamedBufferSubData(m_id, pOffset, pSize, pSource);
+		return;
+	}
+
 	Bind();
 
 	glBufferSubData(static_cast<GLenum>(target), pOffset, pSize, pSource);
-	m_sizeInBytes = pSize;
 }
 
 #include <iostream>
@@ -87,16 +102,28 @@ inline void BufferObject<target, usage>::Bind() const
 	*/
 }
 
+template<BufferType target, BufferUsage usage>
+inline void BufferObject<target, usage>::BindBase(GLuint pIndex) const
+{
+	glBindBufferBase(static_cast<GLenum>(target), pIndex, m_id);
+}
+
+template<BufferType target, BufferUsage usage>
+inline void BufferObject<target, usage>::BindRange(GLuint pIndex, GLintptr pOffset, GLsizeiptr pSize) const
+{
+	glBindBufferRange(static_cast<GLenum>(target), pIndex, m_id, pOffset, pSize);
+}
+
 template<BufferType target, BufferUsage usage>
 template<typename T>
-inline BufferObject<target, usage>::BufferObject(const std::vector<T>& pArr)
+inline BufferObject<target, usage>::BufferObject(const std::vector<T>& pArr) : BufferObject()
 {
 	BufferData(ContainerSizeInBytes(pArr), (const void*)(&(pArr[0])));
 }
 
 template<BufferType target, BufferUsage usage>
 template<typename T, size_t N>
-inline BufferObject<target, usage>::BufferObject(const std::array<T, N>& pArr)
+inline BufferObject<target, usage>::BufferObject(const std::array<T, N>& pArr) : BufferObject()
 {
 	BufferData(ContainerSizeInBytes(pArr), (const void*)(&(pArr[0])));
 }
@@ -108,6 +135,13 @@ inline IsContiguousContainer<T> BufferObject<target, usage>::BufferData(const T
 	BufferData(ContainerSizeInBytes(pArr), PointerToStart(pArr));
 }
 
+template<BufferType target, BufferUsage usage>
+template<typename T>
+inline IsContiguousContainer<T> BufferObject<target, usage>::BufferStorage(const T & pArr, GLbitfield pFlags)
+{
+	BufferStorage(ContainerSizeInBytes(pArr), PointerToStart(pArr), pFlags);
+}
+
 template<BufferType target, BufferUsage usage>
 template<typename T>
 inline BufferObject<target, usage>& BufferObject<target, usage>::operator=(const T & pArr)
@@ -123,14 +157,19 @@ template<BufferType target, BufferUsage usage>
 template<typename T>
 inline BufferObject<target, usage>::operator std::vector<T>() const
 {
-	Bind();
+	const bool dsa = GpuResources::DirectStateAccess();
+	if (!dsa)
+		Bind();
 
-	T* ptr = static_cast<T*>(glMapBuffer(static_cast<GLenum>(target), GL_READ_ONLY));
+	T* ptr = static_cast<T*>(dsa ? glMapNamedBufferRange(m_id, 0, m_sizeInBytes, GL_MAP_READ_BIT) : glMapBuffer(static_cast<GLenum>(target), GL_READ_ONLY));
 
 	std::vector<T> ret{};
 	ret.assign(ptr, ptr + m_sizeInBytes / sizeof(T));
 
-	glUnmapBuffer(static_cast<GLenum>(target));
+	if (dsa)
+		glUnmapNamedBuffer(m_id);
+	else
+		glUnmapBuffer(static_cast<GLenum>(target));
 
 	return ret;
 }
@@ -139,9 +178,11 @@ template<BufferType target, BufferUsage usage>
 template<typename T, size_t N>
 inline BufferObject<target, usage>::operator std::array<T, N>() const
 {
-	Bind();
+	const bool dsa = GpuResources::DirectStateAccess();
+	if (!dsa)
+		Bind();
 
-	T* ptr = static_cast<T*>(glMapBuffer(static_cast<GLenum>(target), GL_READ_ONLY));
+	T* ptr = static_cast<T*>(dsa ? glMapNamedBufferRange(m_id, 0, m_sizeInBytes, GL_MAP_READ_BIT) : glMapBuffer(static_cast<GLenum>(target), GL_READ_ONLY));
 
 	std::array<T, N> ret{};
 	const size_t elementCount = m_sizeInBytes / sizeof(T);
@@ -151,7 +192,10 @@ inline BufferObject<target, usage>::operator std::array<T, N>() const
 	else
 		std::copy(ptr, ptr + m_sizeInBytes / sizeof(T), ret.begin());
 
-	glUnmapBuffer(static_cast<GLenum>(target));
+	if (dsa)
+		glUnmapNamedBuffer(m_id);
+	else
+		glUnmapBuffer(static_cast<GLenum>(target));
 
 	return ret;
 }
@@ -0,0 +1,101 @@
+#include "CameraPath.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	glm::vec3 CatmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+	}
+}
+
+CameraPath CameraPath::Default()
+{
+	CameraPath path;
+	path.AddKey(glm::vec3(  250,  90,    0), glm::vec3(  0, 10,    0));
+	path.AddKey(glm::vec3(  150,  40,  150), glm::vec3(-30,  5,   30));
+	path.AddKey(glm::vec3(    0,  25,  220), glm::vec3(  0,  5,    0));
+	path.AddKey(glm::vec3( -120,  15,  100), glm::vec3(-40,  8,  -20));
+	path.AddKey(glm::vec3( -220,  60,    0), glm::vec3(  0, 10,    0));
+	path.AddKey(glm::vec3( -100, 120, -200), glm::vec3( 30,  0,    0));
+	path.AddKey(glm::vec3(   60,  20, -120), glm::vec3( 20,  5,   40));
+	path.AddKey(glm::vec3(  200,  50, -150), glm::vec3(  0, 10,    0));
+	path.SetDuration(30.0f);
+	return path;
+}
+
+bool CameraPath::LoadFromFile(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if (!file.is_open())
+	{
+		std::cerr << "[CameraPath] Cannot open " << filename << std::endl;
+		return false;
+	}
+
+	std::vector<Key> keys;
+	float duration = m_duration;
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+	{
+		std::istringstream stream(line);
+		std::string first;
+		if (!(stream >> first) || first[0] == '#')
+			continue;
+
+		if (first == "duration")
+		{
+			if (!(stream >> duration) || duration <= 0.0f)
+			{
+				std::cerr << "[CameraPath] " << filename << ":" << lineNumber << ": bad duration" << std::endl;
+				return false;
+			}
+			continue;
+		}
+
+		Key key;
+		stream.seekg(0);
+		if (!(stream >> key.eye.x >> key.eye.y >> key.eye.z >> key.at.x >> key.at.y >> key.at.z))
+		{
+			std::cerr << "[CameraPath] " << filename << ":" << lineNumber << ": expected \"eye.x eye.y eye.z at.x at.y at.z\"" << std::endl;
+			return false;
+		}
+		keys.push_back(key);
+	}
+
+	if (keys.size() < 2)
+	{
+		std::cerr << "[CameraPath] " << filename << " needs at least two keys" << std::endl;
+		return false;
+	}
+
+	m_keys = std::move(keys);
+	m_duration = duration;
+	return true;
+}
+
+CameraPath::Key CameraPath::Sample(float time) const
+{
+	if (m_keys.size() < 2)
+		return m_keys.empty() ? Key{ glm::vec3(0, 0, 1), glm::vec3(0) } : m_keys[0];
+
+	float loop = time / m_duration;
+	float position = (loop - std::floor(loop)) * m_keys.size();
+	int segment = static_cast<int>(position);
+	float t = position - segment;
+
+	int count = static_cast<int>(m_keys.size());
+	auto key = [&](int offset) -> const Key& { return m_keys[(segment + offset + count) % count]; };
+
+	return {
+		CatmullRom(key(-1).eye, key(0).eye, key(1).eye, key(2).eye, t),
+		CatmullRom(key(-1).at, key(0).at, key(1).at, key(2).at, t)
+	};
+}
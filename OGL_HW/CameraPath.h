@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+	A closed camera flythrough: the eye and the look-at point each follow a Catmull-Rom spline through
+	the keys, which are spaced evenly in time over one loop of Duration() seconds.
+
+	The file format has one key per line, "eye.x eye.y eye.z at.x at.y at.z"; an optional
+	"duration <seconds>" line sets the loop length, and lines starting with '#' are comments.
+*/
+class CameraPath final
+{
+public:
+	struct Key
+	{
+		glm::vec3	eye;
+		glm::vec3	at;
+	};
+
+	// a loop around the island, used when no path is given
+	static CameraPath Default();
+
+	bool LoadFromFile(const std::string& filename);
+
+	void AddKey(const glm::vec3& eye, const glm::vec3& at) { m_keys.push_back({ eye, at }); }
+	void SetDuration(float seconds) { m_duration = seconds; }
+	float Duration() const { return m_duration; }
+	bool Empty() const { return m_keys.empty(); }
+
+	// the time wraps around, so the path can be played for longer than one loop
+	Key Sample(float time) const;
+
+private:
+	std::vector<Key>	m_keys;
+	float				m_duration = 30.0f;
+};
@@ -0,0 +1,143 @@
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+struct CpuProfiler::ThreadBuffer
+{
+	std::mutex									mutex;
+	std::array<Event, EVENTS_PER_THREAD>		events;
+	size_t										written = 0;	// total, the ring holds the last EVENTS_PER_THREAD
+	uint32_t									id = 0;
+	std::string									name;
+};
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	const Clock::time_point g_epoch = Clock::now();
+
+	// one copy of every detail ever recorded, node based so the pointers handed out stay valid
+	std::mutex g_detailsMutex;
+	const char* InternDetail(const char* detail)
+	{
+		static std::unordered_set<std::string> details;
+		std::lock_guard<std::mutex> lock(g_detailsMutex);
+		return details.emplace(detail).first->c_str();
+	}
+
+	// buffers live until exit, so a trace can still show threads that have finished
+	std::mutex g_buffersMutex;
+	std::vector<std::unique_ptr<CpuProfiler::ThreadBuffer>>& Buffers()
+	{
+		static std::vector<std::unique_ptr<CpuProfiler::ThreadBuffer>> buffers;
+		return buffers;
+	}
+
+	void WriteJsonString(std::ostream& out, const char* str)
+	{
+		out << '"';
+		for (; *str != '\0'; ++str)
+		{
+			if (*str == '"' || *str == '\\')
+				out << '\\';
+			out << *str;
+		}
+		out << '"';
+	}
+
+	// trace-event times are microseconds, the fraction keeps the nanoseconds
+	void WriteMicroseconds(std::ostream& out, uint64_t ns)
+	{
+		out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+	}
+}
+
+uint64_t CpuProfiler::Now()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - g_epoch).count());
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::LocalBuffer()
+{
+	thread_local ThreadBuffer* buffer = nullptr;
+	if (buffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(g_buffersMutex);
+		Buffers().push_back(std::make_unique<ThreadBuffer>());
+		buffer = Buffers().back().get();
+		buffer->id = static_cast<uint32_t>(Buffers().size());
+		buffer->name = "thread " + std::to_string(buffer->id);
+	}
+	return *buffer;
+}
+
+void CpuProfiler::Record(const char* name, const char* detail, uint64_t beginNs, uint64_t endNs)
+{
+	if (detail != nullptr)
+		detail = InternDetail(detail);
+
+	ThreadBuffer& buffer = LocalBuffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.events[buffer.written % EVENTS_PER_THREAD] = { name, detail, beginNs, endNs };
+	++buffer.written;
+}
+
+void CpuProfiler::SetThreadName(const std::string& name)
+{
+	ThreadBuffer& buffer = LocalBuffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.name = name;
+}
+
+bool CpuProfiler::WriteChromeTrace(const std::string& filename)
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		std::cerr << "[CpuProfiler] Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	bool first = true;
+
+	std::lock_guard<std::mutex> buffersLock(g_buffersMutex);
+	for (const std::unique_ptr<ThreadBuffer>& buffer : Buffers())
+	{
+		std::lock_guard<std::mutex> lock(buffer->mutex);
+
+		file << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+		WriteJsonString(file, buffer->name.c_str());
+		file << "}}";
+		first = false;
+
+		size_t count = std::min(buffer->written, EVENTS_PER_THREAD);
+		for (size_t i = buffer->written - count; i < buffer->written; ++i)
+		{
+			const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+			file << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":";
+			WriteMicroseconds(file, event.beginNs);
+			file << ",\"dur\":";
+			WriteMicroseconds(file, event.endNs - event.beginNs);
+			file << ",\"name\":";
+			WriteJsonString(file, event.name);
+			if (event.detail != nullptr)
+			{
+				file << ",\"args\":{\"detail\":";
+				WriteJsonString(file, event.detail);
+				file << "}";
+			}
+			file << "}";
+		}
+	}
+
+	file << "\n]}\n";
+	return true;
+}
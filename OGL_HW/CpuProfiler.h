@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/*
+	Scoped CPU zones. Every thread writes the zones it closes into its own fixed size ring buffer (the oldest
+	zones are overwritten), so recording is a clock read on entry and one on exit plus an uncontended lock.
+	WriteChromeTrace dumps every thread's buffer as trace-event JSON for chrome://tracing or Perfetto.
+
+	Zone names are not copied: they have to be string literals or outlive the dump. Details are copied once
+	per distinct string when the zone closes and kept until exit, so they only have to live as long as the
+	zone, but should come from a small set (file names, pass names).
+*/
+class CpuProfiler final
+{
+public:
+	static const size_t EVENTS_PER_THREAD = 1 << 16;
+
+	struct Event
+	{
+		const char*	name;
+		const char*	detail;
+		uint64_t	beginNs;
+		uint64_t	endNs;
+	};
+
+	// nanoseconds since the profiler's epoch (first use)
+	static uint64_t Now();
+
+	static void Record(const char* name, const char* detail, uint64_t beginNs, uint64_t endNs);
+
+	// the name shown for the calling thread in the trace
+	static void SetThreadName(const std::string& name);
+
+	static bool WriteChromeTrace(const std::string& filename);
+
+	struct ThreadBuffer;
+
+private:
+	static ThreadBuffer& LocalBuffer();
+};
+
+class CpuZone final
+{
+public:
+	explicit CpuZone(const char* name, const char* detail = nullptr) : m_name(name), m_detail(detail), m_begin(CpuProfiler::Now()) {}
+	~CpuZone() { CpuProfiler::Record(m_name, m_detail, m_begin, CpuProfiler::Now()); }
+
+	CpuZone(const CpuZone&)				= delete;
+	CpuZone& operator=(const CpuZone&)	= delete;
+
+private:
+	const char*	m_name;
+	const char*	m_detail;
+	uint64_t	m_begin;
+};
+
+#define CPU_ZONE_CONCAT_INNER(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b) CPU_ZONE_CONCAT_INNER(a, b)
+// times the rest of the enclosing scope
+#define CPU_ZONE(...) CpuZone CPU_ZONE_CONCAT(cpuZone, __LINE__)(__VA_ARGS__)
@@ -0,0 +1,52 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+
+FrameArena::FrameArena(size_t capacity) : m_capacity(capacity)
+{
+	m_blocks.push_back({ std::make_unique<unsigned char[]>(capacity), capacity });
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	Block* block = &m_blocks.back();
+	size_t aligned = (m_offset + alignment - 1) / alignment * alignment;
+	if (aligned + bytes > block->size)
+	{
+		if (m_blocks.size() == 1)
+			++m_overflows;
+
+		// at least as large as the regular block, alignment to spare
+		size_t size = std::max(m_capacity, bytes + alignment);
+		m_blocks.push_back({ std::make_unique<unsigned char[]>(size), size });
+		block = &m_blocks.back();
+		m_offset = 0;
+		aligned = 0;
+	}
+
+	// new[] only guarantees the fundamental alignment of the block start
+	unsigned char* base = block->memory.get();
+	size_t misalignment = reinterpret_cast<size_t>(base + aligned) % alignment;
+	if (misalignment != 0)
+		aligned += alignment - misalignment;
+
+	m_offset = aligned + bytes;
+	m_used += bytes;
+	return base + aligned;
+}
+
+void FrameArena::Reset()
+{
+	m_highWater = std::max(m_highWater, m_used);
+
+	// the overflow is folded into one block that holds the largest frame seen, with some headroom
+	if (m_blocks.size() > 1)
+	{
+		m_capacity = std::max(m_capacity, m_highWater + m_highWater / 2);
+		m_blocks.clear();
+		m_blocks.push_back({ std::make_unique<unsigned char[]>(m_capacity), m_capacity });
+	}
+
+	m_offset = 0;
+	m_used = 0;
+}
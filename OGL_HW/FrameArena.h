@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+	Bump allocator for data that lives for one frame (draw lists, culling output, uniform staging): Allocate
+	only advances an offset, and Reset at the start of the next frame releases everything at once. No
+	destructors run, so only trivially destructible types belong here.
+
+	A frame that needs more than the block chains overflow blocks on; the next Reset replaces them all by one
+	block large enough for that frame, so after the first few frames the arena itself never allocates.
+*/
+class FrameArena final
+{
+public:
+	explicit FrameArena(size_t capacity = 1 << 20);
+
+	FrameArena(const FrameArena&)				= delete;
+	FrameArena& operator=(const FrameArena&)	= delete;
+
+	void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+	// uninitialized storage for count Ts
+	template <typename T>
+	T* AllocateArray(size_t count);
+
+	void Reset();
+
+	size_t Used() const { return m_used; }
+	size_t Capacity() const { return m_capacity; }
+	// most used by a single frame so far
+	size_t HighWater() const { return m_highWater; }
+	// frames that did not fit into the block
+	size_t Overflows() const { return m_overflows; }
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]>	memory;
+		size_t								size;
+	};
+
+	std::vector<Block>	m_blocks;			// the first one is kept across frames, the rest are overflow
+	size_t				m_offset = 0;		// into the last block
+	size_t				m_capacity;
+	size_t				m_used = 0;
+	size_t				m_highWater = 0;
+	size_t				m_overflows = 0;
+};
+
+// lets standard containers take their storage from a FrameArena, e.g. std::vector<T, FrameAllocator<T>>
+template <typename T>
+class FrameAllocator
+{
+public:
+	using value_type = T;
+
+	explicit FrameAllocator(FrameArena& arena) : m_arena(&arena) {}
+	template <typename U>
+	FrameAllocator(const FrameAllocator<U>& other) : m_arena(other.Arena()) {}
+
+	T* allocate(size_t count) { return m_arena->AllocateArray<T>(count); }
+	void deallocate(T*, size_t) {}
+
+	FrameArena* Arena() const { return m_arena; }
+
+	template <typename U>
+	bool operator==(const FrameAllocator<U>& other) const { return m_arena == other.Arena(); }
+	template <typename U>
+	bool operator!=(const FrameAllocator<U>& other) const { return m_arena != other.Arena(); }
+
+private:
+	FrameArena*	m_arena;
+};
+
+#include "FrameArena.inl"
@@ -0,0 +1,8 @@
+#include <type_traits>
+
+template <typename T>
+inline T* FrameArena::AllocateArray(size_t count)
+{
+	static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+	return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+}
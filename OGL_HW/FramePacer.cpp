@@ -0,0 +1,206 @@
+#include "FramePacer.h"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#include <imgui/imgui.h>
+
+#include "CpuProfiler.h"
+
+namespace
+{
+	// the cap sleeps until this close to the deadline, then yields, because sleeps overshoot
+	const uint64_t CAP_SPIN_NS = 1000000;
+
+	double Percentile(const std::vector<float>& sorted, double p)
+	{
+		size_t index = static_cast<size_t>(std::ceil(p * sorted.size())) - 1;
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+}
+
+FramePacer::FramePacer()
+{
+	m_frameMs.fill(std::numeric_limits<float>::quiet_NaN());
+	m_latencyMs.fill(std::numeric_limits<float>::quiet_NaN());
+	m_waitMs.fill(std::numeric_limits<float>::quiet_NaN());
+}
+
+FramePacer::~FramePacer()
+{
+	for (Frame& frame : m_frames)
+		if (frame.fence != nullptr)
+			glDeleteSync(frame.fence);
+}
+
+void FramePacer::Apply(const Settings& settings)
+{
+	m_settings = settings;
+	m_settings.framesInFlight = std::min(std::max(m_settings.framesInFlight, 1), MAX_FRAMES_IN_FLIGHT);
+	m_settings.frameCap = std::max(m_settings.frameCap, 0.0);
+
+	int interval = m_settings.swapMode == SwapMode::Immediate ? 0 : (m_settings.swapMode == SwapMode::Vsync ? 1 : -1);
+	if (SDL_GL_SetSwapInterval(interval) != 0 && interval == -1)
+	{
+		std::cerr << "[FramePacer] Adaptive vsync is not supported, using vsync" << std::endl;
+		m_settings.swapMode = SwapMode::Vsync;
+		SDL_GL_SetSwapInterval(1);
+	}
+}
+
+void FramePacer::BeginFrame()
+{
+	CPU_ZONE("FramePacer::BeginFrame");
+	const uint64_t waitBegin = CpuProfiler::Now();
+
+	// frames older than the allowed depth have to be finished, m_current is the oldest slot
+	for (size_t i = 0; i < FRAME_SLOTS; ++i)
+	{
+		Frame& frame = m_frames[(m_current + i) % FRAME_SLOTS];
+		if (frame.fence != nullptr && frame.number + m_settings.framesInFlight < m_frameNumber)
+			Collect(frame, true);
+	}
+
+	Frame& previous = m_frames[(m_current + FRAME_SLOTS - 1) % FRAME_SLOTS];
+	uint64_t now = CpuProfiler::Now();
+	if (m_settings.frameCap > 0.0 && m_frameNumber > 0)
+	{
+		uint64_t deadline = previous.beginNs + static_cast<uint64_t>(1e9 / m_settings.frameCap);
+		if (now + CAP_SPIN_NS < deadline)
+			std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - now - CAP_SPIN_NS));
+		while ((now = CpuProfiler::Now()) < deadline)
+			std::this_thread::yield();
+	}
+
+	// the frame before is finished on the CPU, it is measured once its fence signals
+	if (m_frameNumber > 0)
+		previous.frameMs = (now - previous.beginNs) / 1e6;
+	for (size_t i = 0; i < FRAME_SLOTS; ++i)
+		Collect(m_frames[(m_current + i) % FRAME_SLOTS], false);
+
+	m_waitMs[m_begun++ % HISTORY_LENGTH] = static_cast<float>((now - waitBegin) / 1e6);
+	UpdateClockOffset();
+
+	Frame& frame = m_frames[m_current];
+	frame.number = m_frameNumber++;
+	frame.beginNs = now;
+	frame.inputNs = now;
+	frame.frameMs = std::numeric_limits<double>::quiet_NaN();
+}
+
+void FramePacer::EndFrame()
+{
+	Frame& frame = m_frames[m_current];
+	frame.timestamp.Timestamp();
+	frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_current = (m_current + 1) % FRAME_SLOTS;
+}
+
+void FramePacer::Flush()
+{
+	for (size_t i = 0; i < FRAME_SLOTS; ++i)
+		Collect(m_frames[(m_current + i) % FRAME_SLOTS], true);
+}
+
+bool FramePacer::Collect(Frame& frame, bool wait)
+{
+	if (frame.fence == nullptr)
+		return true;
+
+	GLenum status = glClientWaitSync(frame.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+
+	glDeleteSync(frame.fence);
+	frame.fence = nullptr;
+	if (status == GL_WAIT_FAILED)
+	{
+		std::cerr << "[FramePacer] glClientWaitSync failed" << std::endl;
+		return true;
+	}
+
+	// the timestamp was queued before the fence, so it has arrived by now
+	int64_t doneNs = static_cast<int64_t>(frame.timestamp.GetResult()) + m_gpuToCpuNs;
+	double latencyMs = (doneNs - static_cast<int64_t>(frame.inputNs)) / 1e6;
+
+	size_t slot = m_collected++ % HISTORY_LENGTH;
+	m_frameMs[slot] = static_cast<float>(frame.frameMs);
+	m_latencyMs[slot] = static_cast<float>(latencyMs);
+	if (m_listener)
+		m_listener(frame.number, frame.frameMs, latencyMs);
+	return true;
+}
+
+void FramePacer::UpdateClockOffset()
+{
+	// the GL clock is read right away, without waiting for the commands before it
+	GLint64 gpuNs = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNs);
+	m_gpuToCpuNs = static_cast<int64_t>(CpuProfiler::Now()) - gpuNs;
+}
+
+FramePacer::Stats FramePacer::GetStats() const
+{
+	Stats stats{};
+	auto gather = [this](const std::array<float, HISTORY_LENGTH>& history, size_t written)
+	{
+		m_sortScratch.clear();
+		for (size_t i = 0; i < std::min(written, HISTORY_LENGTH); ++i)
+			if (!std::isnan(history[i]))
+				m_sortScratch.push_back(history[i]);
+		std::sort(m_sortScratch.begin(), m_sortScratch.end());
+		double sum = 0;
+		for (float value : m_sortScratch)
+			sum += value;
+		return m_sortScratch.empty() ? 0.0 : sum / m_sortScratch.size();
+	};
+
+	stats.frameAverage = gather(m_frameMs, m_collected);
+	if (!m_sortScratch.empty())
+	{
+		double squares = 0;
+		for (float value : m_sortScratch)
+			squares += (value - stats.frameAverage) * (value - stats.frameAverage);
+		stats.frameStdDev = std::sqrt(squares / m_sortScratch.size());
+		stats.frameP99 = Percentile(m_sortScratch, 0.99);
+	}
+
+	stats.latencyAverage = gather(m_latencyMs, m_collected);
+	if (!m_sortScratch.empty())
+		stats.latencyP99 = Percentile(m_sortScratch, 0.99);
+
+	stats.waitAverage = gather(m_waitMs, m_begun);
+	return stats;
+}
+
+void FramePacer::ShowWindow(const char* title)
+{
+	if (ImGui::Begin(title))
+	{
+		Settings settings = m_settings;
+		int swapMode = static_cast<int>(settings.swapMode);
+		float frameCap = static_cast<float>(settings.frameCap);
+		bool changed = ImGui::Combo("Swap", &swapMode, "Immediate\0Vsync\0Adaptive vsync\0");
+		changed |= ImGui::SliderInt("Frames in flight", &settings.framesInFlight, 1, MAX_FRAMES_IN_FLIGHT);
+		changed |= ImGui::SliderFloat("Frame cap (0: off)", &frameCap, 0.0f, 240.0f, "%.0f fps");
+		if (changed)
+		{
+			settings.swapMode = static_cast<SwapMode>(swapMode);
+			settings.frameCap = frameCap;
+			Apply(settings);
+		}
+
+		Stats stats = GetStats();
+		ImGui::Text("Frame: %.2f ms avg (%.0f fps), %.2f ms std. dev., %.2f ms p99", stats.frameAverage,
+					stats.frameAverage > 0.0 ? 1000.0 / stats.frameAverage : 0.0, stats.frameStdDev, stats.frameP99);
+		ImGui::Text("Input to GPU done: %.2f ms avg, %.2f ms p99", stats.latencyAverage, stats.latencyP99);
+		ImGui::Text("Waiting for the GPU and the cap: %.2f ms per frame", stats.waitAverage);
+	}
+	ImGui::End();
+}
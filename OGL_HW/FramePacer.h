@@ -0,0 +1,116 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "QueryObject.h"
+
+enum class SwapMode : int
+{
+	Immediate = 0,
+	Vsync,
+	Adaptive	// vsync, but a late frame is shown at once instead of waiting for the next blank
+};
+
+/*
+	Frame pacing. A fence follows every swap, and BeginFrame waits until at most framesInFlight frames are still
+	queued on the GPU. Without that, the driver can buffer several frames, and every buffered frame adds a frame
+	of input latency. The wait sits at the start of the frame, before the input is read and the frame is
+	simulated, so the frame shows input that is as recent as possible. The frame cap sleeps at the same place.
+
+	A frame's latency is measured from when its input was read (SetInputTime) to a GPU timestamp after its last
+	command, converted to the CPU clock. Scan-out comes on top of that. Latency and frame-to-frame times are
+	kept for the last HISTORY_LENGTH frames.
+*/
+class FramePacer final
+{
+public:
+	static const int MAX_FRAMES_IN_FLIGHT = 4;
+	static const size_t HISTORY_LENGTH = 256;
+
+	struct Settings
+	{
+		int			framesInFlight = 2;
+		SwapMode	swapMode = SwapMode::Vsync;
+		double		frameCap = 0.0;		// frames per second, 0 for none
+	};
+
+	// milliseconds over the history
+	struct Stats
+	{
+		double	frameAverage;
+		double	frameStdDev;
+		double	frameP99;
+		double	latencyAverage;
+		double	latencyP99;
+		double	waitAverage;		// spent in BeginFrame, waiting for the GPU or the cap
+	};
+
+	// called with the frame's number (counted by BeginFrame from 0), the time to the next frame (NaN for the last one)
+	// and its latency, a few frames after the frame
+	using FrameListener = std::function<void(uint64_t frame, double frameMs, double latencyMs)>;
+
+	FramePacer();
+	~FramePacer();
+
+	FramePacer(const FramePacer&)				= delete;
+	FramePacer& operator=(const FramePacer&)	= delete;
+
+	// sets the swap interval too; without adaptive vsync support the swap mode falls back to vsync
+	void Apply(const Settings& settings);
+	const Settings& GetSettings() const { return m_settings; }
+
+	void SetFrameListener(FrameListener listener) { m_listener = std::move(listener); }
+
+	// before the frame's input is read
+	void BeginFrame();
+	// CpuProfiler::Now() when the input shown by the current frame was read
+	void SetInputTime(uint64_t ns) { m_frames[m_current].inputNs = ns; }
+	// right after the swap
+	void EndFrame();
+
+	// waits for every frame in flight and collects it
+	void Flush();
+
+	Stats GetStats() const;
+
+	// the settings and the stats
+	void ShowWindow(const char* title);
+
+private:
+	struct Frame
+	{
+		GLsync									fence = nullptr;
+		QueryObject<QueryType::Timestamp>		timestamp;
+		uint64_t								number = 0;
+		uint64_t								beginNs = 0;
+		uint64_t								inputNs = 0;
+		double									frameMs = 0.0;
+	};
+
+	// true once the frame's fence has signalled (immediately if wait), then the frame is measured and freed
+	bool Collect(Frame& frame, bool wait);
+	void UpdateClockOffset();
+
+	// one more than can be in flight, for the frame being recorded
+	static const size_t FRAME_SLOTS = MAX_FRAMES_IN_FLIGHT + 1;
+
+	Settings									m_settings;
+	std::array<Frame, FRAME_SLOTS>				m_frames;
+	size_t										m_current = 0;
+	uint64_t									m_frameNumber = 0;
+	int64_t										m_gpuToCpuNs = 0;	// added to a GL timestamp gives CpuProfiler::Now() time
+
+	std::array<float, HISTORY_LENGTH>			m_frameMs;
+	std::array<float, HISTORY_LENGTH>			m_latencyMs;
+	std::array<float, HISTORY_LENGTH>			m_waitMs;
+	size_t										m_collected = 0;
+	size_t										m_begun = 0;
+	mutable std::vector<float>					m_sortScratch;
+	FrameListener								m_listener;
+};
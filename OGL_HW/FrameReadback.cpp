@@ -0,0 +1,178 @@
+#include "FrameReadback.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "CpuProfiler.h"
+
+FrameReadback::FrameReadback()
+{
+	for (Slot& slot : m_slots)
+		slot.buffer.SetOwner("Frame readback");
+
+	m_worker = std::thread(&FrameReadback::WorkerLoop, this);
+}
+
+FrameReadback::~FrameReadback()
+{
+	Poll(true);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeUp.notify_one();
+	m_worker.join();
+}
+
+void FrameReadback::Capture(GLuint framebuffer, GLenum readBuffer, GLsizei width, GLsizei height, const std::string& filename)
+{
+	CPU_ZONE("FrameReadback::Capture");
+
+	auto free = std::find_if(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.fence == nullptr; });
+	if (free == m_slots.end())
+	{
+		// every buffer is in flight: this capture has to wait for the oldest one
+		free = std::min_element(m_slots.begin(), m_slots.end(), [](const Slot& a, const Slot& b) { return a.issued < b.issued; });
+		Complete(*free);
+	}
+	Slot& slot = *free;
+
+	GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4;
+	if (slot.capacity < size)
+	{
+		slot.buffer.BufferData(size);
+		slot.capacity = size;
+	}
+
+	GLint previousReadFramebuffer = 0;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(readBuffer);
+	slot.buffer.Bind();
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	// into the bound pixel pack buffer: returns as soon as the copy is queued
+	glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebuffer);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = width;
+	slot.height = height;
+	slot.filename = filename;
+	slot.issued = m_captures++;
+}
+
+void FrameReadback::Poll(bool wait)
+{
+	std::array<Slot*, RING_SIZE> inFlight{};
+	size_t count = 0;
+	for (Slot& slot : m_slots)
+		if (slot.fence != nullptr)
+			inFlight[count++] = &slot;
+	std::sort(inFlight.begin(), inFlight.begin() + count, [](const Slot* a, const Slot* b) { return a->issued < b->issued; });
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		// the captures finish in order, so the first one still pending ends the poll
+		GLenum status = glClientWaitSync(inFlight[i]->fence, 0, 0);
+		if (!wait && status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		Complete(*inFlight[i]);
+	}
+}
+
+size_t FrameReadback::InFlight() const
+{
+	return std::count_if(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.fence != nullptr; });
+}
+
+void FrameReadback::Complete(Slot& slot)
+{
+	CPU_ZONE("FrameReadback::Complete");
+
+	// flushes the fence in case it has not been submitted yet, then blocks for as long as it takes
+	glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	Image image{ slot.width, slot.height, slot.filename, {} };
+	size_t size = static_cast<size_t>(slot.width) * slot.height * 4;
+	image.bgra.resize(size);
+
+	slot.buffer.Bind();
+	const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (pixels != nullptr)
+	{
+		std::memcpy(image.bgra.data(), pixels, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (pixels == nullptr)
+	{
+		std::cerr << "[FrameReadback] Cannot map the readback buffer of " << slot.filename << std::endl;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(std::move(image));
+	}
+	m_wakeUp.notify_one();
+}
+
+void FrameReadback::WorkerLoop()
+{
+	CpuProfiler::SetThreadName("readback");
+
+	for (;;)
+	{
+		Image image;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+			// the queue is drained before stopping, so no capture is lost on exit
+			if (m_queue.empty())
+				return;
+			image = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+
+		// no detail: every capture's filename is different, the profiler would keep each of them
+		CPU_ZONE("FrameReadback::WriteTga");
+		if (WriteTga(image))
+			std::cout << "Captured " << image.filename << std::endl;
+	}
+}
+
+bool FrameReadback::WriteTga(const Image& image)
+{
+	std::ofstream file(image.filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cerr << "[FrameReadback] Cannot write " << image.filename << std::endl;
+		return false;
+	}
+
+	// uncompressed true colour, 24 bits, origin at the bottom left like glReadPixels
+	uint8_t header[18] = {};
+	header[2] = 2;
+	header[12] = static_cast<uint8_t>(image.width & 0xFF);
+	header[13] = static_cast<uint8_t>(image.width >> 8);
+	header[14] = static_cast<uint8_t>(image.height & 0xFF);
+	header[15] = static_cast<uint8_t>(image.height >> 8);
+	header[16] = 24;
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	// the alpha of the default framebuffer is meaningless, it is dropped
+	std::vector<uint8_t> bgr(static_cast<size_t>(image.width) * image.height * 3);
+	for (size_t pixel = 0, count = bgr.size() / 3; pixel < count; ++pixel)
+		std::memcpy(&bgr[pixel * 3], &image.bgra[pixel * 4], 3);
+	file.write(reinterpret_cast<const char*>(bgr.data()), bgr.size());
+
+	return file.good();
+}
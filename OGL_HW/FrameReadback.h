@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BufferObject.h"
+
+/*
+	Asynchronous framebuffer captures. Capture starts a glReadPixels into one of RING_SIZE pixel pack buffers
+	and fences it, so the copy is queued on the GPU instead of waited for. Poll, called once a frame, maps the
+	buffers whose fence has signalled (normally a frame or two later), copies the pixels out and hands them to
+	a worker thread, which writes them as uncompressed TGA files.
+
+	Pixels are read as 8 bit BGRA, so float attachments are clamped to [0, 1]. Only when every buffer of the
+	ring is still in flight does Capture wait, for the oldest one.
+*/
+class FrameReadback final
+{
+public:
+	static const size_t RING_SIZE = 4;
+
+	FrameReadback();
+	// waits for the captures in flight and for the worker to write them
+	~FrameReadback();
+
+	FrameReadback(const FrameReadback&)				= delete;
+	FrameReadback& operator=(const FrameReadback&)	= delete;
+
+	// framebuffer 0 with GL_BACK is the default framebuffer, otherwise readBuffer is a colour attachment
+	void Capture(GLuint framebuffer, GLenum readBuffer, GLsizei width, GLsizei height, const std::string& filename);
+
+	// hands the captures that have arrived to the worker; wait also takes the ones still in flight
+	void Poll(bool wait = false);
+
+	size_t InFlight() const;
+
+private:
+	struct Slot
+	{
+		BufferObject<BufferType::PixelPack, BufferUsage::StreamRead>	buffer;
+		GLsizeiptr		capacity = 0;
+		GLsync			fence = nullptr;
+		GLsizei			width = 0;
+		GLsizei			height = 0;
+		std::string		filename;
+		uint64_t		issued = 0;		// capture order, the oldest is polled first
+	};
+
+	struct Image
+	{
+		GLsizei					width;
+		GLsizei					height;
+		std::string				filename;
+		std::vector<uint8_t>	bgra;	// bottom row first, as GL reads it
+	};
+
+	void Complete(Slot& slot);
+	void WorkerLoop();
+	static bool WriteTga(const Image& image);
+
+	std::array<Slot, RING_SIZE>	m_slots;
+	uint64_t					m_captures = 0;
+
+	std::thread					m_worker;
+	std::mutex					m_mutex;
+	std::condition_variable		m_wakeUp;
+	std::deque<Image>			m_queue;
+	bool						m_stop = false;
+};
@@ -0,0 +1,229 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include <imgui/imgui.h>
+
+namespace
+{
+	const char* const CSV_FILENAME = "gpu_profile.csv";
+
+	double Percentile(const std::vector<float>& sorted, double p)
+	{
+		size_t index = static_cast<size_t>(std::ceil(p * sorted.size())) - 1;
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+}
+
+void GpuProfiler::BeginFrame()
+{
+	// the slot being reused was filled FRAME_LATENCY frames ago
+	FrameQueries& frame = m_frames[m_current];
+	Collect(frame);
+
+	frame.used = 0;
+	frame.sections.clear();
+	frame.issued = false;
+	frame.number = m_frameNumber++;
+	m_open.clear();
+
+	BeginSection("Frame");
+}
+
+void GpuProfiler::EndFrame()
+{
+	EndSection();
+
+	m_frames[m_current].issued = true;
+	m_current = (m_current + 1) % FRAME_LATENCY;
+}
+
+void GpuProfiler::Flush()
+{
+	// m_current is the oldest slot
+	for (size_t i = 0; i < FRAME_LATENCY; ++i)
+	{
+		FrameQueries& frame = m_frames[(m_current + i) % FRAME_LATENCY];
+		bool wait = m_waitForResults;
+		m_waitForResults = true;
+		Collect(frame);
+		m_waitForResults = wait;
+		frame.issued = false;
+	}
+}
+
+void GpuProfiler::BeginSection(const char* name)
+{
+	auto it = m_sectionIndices.find(name);
+	if (it == m_sectionIndices.end())
+	{
+		Section section{ name, static_cast<int>(m_open.size()), {} };
+		section.samples.fill(std::numeric_limits<float>::quiet_NaN());
+		it = m_sectionIndices.emplace(name, m_sections.size()).first;
+		m_sections.push_back(section);
+	}
+
+	FrameQueries& frame = m_frames[m_current];
+	m_open.push_back(frame.sections.size());
+	frame.sections.push_back({ it->second, RecordTimestamp(), 0 });
+}
+
+void GpuProfiler::EndSection()
+{
+	if (m_open.empty())
+	{
+		std::cerr << "[GpuProfiler] EndSection without a matching BeginSection" << std::endl;
+		return;
+	}
+
+	m_frames[m_current].sections[m_open.back()].endQuery = RecordTimestamp();
+	m_open.pop_back();
+}
+
+size_t GpuProfiler::RecordTimestamp()
+{
+	FrameQueries& frame = m_frames[m_current];
+	if (frame.used == frame.queries.size())
+		frame.queries.emplace_back();
+
+	frame.queries[frame.used].Timestamp();
+	return frame.used++;
+}
+
+void GpuProfiler::Collect(FrameQueries& frame)
+{
+	if (!frame.issued)
+		return;
+
+	// GetResult blocks, so when waiting is allowed the availability is not even checked
+	for (size_t i = 0; i < frame.used && !m_waitForResults; ++i)
+	{
+		if (!frame.queries[i].IsResultAvailable())
+		{
+			++m_dropped;
+			return;
+		}
+	}
+
+	size_t slot = m_collected % HISTORY_LENGTH;
+	for (Section& section : m_sections)
+		section.samples[slot] = std::numeric_limits<float>::quiet_NaN();
+
+	for (const PendingSection& pending : frame.sections)
+	{
+		GLuint64 begin = frame.queries[pending.beginQuery].GetResult();
+		GLuint64 end = frame.queries[pending.endQuery].GetResult();
+		float ms = static_cast<float>((end - begin) / 1e6);
+
+		// a section run several times in a frame adds up
+		float& sample = m_sections[pending.section].samples[slot];
+		sample = std::isnan(sample) ? ms : sample + ms;
+	}
+
+	if (m_listener)
+		m_listener(frame.number, m_sections[m_sectionIndices.find("Frame")->second].samples[slot]);
+
+	++m_collected;
+}
+
+GpuProfiler::Stats GpuProfiler::GetStats(size_t index) const
+{
+	const Section& section = m_sections[index];
+	size_t count = std::min(m_collected, HISTORY_LENGTH);
+
+	std::vector<float>& values = m_sortScratch;
+	values.clear();
+	for (size_t i = 0; i < count; ++i)
+		if (!std::isnan(section.samples[i]))
+			values.push_back(section.samples[i]);
+
+	Stats stats{};
+	if (values.empty())
+		return stats;
+
+	float last = section.samples[(m_collected - 1) % HISTORY_LENGTH];
+	stats.last = std::isnan(last) ? 0.0 : last;
+
+	double sum = 0;
+	for (float value : values)
+		sum += value;
+	stats.average = sum / values.size();
+
+	std::sort(values.begin(), values.end());
+	stats.p50 = Percentile(values, 0.50);
+	stats.p95 = Percentile(values, 0.95);
+	stats.p99 = Percentile(values, 0.99);
+	return stats;
+}
+
+void GpuProfiler::ShowWindow(const char* title)
+{
+	if (ImGui::Begin(title))
+	{
+		ImGui::Text("GPU ms over the last %d frames (%d dropped)", static_cast<int>(std::min(m_collected, HISTORY_LENGTH)), static_cast<int>(m_dropped));
+
+		ImGui::Columns(6, "gpu_sections");
+		for (const char* header : { "Section", "Last", "Avg", "p50", "p95", "p99" })
+		{
+			ImGui::Text("%s", header);
+			ImGui::NextColumn();
+		}
+		ImGui::Separator();
+
+		for (size_t i = 0; i < m_sections.size(); ++i)
+		{
+			Stats stats = GetStats(i);
+			ImGui::Text("%*s%s", m_sections[i].depth * 2, "", m_sections[i].name.c_str());
+			ImGui::NextColumn();
+			for (double value : { stats.last, stats.average, stats.p50, stats.p95, stats.p99 })
+			{
+				ImGui::Text("%.3f", value);
+				ImGui::NextColumn();
+			}
+		}
+		ImGui::Columns(1);
+
+		if (ImGui::Button("Export CSV"))
+		{
+			if (ExportCsv(CSV_FILENAME))
+				std::cout << "GPU profile written to " << CSV_FILENAME << "\n";
+		}
+	}
+	ImGui::End();
+}
+
+bool GpuProfiler::ExportCsv(const std::string& filename) const
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		std::cerr << "[GpuProfiler] Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	file << "frame";
+	for (const Section& section : m_sections)
+		file << "," << section.name;
+	file << "\n";
+
+	// oldest first; sections that did not run in a frame are left empty
+	size_t count = std::min(m_collected, HISTORY_LENGTH);
+	for (size_t frame = m_collected - count; frame < m_collected; ++frame)
+	{
+		file << frame;
+		for (const Section& section : m_sections)
+		{
+			file << ",";
+			float value = section.samples[frame % HISTORY_LENGTH];
+			if (!std::isnan(value))
+				file << value;
+		}
+		file << "\n";
+	}
+
+	return true;
+}
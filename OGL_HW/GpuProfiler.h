@@ -0,0 +1,114 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "QueryObject.h"
+
+/*
+	Scoped GPU timing of the passes of a frame. Every section is bracketed by two GL_TIMESTAMP queries, so
+	sections can nest. A frame's queries are read FRAME_LATENCY frames later, when they have normally arrived;
+	if they are still pending by then, the frame is dropped instead of waited for.
+	The whole frame is measured as the outermost section, "Frame".
+*/
+class GpuProfiler final
+{
+public:
+	static const size_t FRAME_LATENCY = 3;
+	static const size_t HISTORY_LENGTH = 256;
+
+	// milliseconds over the frames in the history; a section missing from a frame is left out of its stats
+	struct Stats
+	{
+		double	last;
+		double	average;
+		double	p50;
+		double	p95;
+		double	p99;
+	};
+
+	class Scope final
+	{
+	public:
+		Scope(GpuProfiler& profiler, const char* name) : m_profiler(profiler) { m_profiler.BeginSection(name); }
+		~Scope() { m_profiler.EndSection(); }
+
+		Scope(const Scope&)				= delete;
+		Scope& operator=(const Scope&)	= delete;
+
+	private:
+		GpuProfiler&	m_profiler;
+	};
+
+	// called with the frame's number and its whole GPU time whenever a frame's results are read
+	using FrameListener = std::function<void(uint64_t frame, double ms)>;
+
+	void BeginFrame();
+	void EndFrame();
+
+	// waits for late results instead of dropping the frame, for runs where every frame has to be measured
+	void SetWaitForResults(bool wait) { m_waitForResults = wait; }
+	void SetFrameListener(FrameListener listener) { m_listener = std::move(listener); }
+	// reads every frame still in flight, oldest first
+	void Flush();
+
+	void BeginSection(const char* name);
+	void EndSection();
+
+	size_t SectionCount() const { return m_sections.size(); }
+	const std::string& SectionName(size_t section) const { return m_sections[section].name; }
+	Stats GetStats(size_t section) const;
+
+	// ImGui window with the per-section breakdown
+	void ShowWindow(const char* title);
+
+	// one row per frame in the history, one column per section
+	bool ExportCsv(const std::string& filename) const;
+
+private:
+	struct Section
+	{
+		std::string							name;
+		int									depth;
+		std::array<float, HISTORY_LENGTH>	samples;	// NaN where the section did not run
+	};
+
+	struct PendingSection
+	{
+		size_t	section;
+		size_t	beginQuery;
+		size_t	endQuery;
+	};
+
+	struct FrameQueries
+	{
+		std::vector<QueryObject<QueryType::Timestamp>>	queries;
+		size_t							used = 0;
+		std::vector<PendingSection>		sections;
+		bool							issued = false;
+		uint64_t						number = 0;
+	};
+
+	size_t RecordTimestamp();
+	void Collect(FrameQueries& frame);
+
+	std::array<FrameQueries, FRAME_LATENCY>	m_frames;
+	size_t									m_current = 0;
+	std::vector<size_t>						m_open;		// indices into the current frame's sections
+
+	std::vector<Section>					m_sections;	// in the order they first ran
+	std::map<std::string, size_t, std::less<>>	m_sectionIndices;	// found by const char* without a std::string
+	size_t									m_collected = 0;
+	size_t									m_dropped = 0;
+	uint64_t								m_frameNumber = 0;
+	mutable std::vector<float>				m_sortScratch;	// GetStats' samples, kept so that it does not allocate every frame
+	bool									m_waitForResults = false;
+	FrameListener							m_listener;
+};
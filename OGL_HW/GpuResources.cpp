@@ -0,0 +1,415 @@
+#include "GpuResources.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <imgui/imgui.h>
+
+namespace
+{
+	struct Resource
+	{
+		GpuResources::Kind	kind;
+		GLuint				id;
+		std::string			owner;
+		GLenum				format = GL_NONE;	// internal format, GL_NONE for buffers and framebuffers
+		GLsizei				width = 0;
+		GLsizei				height = 0;
+		GLsizei				levels = 0;
+		size_t				bytes = 0;
+	};
+
+	const std::array<const char*, static_cast<size_t>(GpuResources::Kind::Count)> KIND_NAMES = { "Buffers", "Textures", "Renderbuffers", "Framebuffers" };
+
+	// GL names are only unique within a kind
+	uint64_t Key(GpuResources::Kind kind, GLuint id)
+	{
+		return (static_cast<uint64_t>(kind) << 32) | id;
+	}
+
+	std::unordered_map<uint64_t, Resource>& Resources()
+	{
+		static std::unordered_map<uint64_t, Resource> resources;
+		return resources;
+	}
+
+	GLuint Register(GpuResources::Kind kind, GLuint id, const std::string& owner)
+	{
+		Resource resource{ kind, id, owner };
+		Resources()[Key(kind, id)] = resource;
+		return id;
+	}
+
+	Resource* Find(GpuResources::Kind kind, GLuint id)
+	{
+		auto it = Resources().find(Key(kind, id));
+		if (it == Resources().end())
+		{
+			std::cerr << "[GpuResources] " << KIND_NAMES[static_cast<size_t>(kind)] << " " << id << " was not created through the registry" << std::endl;
+			return nullptr;
+		}
+		return &it->second;
+	}
+
+	size_t BytesPerTexel(GLenum internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_R8:					return 1;
+		case GL_RG8:
+		case GL_R16F:
+		case GL_DEPTH_COMPONENT16:	return 2;
+		case GL_RGB8:				return 3;
+		case GL_RGBA8:
+		case GL_SRGB8_ALPHA8:
+		case GL_RG16F:
+		case GL_R32F:
+		case GL_R11F_G11F_B10F:
+		case GL_DEPTH_COMPONENT24:	// stored in 32 bits
+		case GL_DEPTH_COMPONENT32F:
+		case GL_DEPTH24_STENCIL8:	return 4;
+		case GL_RGB16_SNORM:
+		case GL_RGB16F:				return 6;
+		case GL_RGBA16F:
+		case GL_RGBA16_SNORM:
+		case GL_RG32F:
+		case GL_DEPTH32F_STENCIL8:	return 8;
+		case GL_RGB32F:				return 12;
+		case GL_RGBA32F:			return 16;
+		default:					return 4;
+		}
+	}
+
+	size_t MipChainBytes(const Resource& resource)
+	{
+		size_t bytes = 0;
+		GLsizei width = resource.width;
+		GLsizei height = resource.height;
+		for (GLsizei level = 0; level < resource.levels; ++level)
+		{
+			bytes += static_cast<size_t>(width) * height * BytesPerTexel(resource.format);
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+		return bytes;
+	}
+
+	void TrackBuffer(GLuint buffer, GLsizeiptr size)
+	{
+		if (Resource* resource = Find(GpuResources::Kind::Buffer, buffer))
+		{
+			resource->width = static_cast<GLsizei>(size);
+			resource->bytes = static_cast<size_t>(size);
+		}
+	}
+
+	void TrackImage(GpuResources::Kind kind, GLuint id, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levels)
+	{
+		if (Resource* resource = Find(kind, id))
+		{
+			resource->format = internalFormat;
+			resource->width = width;
+			resource->height = height;
+			resource->levels = levels;
+			resource->bytes = MipChainBytes(*resource);
+		}
+	}
+
+	std::vector<const Resource*> SortedBySize()
+	{
+		std::vector<const Resource*> sorted;
+		sorted.reserve(Resources().size());
+		for (const auto& entry : Resources())
+			sorted.push_back(&entry.second);
+		std::sort(sorted.begin(), sorted.end(), [](const Resource* a, const Resource* b) { return a->bytes > b->bytes; });
+		return sorted;
+	}
+
+	double Megabytes(size_t bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+}
+
+const char* GpuResources::FormatName(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_NONE:				return "-";
+	case GL_R8:					return "R8";
+	case GL_RG8:				return "RG8";
+	case GL_R16F:				return "R16F";
+	case GL_DEPTH_COMPONENT16:	return "DEPTH16";
+	case GL_RGB8:				return "RGB8";
+	case GL_RGBA8:				return "RGBA8";
+	case GL_SRGB8_ALPHA8:		return "SRGB8_ALPHA8";
+	case GL_RG16F:				return "RG16F";
+	case GL_R32F:				return "R32F";
+	case GL_R32UI:				return "R32UI";
+	case GL_R11F_G11F_B10F:		return "R11F_G11F_B10F";
+	case GL_DEPTH_COMPONENT24:	return "DEPTH24";
+	case GL_DEPTH_COMPONENT32F:	return "DEPTH32F";
+	case GL_DEPTH24_STENCIL8:	return "DEPTH24_STENCIL8";
+	case GL_RGB16_SNORM:		return "RGB16_SNORM";
+	case GL_RGB16F:				return "RGB16F";
+	case GL_RGBA16F:			return "RGBA16F";
+	case GL_RGBA16_SNORM:		return "RGBA16_SNORM";
+	case GL_RG32F:				return "RG32F";
+	case GL_DEPTH32F_STENCIL8:	return "DEPTH32F_STENCIL8";
+	case GL_RGB32F:				return "RGB32F";
+	case GL_RGBA32F:			return "RGBA32F";
+	default:					return "other";
+	}
+}
+
+bool GpuResources::DirectStateAccess()
+{
+	// the first object is created after glewInit
+	static const bool supported = GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+	return supported;
+}
+
+GLuint GpuResources::CreateBuffer(const std::string& owner)
+{
+	GLuint id = 0;
+	if (DirectStateAccess())
+		glCreateBuffers(1, &id);
+	else
+		glGenBuffers(1, &id);
+	return Register(Kind::Buffer, id, owner);
+}
+
+GLuint GpuResources::CreateTexture(const std::string& owner, GLenum target)
+{
+	GLuint id = 0;
+	if (DirectStateAccess())
+		glCreateTextures(target, 1, &id);
+	else
+		glGenTextures(1, &id);
+	return Register(Kind::Texture, id, owner);
+}
+
+GLuint GpuResources::CreateRenderbuffer(const std::string& owner)
+{
+	GLuint id = 0;
+	if (DirectStateAccess())
+		glCreateRenderbuffers(1, &id);
+	else
+		glGenRenderbuffers(1, &id);
+	return Register(Kind::Renderbuffer, id, owner);
+}
+
+GLuint GpuResources::CreateFramebuffer(const std::string& owner)
+{
+	GLuint id = 0;
+	if (DirectStateAccess())
+		glCreateFramebuffers(1, &id);
+	else
+		glGenFramebuffers(1, &id);
+	return Register(Kind::Framebuffer, id, owner);
+}
+
+void GpuResources::DeleteBuffer(GLuint& buffer)
+{
+	if (buffer == 0)
+		return;
+	glDeleteBuffers(1, &buffer);
+	Resources().erase(Key(Kind::Buffer, buffer));
+	buffer = 0;
+}
+
+void GpuResources::DeleteTexture(GLuint& texture)
+{
+	if (texture == 0)
+		return;
+	glDeleteTextures(1, &texture);
+	Resources().erase(Key(Kind::Texture, texture));
+	texture = 0;
+}
+
+void GpuResources::DeleteRenderbuffer(GLuint& renderbuffer)
+{
+	if (renderbuffer == 0)
+		return;
+	glDeleteRenderbuffers(1, &renderbuffer);
+	Resources().erase(Key(Kind::Renderbuffer, renderbuffer));
+	renderbuffer = 0;
+}
+
+void GpuResources::DeleteFramebuffer(GLuint& framebuffer)
+{
+	if (framebuffer == 0)
+		return;
+	glDeleteFramebuffers(1, &framebuffer);
+	Resources().erase(Key(Kind::Framebuffer, framebuffer));
+	framebuffer = 0;
+}
+
+void GpuResources::BufferData(GLenum target, GLuint buffer, GLsizeiptr size, const GLvoid* data, GLenum usage)
+{
+	glBindBuffer(target, buffer);
+	glBufferData(target, size, data, usage);
+	TrackBuffer(buffer, size);
+}
+
+void GpuResources::BufferStorage(GLenum target, GLuint buffer, GLsizeiptr size, const GLvoid* data, GLbitfield flags)
+{
+	glBindBuffer(target, buffer);
+	glBufferStorage(target, size, data, flags);
+	TrackBuffer(buffer, size);
+}
+
+void GpuResources::TexImage2D(GLenum target, GLuint texture, GLenum internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels)
+{
+	glBindTexture(target, texture);
+	glTexImage2D(target, 0, internalFormat, width, height, 0, format, type, pixels);
+	TrackImage(Kind::Texture, texture, internalFormat, width, height, 1);
+}
+
+void GpuResources::GenerateMipmap(GLenum target, GLuint texture)
+{
+	glBindTexture(target, texture);
+	glGenerateMipmap(target);
+
+	if (Resource* resource = Find(Kind::Texture, texture))
+	{
+		resource->levels = MipLevelCount(resource->width, resource->height);
+		resource->bytes = MipChainBytes(*resource);
+	}
+}
+
+void GpuResources::RenderbufferStorage(GLuint renderbuffer, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, width, height);
+	TrackImage(Kind::Renderbuffer, renderbuffer, internalFormat, width, height, 1);
+}
+
+void GpuResources::NamedBufferData(GLuint buffer, GLsizeiptr size, const GLvoid* data, GLenum usage)
+{
+	glNamedBufferData(buffer, size, data, usage);
+	TrackBuffer(buffer, size);
+}
+
+void GpuResources::NamedBufferStorage(GLuint buffer, GLsizeiptr size, const GLvoid* data, GLbitfield flags)
+{
+	glNamedBufferStorage(buffer, size, data, flags);
+	TrackBuffer(buffer, size);
+}
+
+void GpuResources::TextureStorage2D(GLuint texture, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	glTextureStorage2D(texture, levels, internalFormat, width, height);
+	TrackImage(Kind::Texture, texture, internalFormat, width, height, levels);
+}
+
+GLsizei GpuResources::MipLevelCount(GLsizei width, GLsizei height)
+{
+	GLsizei levels = 1;
+	for (GLsizei size = std::max(width, height); size > 1; size /= 2)
+		++levels;
+	return levels;
+}
+
+void GpuResources::SetOwner(Kind kind, GLuint id, const std::string& owner)
+{
+	if (Resource* resource = Find(kind, id))
+		resource->owner = owner;
+}
+
+size_t GpuResources::Count(Kind kind)
+{
+	size_t count = 0;
+	for (const auto& entry : Resources())
+		count += entry.second.kind == kind ? 1 : 0;
+	return count;
+}
+
+size_t GpuResources::TotalBytes(Kind kind)
+{
+	size_t bytes = 0;
+	for (const auto& entry : Resources())
+		bytes += entry.second.kind == kind ? entry.second.bytes : 0;
+	return bytes;
+}
+
+void GpuResources::ShowWindow(const char* title)
+{
+	if (ImGui::Begin(title))
+	{
+		size_t total = 0;
+		ImGui::Columns(3, "gpu_resource_totals");
+		for (const char* header : { "Kind", "Count", "MB" })
+		{
+			ImGui::Text("%s", header);
+			ImGui::NextColumn();
+		}
+		ImGui::Separator();
+		for (size_t kind = 0; kind < KIND_NAMES.size(); ++kind)
+		{
+			size_t bytes = TotalBytes(static_cast<Kind>(kind));
+			total += bytes;
+			ImGui::Text("%s", KIND_NAMES[kind]);
+			ImGui::NextColumn();
+			ImGui::Text("%d", static_cast<int>(Count(static_cast<Kind>(kind))));
+			ImGui::NextColumn();
+			ImGui::Text("%.2f", Megabytes(bytes));
+			ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+		ImGui::Text("Total: %.2f MB", Megabytes(total));
+
+		if (ImGui::CollapsingHeader("Resources"))
+		{
+			ImGui::Columns(4, "gpu_resources");
+			for (const Resource* resource : SortedBySize())
+			{
+				ImGui::Text("%s", resource->owner.c_str());
+				ImGui::NextColumn();
+				ImGui::Text("%s", FormatName(resource->format));
+				ImGui::NextColumn();
+				if (resource->kind == Kind::Texture || resource->kind == Kind::Renderbuffer)
+					ImGui::Text("%dx%d, %d levels", resource->width, resource->height, resource->levels);
+				else
+					ImGui::Text("%s", KIND_NAMES[static_cast<size_t>(resource->kind)]);
+				ImGui::NextColumn();
+				ImGui::Text("%.3f MB", Megabytes(resource->bytes));
+				ImGui::NextColumn();
+			}
+			ImGui::Columns(1);
+		}
+
+		if (ImGui::Button("Dump to console"))
+			Dump(std::cout);
+	}
+	ImGui::End();
+}
+
+void GpuResources::Dump(std::ostream& out)
+{
+	out << "GPU resources (estimated sizes):\n";
+	for (const Resource* resource : SortedBySize())
+	{
+		out << "  " << std::left << std::setw(14) << KIND_NAMES[static_cast<size_t>(resource->kind)]
+			<< std::setw(6) << resource->id << std::setw(32) << resource->owner << std::setw(18) << FormatName(resource->format);
+		if (resource->kind == Kind::Texture || resource->kind == Kind::Renderbuffer)
+			out << std::setw(20) << (std::to_string(resource->width) + "x" + std::to_string(resource->height) + " x" + std::to_string(resource->levels));
+		else
+			out << std::setw(20) << "";
+		out << std::right << std::fixed << std::setprecision(3) << Megabytes(resource->bytes) << " MB\n";
+	}
+
+	size_t total = 0;
+	for (size_t kind = 0; kind < KIND_NAMES.size(); ++kind)
+	{
+		size_t bytes = TotalBytes(static_cast<Kind>(kind));
+		total += bytes;
+		out << "  " << KIND_NAMES[kind] << ": " << Count(static_cast<Kind>(kind)) << ", " << Megabytes(bytes) << " MB\n";
+	}
+	out << "  Total: " << Megabytes(total) << " MB" << std::defaultfloat << std::endl;
+}
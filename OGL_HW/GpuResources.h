@@ -0,0 +1,69 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <iosfwd>
+#include <string>
+
+/*
+	Registry of the GL objects that hold video memory. Buffers, textures, renderbuffers and framebuffers are
+	created, given storage and deleted through it, so that it knows each one's owner, format, size and an
+	estimate of its bytes: the sum of its levels at the nominal texel size, without the driver's padding.
+	The totals per kind are shown in an ImGui window and can be dumped with every resource listed.
+*/
+class GpuResources final
+{
+public:
+	enum class Kind
+	{
+		Buffer = 0,
+		Texture,
+		Renderbuffer,
+		Framebuffer,
+		Count
+	};
+
+	// GL 4.5 or ARB_direct_state_access: objects are created with glCreate*, so they can be edited by name from
+	// the start, see the Named and Texture functions
+	static bool DirectStateAccess();
+
+	static GLuint CreateBuffer(const std::string& owner);
+	static GLuint CreateTexture(const std::string& owner, GLenum target = GL_TEXTURE_2D);
+	static GLuint CreateRenderbuffer(const std::string& owner);
+	static GLuint CreateFramebuffer(const std::string& owner);
+
+	// delete the object and set the name to 0; 0 is ignored
+	static void DeleteBuffer(GLuint& buffer);
+	static void DeleteTexture(GLuint& texture);
+	static void DeleteRenderbuffer(GLuint& renderbuffer);
+	static void DeleteFramebuffer(GLuint& framebuffer);
+
+	// storage: these bind the object to the target and leave it bound
+	static void BufferData(GLenum target, GLuint buffer, GLsizeiptr size, const GLvoid* data, GLenum usage);
+	// immutable storage, ARB_buffer_storage
+	static void BufferStorage(GLenum target, GLuint buffer, GLsizeiptr size, const GLvoid* data, GLbitfield flags);
+	static void TexImage2D(GLenum target, GLuint texture, GLenum internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels);
+	static void GenerateMipmap(GLenum target, GLuint texture);
+	static void RenderbufferStorage(GLuint renderbuffer, GLenum internalFormat, GLsizei width, GLsizei height);
+
+	// the same by name, nothing is bound; only with DirectStateAccess
+	static void NamedBufferData(GLuint buffer, GLsizeiptr size, const GLvoid* data, GLenum usage);
+	static void NamedBufferStorage(GLuint buffer, GLsizeiptr size, const GLvoid* data, GLbitfield flags);
+	static void TextureStorage2D(GLuint texture, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+
+	// of a full mip chain down to 1x1
+	static GLsizei MipLevelCount(GLsizei width, GLsizei height);
+
+	static void SetOwner(Kind kind, GLuint id, const std::string& owner);
+
+	// short name of a sized internal format, for listings
+	static const char* FormatName(GLenum internalFormat);
+
+	static size_t Count(Kind kind);
+	static size_t TotalBytes(Kind kind);
+
+	static void ShowWindow(const char* title);
+	// one line per resource, largest first, then the totals
+	static void Dump(std::ostream& out);
+};
@@ -0,0 +1,136 @@
+#include "Impostor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "GpuResources.h"
+
+namespace
+{
+	// width in texels of a tile at the smallest mip level
+	const int MIN_MIP_TILE_SIZE = 4;
+
+	GLuint CreateAtlasTexture(const char* owner, GLenum internalFormat, int width, int height)
+	{
+		GLuint texture = GpuResources::CreateTexture(owner);
+		GpuResources::TexImage2D(GL_TEXTURE_2D, texture, internalFormat, width, height, GL_RGBA, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return texture;
+	}
+}
+
+ImpostorAtlas::~ImpostorAtlas()
+{
+	Clean();
+}
+
+void ImpostorAtlas::Clean()
+{
+	GpuResources::DeleteTexture(m_colorAtlas);
+	GpuResources::DeleteTexture(m_normalAtlas);
+}
+
+void ImpostorAtlas::Bake(const std::vector<Part>& prototype, ProgramObject& bakeProgram, int viewCount, int tileSize)
+{
+	Clean();
+	m_viewCount = viewCount;
+
+	// bounds of the prototype, the tiles are fitted to them
+	m_radius = 0;
+	m_height = glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+	for (const Part& part : prototype)
+	{
+		for (const Mesh::Vertex& vertex : part.mesh->getVertices())
+		{
+			m_radius = std::max(m_radius, glm::length(glm::vec2(vertex.position.x, vertex.position.z)));
+			m_height.x = std::min(m_height.x, vertex.position.y);
+			m_height.y = std::max(m_height.y, vertex.position.y);
+		}
+	}
+
+	const int width = tileSize * viewCount;
+	m_colorAtlas = CreateAtlasTexture("Impostor color atlas", GL_RGBA8, width, tileSize);
+	m_normalAtlas = CreateAtlasTexture("Impostor normal atlas", GL_RGBA16F, width, tileSize);
+
+	GLuint depth = GpuResources::CreateRenderbuffer("Impostor bake depth");
+	GpuResources::RenderbufferStorage(depth, GL_DEPTH_COMPONENT24, width, tileSize);
+
+	GLuint fbo = GpuResources::CreateFramebuffer("Impostor bake");
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorAtlas, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_normalAtlas, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "[ImpostorAtlas] Incomplete bake framebuffer" << std::endl;
+
+	GLint viewport[4];
+	GLfloat clearColor[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	// zero alpha marks the texels the prototype does not cover
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	bakeProgram.Use();
+	for (int view = 0; view < viewCount; ++view)
+	{
+		// the camera circles the vertical axis at the same angles impostor.vert picks the tiles by
+		float yaw = glm::two_pi<float>() * view / viewCount;
+		glm::vec3 direction(sin(yaw), 0, cos(yaw));
+		glm::mat4 viewMatrix = glm::lookAt(direction * (m_radius + 1.0f), glm::vec3(0), glm::vec3(0, 1, 0));
+		glm::mat4 projMatrix = glm::ortho(-m_radius, m_radius, m_height.x, m_height.y, 0.0f, 2.0f * m_radius + 2.0f);
+
+		glViewport(view * tileSize, 0, tileSize, tileSize);
+		bakeProgram.SetUniform("bake_view_proj", projMatrix * viewMatrix);
+		for (const Part& part : prototype)
+		{
+			bakeProgram.SetTexture("texImage", 0, part.texture);
+			part.mesh->draw();
+		}
+	}
+	bakeProgram.Unuse();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	GpuResources::DeleteFramebuffer(fbo);
+	GpuResources::DeleteRenderbuffer(depth);
+
+	// distant impostors cover a few pixels and would shimmer without mips. The box filter keeps power of two
+	// tiles apart, the chain stops while they are still a few texels wide so that bilinear taps near a tile's
+	// edge do not reach into the neighbouring view
+	GLint maxLevel = 0;
+	for (int size = tileSize; size > MIN_MIP_TILE_SIZE; size /= 2)
+		++maxLevel;
+	for (GLuint atlas : { m_colorAtlas, m_normalAtlas })
+	{
+		glBindTexture(GL_TEXTURE_2D, atlas);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		GpuResources::GenerateMipmap(GL_TEXTURE_2D, atlas);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void ImpostorAtlas::Apply(ProgramObject& program, int firstSampler) const
+{
+	program.SetTexture("color_atlas", firstSampler, m_colorAtlas);
+	program.SetTexture("normal_atlas", firstSampler + 1, m_normalAtlas);
+	program.SetUniform("view_count", m_viewCount);
+	program.SetUniform("bounds_radius", m_radius);
+	program.SetUniform("bounds_height", m_height);
+}
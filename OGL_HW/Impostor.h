@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Mesh_OGL3.h"
+#include "ProgramObject.h"
+
+/*
+	Pictures of a prototype mesh taken from viewCount directions around its vertical axis, side by side in
+	one row of tiles. The colour and the (prototype space) normal atlases hold the same data as the first two
+	G-buffer targets, so impostor.frag can write the G-buffer just like the geometry does.
+*/
+class ImpostorAtlas final
+{
+public:
+	// a mesh of the prototype and the texture it is drawn with
+	struct Part
+	{
+		Mesh*	mesh;
+		GLuint	texture;
+	};
+
+	ImpostorAtlas() = default;
+	~ImpostorAtlas();
+
+	ImpostorAtlas(const ImpostorAtlas&)				= delete;
+	ImpostorAtlas& operator=(const ImpostorAtlas&)	= delete;
+
+	// renders the prototype's parts with bakeProgram (impostor_bake.vert/frag) into a new pair of mipmapped
+	// atlases; tileSize should be a power of two, so that the tiles stay apart in the smaller levels
+	void Bake(const std::vector<Part>& prototype, ProgramObject& bakeProgram, int viewCount, int tileSize);
+
+	// binds the atlases to the two given samplers and sets the layout uniforms of impostor.vert
+	void Apply(ProgramObject& program, int firstSampler) const;
+
+	void Clean();
+
+private:
+	GLuint		m_colorAtlas = 0;
+	GLuint		m_normalAtlas = 0;
+	int			m_viewCount = 0;
+	float		m_radius = 0;		// largest distance from the vertical axis
+	glm::vec2	m_height{};			// lowest and highest point
+};
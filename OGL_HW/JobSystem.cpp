@@ -0,0 +1,441 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <string>
+
+#include "CpuProfiler.h"
+
+struct JobSystem::Job
+{
+	const char*				name;
+	std::function<void()>	function;
+	bool					mainThread;
+	std::atomic<int>		pending;		// unfinished dependencies, plus one while Create is still adding them
+	std::atomic<bool>		finished{ false };
+
+	std::mutex				mutex;			// guards the continuations and the exception, and finishing
+	std::vector<JobHandle>	continuations;
+	std::exception_ptr		exception;
+};
+
+namespace
+{
+	// the pool and worker index of the calling thread, -1 outside the pool's workers
+	thread_local JobSystem*	t_system = nullptr;
+	thread_local int		t_worker = -1;
+
+	template <typename Queue>
+	JobSystem::JobHandle PopFront(Queue& queue)
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			return nullptr;
+		JobSystem::JobHandle job = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+		return job;
+	}
+
+	template <typename Queue>
+	JobSystem::JobHandle PopBack(Queue& queue)
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			return nullptr;
+		JobSystem::JobHandle job = std::move(queue.jobs.back());
+		queue.jobs.pop_back();
+		return job;
+	}
+}
+
+JobSystem::JobSystem(int workerCount)
+	: m_mainThread(std::this_thread::get_id())
+{
+	if (workerCount < 0)
+		workerCount = static_cast<int>(std::max(std::thread::hardware_concurrency(), 2u)) - 1;
+
+	// every queue exists before the first worker could try to steal from it
+	for (int i = 0; i < workerCount; ++i)
+		m_queues.push_back(std::make_unique<WorkerQueue>());
+	for (int i = 0; i < workerCount; ++i)
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	// nothing is left half done, the main thread jobs run here too
+	while (m_unfinished > 0)
+	{
+		if (JobHandle job = FindJob(-1, IsMainThread()))
+			Execute(job);
+		else
+		{
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_jobFinished.wait_for(lock, std::chrono::milliseconds(1));
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_workAvailable.notify_all();
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+JobSystem::JobHandle JobSystem::Submit(const char* name, std::function<void()> function, const std::vector<JobHandle>& dependencies)
+{
+	return Create(name, std::move(function), false, dependencies);
+}
+
+JobSystem::JobHandle JobSystem::SubmitMainThread(const char* name, std::function<void()> function, const std::vector<JobHandle>& dependencies)
+{
+	return Create(name, std::move(function), true, dependencies);
+}
+
+JobSystem::JobHandle JobSystem::Create(const char* name, std::function<void()> function, bool mainThread, const std::vector<JobHandle>& dependencies)
+{
+	JobHandle job = std::make_shared<Job>();
+	job->name = name;
+	job->function = std::move(function);
+	job->mainThread = mainThread;
+	job->pending = static_cast<int>(dependencies.size()) + 1;
+	++m_unfinished;
+
+	for (const JobHandle& dependency : dependencies)
+	{
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (!dependency->finished)
+		{
+			dependency->continuations.push_back(job);
+			continue;
+		}
+
+		if (dependency->exception)
+		{
+			std::lock_guard<std::mutex> jobLock(job->mutex);
+			job->exception = dependency->exception;
+		}
+		--job->pending;
+	}
+
+	if (--job->pending == 0)
+		Schedule(job);
+	return job;
+}
+
+void JobSystem::Schedule(JobHandle job)
+{
+	if (job->mainThread)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mainQueue.mutex);
+			m_mainQueue.jobs.push_back(std::move(job));
+		}
+		// the main thread may be sleeping in Wait
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_jobFinished.notify_all();
+		return;
+	}
+
+	// a worker keeps what it spawns, the front of its deque is for the thieves
+	WorkerQueue& queue = t_system == this && t_worker >= 0 ? *m_queues[t_worker] : m_shared;
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		++m_queued;
+	}
+	m_workAvailable.notify_one();
+}
+
+void JobSystem::Execute(const JobHandle& job)
+{
+	{
+		CpuZone zone(job->name);
+		// a failed dependency skips the job
+		if (!job->exception)
+		{
+			try
+			{
+				job->function();
+			}
+			catch (...)
+			{
+				job->exception = std::current_exception();
+			}
+		}
+		job->function = nullptr;
+	}
+
+	std::vector<JobHandle> continuations;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finished = true;
+		continuations.swap(job->continuations);
+	}
+
+	for (JobHandle& continuation : continuations)
+	{
+		if (job->exception)
+		{
+			std::lock_guard<std::mutex> lock(continuation->mutex);
+			if (!continuation->exception)
+				continuation->exception = job->exception;
+		}
+		if (--continuation->pending == 0)
+			Schedule(std::move(continuation));
+	}
+
+	--m_unfinished;
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_jobFinished.notify_all();
+}
+
+JobSystem::JobHandle JobSystem::FindJob(int worker, bool mainThreadJobs)
+{
+	JobHandle job;
+	if (worker >= 0)
+		job = PopBack(*m_queues[worker]);
+	if (!job)
+		job = PopFront(m_shared);
+	if (!job && !m_queues.empty())
+	{
+		// the victims are tried in turn, starting somewhere else each time
+		size_t start = m_stealStart++;
+		for (size_t i = 0; i < m_queues.size() && !job; ++i)
+		{
+			size_t victim = (start + i) % m_queues.size();
+			if (static_cast<int>(victim) != worker)
+				job = PopFront(*m_queues[victim]);
+		}
+	}
+
+	if (job)
+		--m_queued;
+	else if (mainThreadJobs)
+		job = PopFront(m_mainQueue);
+	return job;
+}
+
+void JobSystem::WorkerLoop(int worker)
+{
+	t_system = this;
+	t_worker = worker;
+	CpuProfiler::SetThreadName("worker " + std::to_string(worker));
+
+	for (;;)
+	{
+		if (JobHandle job = FindJob(worker, false))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_workAvailable.wait(lock, [this] { return m_stop || m_queued > 0; });
+		if (m_stop && m_queued == 0)
+			return;
+	}
+}
+
+void JobSystem::Wait(const JobHandle& job)
+{
+	const int worker = t_system == this ? t_worker : -1;
+	const bool mainThread = IsMainThread();
+
+	// help instead of blocking a thread the job may need
+	while (!job->finished)
+	{
+		if (JobHandle other = FindJob(worker, mainThread))
+		{
+			Execute(other);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_jobFinished.wait(lock, [&]
+		{
+			if (job->finished || m_queued > 0)
+				return true;
+			std::lock_guard<std::mutex> mainLock(m_mainQueue.mutex);
+			return mainThread && !m_mainQueue.jobs.empty();
+		});
+	}
+
+	if (job->exception)
+		std::rethrow_exception(job->exception);
+}
+
+void JobSystem::Wait(const std::vector<JobHandle>& jobs)
+{
+	for (const JobHandle& job : jobs)
+		Wait(job);
+}
+
+void JobSystem::ParallelFor(size_t count, const RangeFunction& body, size_t grainSize)
+{
+	grainSize = std::max<size_t>(grainSize, 1);
+	if (count <= grainSize || m_workers.empty())
+	{
+		body(0, count);
+		return;
+	}
+
+	// a few ranges per thread, so that stealing can even out uneven ones
+	const size_t threads = m_workers.size() + 1;
+	const size_t perRange = (count + threads * 4 - 1) / (threads * 4);
+	const size_t rangeSize = std::max(grainSize, (perRange + grainSize - 1) / grainSize * grainSize);
+
+	std::vector<JobHandle> jobs;
+	for (size_t begin = rangeSize; begin < count; begin += rangeSize)
+	{
+		size_t end = std::min(begin + rangeSize, count);
+		jobs.push_back(Submit("ParallelFor", [&body, begin, end] { body(begin, end); }));
+	}
+
+	// the ranges refer to body, so they all have to finish before anything is thrown
+	std::exception_ptr error;
+	try
+	{
+		body(0, rangeSize);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	for (const JobHandle& job : jobs)
+	{
+		try
+		{
+			Wait(job);
+		}
+		catch (...)
+		{
+			if (!error)
+				error = std::current_exception();
+		}
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+size_t JobSystem::RunMainThreadJobs()
+{
+	size_t count = 0;
+	while (JobHandle job = PopFront(m_mainQueue))
+	{
+		Execute(job);
+		++count;
+	}
+	return count;
+}
+
+bool JobSystem::RunScalingBenchmark(std::ostream& out, unsigned int maxThreads)
+{
+	using Clock = std::chrono::steady_clock;
+
+	// a few dozen nanoseconds of integer work, so that the results can be compared exactly
+	auto work = [](uint64_t x)
+	{
+		for (int round = 0; round < 16; ++round)
+		{
+			x ^= x >> 31;
+			x *= 0xBF58476D1CE4E5B9ull;
+		}
+		return x;
+	};
+
+	const size_t count = 1 << 22;
+	const size_t graphWidth = 64;
+	const size_t graphDepth = 64;
+	const size_t workPerNode = 2048;
+
+	// the graph's nodes mix their three neighbours in the layer above, a node run too early reads a zero
+	auto node = [&work, workPerNode](uint64_t left, uint64_t middle, uint64_t right)
+	{
+		uint64_t value = left + 3 * middle + 7 * right;
+		for (size_t i = 0; i < workPerNode; ++i)
+			value = work(value + i);
+		return value;
+	};
+
+	auto runGraph = [&](std::vector<uint64_t>& values, JobSystem* jobs)
+	{
+		std::vector<JobHandle> previous(graphWidth), current(graphWidth);
+		for (size_t i = 0; i < graphWidth; ++i)
+			values[i] = i + 1;
+		for (size_t layer = 1; layer <= graphDepth; ++layer)
+		{
+			for (size_t i = 0; i < graphWidth; ++i)
+			{
+				size_t left = (i + graphWidth - 1) % graphWidth;
+				size_t right = (i + 1) % graphWidth;
+				uint64_t* above = &values[(layer - 1) * graphWidth];
+				uint64_t* target = &values[layer * graphWidth + i];
+				auto compute = [&node, above, target, left, i, right] { *target = node(above[left], above[i], above[right]); };
+				if (jobs == nullptr)
+					compute();
+				else if (layer == 1)
+					current[i] = jobs->Submit("Graph node", compute);
+				else
+					current[i] = jobs->Submit("Graph node", compute, { previous[left], previous[i], previous[right] });
+			}
+			previous.swap(current);
+		}
+		if (jobs != nullptr)
+			jobs->Wait(previous);
+	};
+
+	// serial references
+	uint64_t expectedSum = 0;
+	for (size_t i = 0; i < count; ++i)
+		expectedSum += work(i);
+	std::vector<uint64_t> expectedGraph((graphDepth + 1) * graphWidth);
+	runGraph(expectedGraph, nullptr);
+
+	out << "threads  parallel-for ms  speedup  task graph ms  speedup\n" << std::fixed << std::setprecision(2);
+	bool allCorrect = true;
+	double singleFor = 0.0, singleGraph = 0.0;
+	for (unsigned int threads = 1; threads <= std::max(maxThreads, 1u); threads *= 2)
+	{
+		JobSystem jobs(static_cast<int>(threads) - 1);
+
+		std::atomic<uint64_t> sum{ 0 };
+		Clock::time_point start = Clock::now();
+		jobs.ParallelFor(count, [&](size_t begin, size_t end)
+		{
+			uint64_t partial = 0;
+			for (size_t i = begin; i < end; ++i)
+				partial += work(i);
+			sum += partial;
+		}, 4096);
+		double forMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		std::vector<uint64_t> graph((graphDepth + 1) * graphWidth, 0);
+		start = Clock::now();
+		runGraph(graph, &jobs);
+		double graphMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		if (threads == 1)
+		{
+			singleFor = forMs;
+			singleGraph = graphMs;
+		}
+
+		bool correct = sum == expectedSum && graph == expectedGraph;
+		allCorrect = allCorrect && correct;
+		out << std::setw(7) << threads << std::setw(17) << forMs << std::setw(9) << singleFor / forMs
+			<< std::setw(15) << graphMs << std::setw(9) << singleGraph / graphMs << (correct ? "" : "  WRONG RESULT") << "\n";
+	}
+	return allCorrect;
+}
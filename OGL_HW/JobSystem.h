@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+/*
+	Work-stealing thread pool. Every worker has its own deque: it pushes and pops the jobs it spawns at the
+	back, idle workers steal from the front of the others'. Jobs submitted from outside the pool go to a shared
+	queue that every worker takes from.
+
+	A job can depend on others and only starts once they have all finished, so loading or frame work can be
+	built as a graph. Main thread jobs (anything touching GL) are never run by the workers: they wait until the
+	main thread calls RunMainThreadJobs or Wait. A thread that waits for a job runs other jobs meanwhile, so
+	jobs may wait for the jobs they spawn.
+
+	A job that throws passes its exception on to the jobs depending on it (which are skipped) and to Wait.
+*/
+class JobSystem final
+{
+public:
+	struct Job;
+	using JobHandle = std::shared_ptr<Job>;
+	using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+	// the constructing thread is the main thread; a negative workerCount gives one worker per other hardware thread
+	explicit JobSystem(int workerCount = -1);
+	// runs every job still queued, then stops the workers
+	~JobSystem();
+
+	JobSystem(const JobSystem&)				= delete;
+	JobSystem& operator=(const JobSystem&)	= delete;
+
+	// the name is the job's CPU zone, it has to be a string literal
+	JobHandle Submit(const char* name, std::function<void()> function, const std::vector<JobHandle>& dependencies = {});
+	JobHandle SubmitMainThread(const char* name, std::function<void()> function, const std::vector<JobHandle>& dependencies = {});
+
+	// rethrows the job's exception
+	void Wait(const JobHandle& job);
+	void Wait(const std::vector<JobHandle>& jobs);
+
+	// body(begin, end) over ranges of grainSize (a multiple of it, except for the last one) covering [0, count);
+	// returns when all have run
+	void ParallelFor(size_t count, const RangeFunction& body, size_t grainSize = 256);
+
+	// runs the main thread jobs that are ready, returns how many
+	size_t RunMainThreadJobs();
+
+	unsigned int WorkerCount() const { return static_cast<unsigned int>(m_workers.size()); }
+	bool IsMainThread() const { return std::this_thread::get_id() == m_mainThread; }
+
+	// parallel-for and task graph timings for 1, 2, 4 ... maxThreads threads, each result checked against a serial run;
+	// false if any is wrong
+	static bool RunScalingBenchmark(std::ostream& out, unsigned int maxThreads = 64);
+
+private:
+	struct WorkerQueue
+	{
+		std::mutex				mutex;
+		std::deque<JobHandle>	jobs;
+	};
+
+	JobHandle Create(const char* name, std::function<void()> function, bool mainThread, const std::vector<JobHandle>& dependencies);
+	void Schedule(JobHandle job);
+	void Execute(const JobHandle& job);
+	JobHandle FindJob(int worker, bool mainThreadJobs);
+	void WorkerLoop(int worker);
+
+	std::vector<std::thread>					m_workers;
+	std::vector<std::unique_ptr<WorkerQueue>>	m_queues;		// one per worker
+	WorkerQueue									m_shared;		// submitted from outside the pool
+	WorkerQueue									m_mainQueue;
+	std::thread::id								m_mainThread;
+
+	std::mutex									m_sleepMutex;
+	std::condition_variable						m_workAvailable;	// workers sleep on it
+	std::condition_variable						m_jobFinished;		// waiting threads sleep on it
+	std::atomic<size_t>							m_queued{ 0 };		// worker jobs scheduled but not taken yet
+	std::atomic<size_t>							m_unfinished{ 0 };
+	std::atomic<unsigned int>					m_stealStart{ 0 };
+	bool										m_stop = false;
+};
@@ -0,0 +1,264 @@
+#include "LightSimulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LIGHT_SIMULATION_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIGHT_SIMULATION_SSE
+#endif
+
+#include "CpuProfiler.h"
+
+namespace
+{
+	const float ARRIVAL_DISTANCE_SQUARED = LightSimulation::ARRIVAL_DISTANCE * LightSimulation::ARRIVAL_DISTANCE;
+	// keeps the division defined for a light that sits exactly on its goal
+	const float MIN_DISTANCE = 1e-6f;
+
+	// splitmix32, spreads consecutive seeds over the xorshift state space; never returns 0
+	uint32_t SeedFor(uint32_t seed, size_t light)
+	{
+		uint32_t z = seed + static_cast<uint32_t>(light) * 0x9E3779B9u;
+		z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+		z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+		z ^= z >> 16;
+		return z != 0 ? z : 1;
+	}
+}
+
+LightSimulation::LightSimulation(size_t count, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float speed, uint32_t seed)
+	: m_x(count), m_y(count), m_z(count), m_goalX(count), m_goalY(count), m_goalZ(count), m_random(count),
+	  m_boundsMin(boundsMin), m_boundsSize(boundsMax - boundsMin), m_speed(speed)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_random[i] = SeedFor(seed, i);
+		// start on a random goal, then pick the first real one
+		NewGoal(i);
+		m_x[i] = m_goalX[i];
+		m_y[i] = m_goalY[i];
+		m_z[i] = m_goalZ[i];
+		NewGoal(i);
+	}
+}
+
+float LightSimulation::NextRandom(size_t light)
+{
+	// xorshift32, 24 bits of it as a float in [0, 1)
+	uint32_t x = m_random[light];
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	m_random[light] = x;
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+void LightSimulation::NewGoal(size_t light)
+{
+	m_goalX[light] = m_boundsMin.x + NextRandom(light) * m_boundsSize.x;
+	m_goalY[light] = m_boundsMin.y + NextRandom(light) * m_boundsSize.y;
+	m_goalZ[light] = m_boundsMin.z + NextRandom(light) * m_boundsSize.z;
+}
+
+void LightSimulation::Step(float deltaTime, Kernel kernel, const ParallelFor& parallelFor)
+{
+	CPU_ZONE("LightSimulation::Step");
+
+	const float maxStep = m_speed * deltaTime;
+	auto body = [this, kernel, maxStep](size_t begin, size_t end)
+	{
+		if (kernel == Kernel::Simd)
+			StepSimd(begin, end, maxStep);
+		else
+			StepScalar(begin, end, maxStep);
+	};
+
+	if (parallelFor)
+		parallelFor(Count(), body);
+	else
+		body(0, Count());
+}
+
+void LightSimulation::StepScalar(size_t begin, size_t end, float maxStep)
+{
+	for (size_t i = begin; i < end; ++i)
+	{
+		float dx = m_goalX[i] - m_x[i];
+		float dy = m_goalY[i] - m_y[i];
+		float dz = m_goalZ[i] - m_z[i];
+		float distanceSquared = dx * dx + dy * dy + dz * dz;
+		if (distanceSquared < ARRIVAL_DISTANCE_SQUARED)
+		{
+			NewGoal(i);
+			dx = m_goalX[i] - m_x[i];
+			dy = m_goalY[i] - m_y[i];
+			dz = m_goalZ[i] - m_z[i];
+			distanceSquared = dx * dx + dy * dy + dz * dz;
+		}
+
+		// never past the goal, however long the frame was
+		float distance = std::max(std::sqrt(distanceSquared), MIN_DISTANCE);
+		float scale = std::min(maxStep, distance) / distance;
+		m_x[i] += dx * scale;
+		m_y[i] += dy * scale;
+		m_z[i] += dz * scale;
+	}
+}
+
+#if defined(LIGHT_SIMULATION_AVX)
+
+void LightSimulation::StepSimd(size_t begin, size_t end, float maxStep)
+{
+	const size_t simdEnd = begin + (end - begin) / 8 * 8;
+	const __m256 arrival = _mm256_set1_ps(ARRIVAL_DISTANCE_SQUARED);
+	const __m256 minDistance = _mm256_set1_ps(MIN_DISTANCE);
+	const __m256 step = _mm256_set1_ps(maxStep);
+
+	for (size_t i = begin; i < simdEnd; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&m_x[i]), y = _mm256_loadu_ps(&m_y[i]), z = _mm256_loadu_ps(&m_z[i]);
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&m_goalX[i]), x);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&m_goalY[i]), y);
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&m_goalZ[i]), z);
+		__m256 distanceSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+		// arrivals are rare, the lanes that need a new goal are handled one by one
+		int arrived = _mm256_movemask_ps(_mm256_cmp_ps(distanceSquared, arrival, _CMP_LT_OQ));
+		if (arrived != 0)
+		{
+			for (int lane = 0; lane < 8; ++lane)
+				if (arrived & (1 << lane))
+					NewGoal(i + lane);
+			dx = _mm256_sub_ps(_mm256_loadu_ps(&m_goalX[i]), x);
+			dy = _mm256_sub_ps(_mm256_loadu_ps(&m_goalY[i]), y);
+			dz = _mm256_sub_ps(_mm256_loadu_ps(&m_goalZ[i]), z);
+			distanceSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		}
+
+		__m256 distance = _mm256_max_ps(_mm256_sqrt_ps(distanceSquared), minDistance);
+		__m256 scale = _mm256_div_ps(_mm256_min_ps(step, distance), distance);
+		_mm256_storeu_ps(&m_x[i], _mm256_add_ps(x, _mm256_mul_ps(dx, scale)));
+		_mm256_storeu_ps(&m_y[i], _mm256_add_ps(y, _mm256_mul_ps(dy, scale)));
+		_mm256_storeu_ps(&m_z[i], _mm256_add_ps(z, _mm256_mul_ps(dz, scale)));
+	}
+
+	StepScalar(simdEnd, end, maxStep);
+}
+
+#elif defined(LIGHT_SIMULATION_SSE)
+
+void LightSimulation::StepSimd(size_t begin, size_t end, float maxStep)
+{
+	const size_t simdEnd = begin + (end - begin) / 4 * 4;
+	const __m128 arrival = _mm_set1_ps(ARRIVAL_DISTANCE_SQUARED);
+	const __m128 minDistance = _mm_set1_ps(MIN_DISTANCE);
+	const __m128 step = _mm_set1_ps(maxStep);
+
+	for (size_t i = begin; i < simdEnd; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&m_x[i]), y = _mm_loadu_ps(&m_y[i]), z = _mm_loadu_ps(&m_z[i]);
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&m_goalX[i]), x);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(&m_goalY[i]), y);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(&m_goalZ[i]), z);
+		__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		// arrivals are rare, the lanes that need a new goal are handled one by one
+		int arrived = _mm_movemask_ps(_mm_cmplt_ps(distanceSquared, arrival));
+		if (arrived != 0)
+		{
+			for (int lane = 0; lane < 4; ++lane)
+				if (arrived & (1 << lane))
+					NewGoal(i + lane);
+			dx = _mm_sub_ps(_mm_loadu_ps(&m_goalX[i]), x);
+			dy = _mm_sub_ps(_mm_loadu_ps(&m_goalY[i]), y);
+			dz = _mm_sub_ps(_mm_loadu_ps(&m_goalZ[i]), z);
+			distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		}
+
+		__m128 distance = _mm_max_ps(_mm_sqrt_ps(distanceSquared), minDistance);
+		__m128 scale = _mm_div_ps(_mm_min_ps(step, distance), distance);
+		_mm_storeu_ps(&m_x[i], _mm_add_ps(x, _mm_mul_ps(dx, scale)));
+		_mm_storeu_ps(&m_y[i], _mm_add_ps(y, _mm_mul_ps(dy, scale)));
+		_mm_storeu_ps(&m_z[i], _mm_add_ps(z, _mm_mul_ps(dz, scale)));
+	}
+
+	StepScalar(simdEnd, end, maxStep);
+}
+
+#else
+
+void LightSimulation::StepSimd(size_t begin, size_t end, float maxStep)
+{
+	StepScalar(begin, end, maxStep);
+}
+
+#endif
+
+const char* LightSimulation::SimdName()
+{
+#if defined(LIGHT_SIMULATION_AVX)
+	return "AVX";
+#elif defined(LIGHT_SIMULATION_SSE)
+	return "SSE";
+#else
+	return "none";
+#endif
+}
+
+void LightSimulation::GatherPositions(glm::vec3* positions) const
+{
+	for (size_t i = 0; i < Count(); ++i)
+		positions[i] = glm::vec3(m_x[i], m_y[i], m_z[i]);
+}
+
+LightSimulation::LightState LightSimulation::GetState(size_t light) const
+{
+	return { Position(light), glm::vec3(m_goalX[light], m_goalY[light], m_goalZ[light]), m_random[light] };
+}
+
+void LightSimulation::SetState(size_t light, const LightState& state)
+{
+	m_x[light] = state.position.x;
+	m_y[light] = state.position.y;
+	m_z[light] = state.position.z;
+	m_goalX[light] = state.goal.x;
+	m_goalY[light] = state.goal.y;
+	m_goalZ[light] = state.goal.z;
+	m_random[light] = state.random != 0 ? state.random : 1;
+}
+
+std::vector<LightSimulation::BenchmarkResult> LightSimulation::Benchmark(const std::vector<size_t>& counts, int steps, const ParallelFor& parallelFor)
+{
+	CPU_ZONE("LightSimulation::Benchmark");
+
+	auto measure = [steps](LightSimulation& simulation, Kernel kernel, const ParallelFor& parallel)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int step = 0; step < steps; ++step)
+			simulation.Step(1.0f / 60.0f, kernel, parallel);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count() / steps;
+	};
+
+	std::vector<BenchmarkResult> results;
+	for (size_t count : counts)
+	{
+		// the same flight for every kernel, in a box the size of the scene's
+		const glm::vec3 boundsMin(-350, 35, -350), boundsMax(350, 135, 350);
+		LightSimulation scalar(count, boundsMin, boundsMax, 60.0f, 1234);
+		LightSimulation simd(count, boundsMin, boundsMax, 60.0f, 1234);
+		LightSimulation parallel(count, boundsMin, boundsMax, 60.0f, 1234);
+
+		BenchmarkResult result{ count };
+		result.scalarMs = measure(scalar, Kernel::Scalar, nullptr);
+		result.simdMs = measure(simd, Kernel::Simd, nullptr);
+		result.parallelMs = measure(parallel, Kernel::Simd, parallelFor);
+		results.push_back(result);
+	}
+	return results;
+}
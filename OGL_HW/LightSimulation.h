@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+	Point lights flying towards random goals in a box, each picking a new goal when it gets closer than
+	ARRIVAL_DISTANCE. The state is kept as structure of arrays, so that the SIMD kernel moves 4 (SSE) or 8 (AVX)
+	lights with every instruction; the scalar kernel gives the same results and handles the remainders.
+
+	Every light has its own xorshift state, so the goals do not depend on how the lights are split between
+	threads, and a seed always gives the same flight. Motion is in units per second.
+*/
+class LightSimulation final
+{
+public:
+	enum class Kernel
+	{
+		Scalar,
+		Simd
+	};
+
+	// runs body(begin, end) over ranges covering [0, count), possibly in parallel, and returns when all are done
+	using ParallelFor = std::function<void(size_t count, const std::function<void(size_t begin, size_t end)>& body)>;
+
+	static constexpr float ARRIVAL_DISTANCE = 2.0f;
+
+	// one light's whole state, for handing the flight over to another simulation (e.g. on the GPU) and back
+	struct LightState
+	{
+		glm::vec3	position;
+		glm::vec3	goal;
+		uint32_t	random;
+	};
+
+	LightSimulation(size_t count, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float speed, uint32_t seed);
+
+	void Step(float deltaTime, Kernel kernel = Kernel::Simd, const ParallelFor& parallelFor = nullptr);
+
+	size_t Count() const { return m_x.size(); }
+	glm::vec3 Position(size_t light) const { return glm::vec3(m_x[light], m_y[light], m_z[light]); }
+	// writes Count() positions, for uploading as a vec3 array
+	void GatherPositions(glm::vec3* positions) const;
+
+	LightState GetState(size_t light) const;
+	void SetState(size_t light, const LightState& state);
+
+	const glm::vec3& BoundsMin() const { return m_boundsMin; }
+	const glm::vec3& BoundsSize() const { return m_boundsSize; }
+	float Speed() const { return m_speed; }
+
+	// "AVX", "SSE" or "none", as compiled
+	static const char* SimdName();
+
+	// milliseconds per step, for each light count
+	struct BenchmarkResult
+	{
+		size_t	count;
+		double	scalarMs;
+		double	simdMs;
+		double	parallelMs;
+	};
+	static std::vector<BenchmarkResult> Benchmark(const std::vector<size_t>& counts, int steps, const ParallelFor& parallelFor);
+
+private:
+	void StepScalar(size_t begin, size_t end, float maxStep);
+	void StepSimd(size_t begin, size_t end, float maxStep);
+	void NewGoal(size_t light);
+	float NextRandom(size_t light);
+
+	std::vector<float>		m_x, m_y, m_z;
+	std::vector<float>		m_goalX, m_goalY, m_goalZ;
+	std::vector<uint32_t>	m_random;
+	glm::vec3				m_boundsMin;
+	glm::vec3				m_boundsSize;
+	float					m_speed;
+};
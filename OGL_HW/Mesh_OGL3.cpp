@@ -1,4 +1,7 @@
 #include "Mesh_OGL3.h"
+#include "GpuResources.h"
+
+#include <iostream>
 
 Mesh::Mesh(void)
 {
@@ -10,21 +13,50 @@ Mesh::~Mesh(void)
 	{
 		glDeleteVertexArrays(1, &vertexArrayObject);
 
-		glDeleteBuffers(1, &vertexBuffer);
-		glDeleteBuffers(1, &indexBuffer);
+		GpuResources::DeleteBuffer(vertexBuffer);
+		GpuResources::DeleteBuffer(indexBuffer);
 	}
 }
 
-void Mesh::initBuffers()
+void Mesh::initBuffers(const std::string& owner)
 {
-	glGenVertexArrays(1, &vertexArrayObject);
-	glGenBuffers(1, &vertexBuffer);
-	glGenBuffers(1, &indexBuffer);
+	// &vertices[0] of an empty vector is undefined, and zero sized immutable storage an error
+	if (indices.empty())
+	{
+		std::cerr << "[Mesh] " << owner << " has no triangles, nothing is uploaded" << std::endl;
+		return;
+	}
+
+	vertexBuffer = GpuResources::CreateBuffer(owner + " vertices");
+	indexBuffer = GpuResources::CreateBuffer(owner + " indices");
+
+	// the mesh never changes, so its buffers get immutable storage, and the layout is set up without binding anything
+	if (GpuResources::DirectStateAccess())
+	{
+		glCreateVertexArrays(1, &vertexArrayObject);
+
+		GpuResources::NamedBufferStorage(vertexBuffer, sizeof(Vertex)*vertices.size(), (void*)&vertices[0], 0);
+		GpuResources::NamedBufferStorage(indexBuffer, sizeof(unsigned int)*indices.size(), (void*)&indices[0], 0);
 
+		glVertexArrayVertexBuffer(vertexArrayObject, VERTEX_BINDING, vertexBuffer, 0, sizeof(Vertex));
+		glVertexArrayElementBuffer(vertexArrayObject, indexBuffer);
+		glVertexArrayAttribFormat(vertexArrayObject, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribFormat(vertexArrayObject, 1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3));
+		glVertexArrayAttribFormat(vertexArrayObject, 2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec3) * 2);
+		for (GLuint attribute = 0; attribute < 3; ++attribute)
+		{
+			glEnableVertexArrayAttrib(vertexArrayObject, attribute);
+			glVertexArrayAttribBinding(vertexArrayObject, attribute, VERTEX_BINDING);
+		}
+
+		inited = true;
+		return;
+	}
+
+	glGenVertexArrays(1, &vertexArrayObject);
 	glBindVertexArray(vertexArrayObject);
 
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*vertices.size(), (void*)&vertices[0], GL_STREAM_DRAW);
+	GpuResources::BufferData(GL_ARRAY_BUFFER, vertexBuffer, sizeof(Vertex)*vertices.size(), (void*)&vertices[0], GL_STATIC_DRAW);
 
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
@@ -33,8 +65,7 @@ void Mesh::initBuffers()
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec3) * 2));
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*indices.size(), (void*)&indices[0], GL_STREAM_DRAW);
+	GpuResources::BufferData(GL_ELEMENT_ARRAY_BUFFER, indexBuffer, sizeof(unsigned int)*indices.size(), (void*)&indices[0], GL_STATIC_DRAW);
 
 	glBindVertexArray(0);
 
@@ -47,5 +78,46 @@ void Mesh::draw()
 
 	glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0);
 
+	glBindVertexArray(0);
+}
+
+void Mesh::setInstanceTransforms(GLuint buffer)
+{
+	if (GpuResources::DirectStateAccess())
+	{
+		glVertexArrayVertexBuffer(vertexArrayObject, INSTANCE_BINDING, buffer, 0, sizeof(glm::mat4));
+		glVertexArrayBindingDivisor(vertexArrayObject, INSTANCE_BINDING, 1);
+		for (GLuint column = 0; column < 4; ++column)
+		{
+			glEnableVertexArrayAttrib(vertexArrayObject, 3 + column);
+			glVertexArrayAttribFormat(vertexArrayObject, 3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * column);
+			glVertexArrayAttribBinding(vertexArrayObject, 3 + column, INSTANCE_BINDING);
+		}
+		return;
+	}
+
+	glBindVertexArray(vertexArrayObject);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	// a mat4 attribute takes four consecutive locations, one column each
+	for (GLuint column = 0; column < 4; ++column)
+	{
+		glEnableVertexAttribArray(3 + column);
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(3 + column, 1);
+	}
+
+	glBindVertexArray(0);
+}
+
+void Mesh::drawInstanced(GLsizei instanceCount, GLuint baseInstance)
+{
+	glBindVertexArray(vertexArrayObject);
+
+	if (baseInstance == 0)
+		glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
+	else
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0, instanceCount, baseInstance);
+
 	glBindVertexArray(0);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <GL/glew.h>
 
+#include <string>
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -18,16 +19,28 @@ public:
 	Mesh(void);
 	~Mesh(void);
 
-	void initBuffers();
+	// owner names the buffers in GpuResources; a mesh without indices is left without buffers
+	void initBuffers(const std::string& owner = "Mesh");
 	void draw();
 
+	// per-instance model matrices read from buffer at attribute locations 3..6, advancing once per instance
+	void setInstanceTransforms(GLuint buffer);
+	void drawInstanced(GLsizei instanceCount, GLuint baseInstance = 0);
+
 	void addVertex(const Vertex& vertex) {
 		vertices.push_back(vertex);
 	}
 	void addIndex(unsigned int index) {
 		indices.push_back(index);
 	}
+
+	const std::vector<Vertex>& getVertices() const { return vertices; }
+	const std::vector<unsigned int>& getIndices() const { return indices; }
 private:
+	// vertex buffer binding points of the array with direct state access
+	static const GLuint VERTEX_BINDING = 0;
+	static const GLuint INSTANCE_BINDING = 1;
+
 	GLuint vertexArrayObject;
 	GLuint vertexBuffer;
 	GLuint indexBuffer;
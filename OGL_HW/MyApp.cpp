@@ -9,14 +9,57 @@
 #include <imgui/imgui.h>
 #include <random>
 #include <cmath>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <limits>
 #include "glm/ext.hpp"
 #include "ObjParser_OGL3.h"
+#include "CpuProfiler.h"
+#include "GpuResources.h"
 
-CMyApp::CMyApp(int w_init, int h_init)
+CMyApp::CMyApp(int w_init, int h_init, JobSystem& jobs, unsigned int seed) : programVariants(programCache), renderGraph(renderTargets), jobSystem(jobs), rng(seed)
 {
 	t = 0.0f;
+	fixedTimestep = 0.0;
+	cameraPath = nullptr;
+	programLightAnimation = nullptr;
+	programLightRendererSsbo = nullptr;
+	gpuLightAnimationSupported = false;
+	gpuLightAnimation = false;
+	lightTime = 0.0;
+	gpuLightTime = 0.0;
+	lightMarkerVaoBuffer = 0;
+	lightMarkerVaoOffset = 0;
+	lightMarkerVaoGeneration = 0;
+	allocationTotals = AllocationCounter::Now();
+	frameAllocations = { 0, 0 };
+	simulatedFrames = 0;
+	renderedFrame = 0;
+	inputPending = false;
+	inputTime = 0;
+	// room for a burst of events, so that queueing them does not allocate
+	pendingInput.reserve(64);
+	simulationInput.reserve(64);
+	cameraPathTime = 0.0f;
 	frameBufferCreated = false;
 	frozen = false;
+	shadowsEnabled = true;
+	adaptiveTessellation = true;
+	tessPixelsPerEdge = 12.0f;
+	spherePrimitives = 0;
+	lightMarkerMode = LightMarkerMode::Tessellated;
+	runLightMarkerBenchmark = false;
+	depthPrepassEnabled = true;
+	vegetationDensity = 1.0f;
+	vegetationDirty = false;
+	impostorsEnabled = true;
+	impostorDistance = 120.0f;
+	captureGBuffer = false;
+	captureCount = 0;
+	overdrawEnabled = false;
+	overdrawDepthTest = true;
+	overdrawMax = 8.0f;
 	width = w_init;
 	height = h_init;
 	camera.SetView(glm::vec3(5, 5, 5), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
@@ -29,35 +72,129 @@ CMyApp::~CMyApp(void)
 	std::cout << "dtor!\n";
 }
 
+float CMyApp::RandomUnit()
+{
+	return std::uniform_real_distribution<float>(0.0f, 1.0f)(rng);
+}
+
 void CMyApp::LoadAssets()
 {
-	mesh_terrain = ObjParser::parse("terrain.obj");
-	tex_terrain.FromFile("sand.jpg");
-	std::cout << "terrain assets loaded\n";
+	CPU_ZONE("CMyApp::LoadAssets");
 
-	mesh_grass = ObjParser::parse("grass.obj");
-	tex_grass.FromFile("grass.jpg");
-	std::cout << "grass assets loaded\n";
+	// OBJ parsing and image decoding run on the workers, each is followed by a main thread job for its GL upload
+	std::vector<JobSystem::JobHandle> uploads;
+	auto loadMesh = [this, &uploads](std::unique_ptr<Mesh>& mesh, const char* fileName)
+	{
+		JobSystem::JobHandle parse = jobSystem.Submit("Parse OBJ", [&mesh, fileName] { mesh = ObjParser::load(fileName); });
+		uploads.push_back(jobSystem.SubmitMainThread("Upload mesh", [&mesh, fileName] { mesh->initBuffers(fileName); }, { parse }));
+		return parse;
+	};
+	auto loadTexture = [this, &uploads](Texture2D& texture, const char* fileName)
+	{
+		auto image = std::make_shared<SDL_Surface*>(nullptr);
+		JobSystem::JobHandle decode = jobSystem.Submit("Decode image", [image, fileName] { *image = IMG_Load(fileName); });
+		uploads.push_back(jobSystem.SubmitMainThread("Upload texture", [&texture, image, fileName]
+		{
+			if (*image == nullptr)
+				std::cerr << "[LoadAssets] Error loading image file " << fileName << std::endl;
+			else
+				texture.AttachFromSurface(*image, fileName);
+			SDL_FreeSurface(*image);
+		}, { decode }));
+	};
+
+	// grass.obj and plants.obj hold a field of tufts modelled in place, one of them is instanced over the terrain instead
+	auto loadVegetation = [this, &uploads](std::unique_ptr<VegetationLayer>& layer, const char* fileName, const Texture2D& texture)
+	{
+		auto prototype = std::make_shared<std::unique_ptr<Mesh>>();
+		JobSystem::JobHandle extract = jobSystem.Submit("Extract prototype", [prototype, fileName]
+		{
+			*prototype = VegetationSource(*ObjParser::load(fileName), 0.0f).Prototype();
+		});
+		JobSystem::JobHandle upload = jobSystem.SubmitMainThread("Upload prototype", [&layer, &texture, prototype, fileName]
+		{
+			(*prototype)->initBuffers(fileName);
+			layer = std::make_unique<VegetationLayer>(std::move(*prototype), texture);
+		}, { extract });
+		uploads.push_back(upload);
+		return upload;
+	};
+
+	// the decoders are loaded up front, IMG_Init is not safe to run on several workers at once
+	IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
+
+	JobSystem::JobHandle terrainParsed = loadMesh(mesh_terrain, "terrain.obj");
+	loadMesh(mesh_rocks, "rocks.obj");
+	loadMesh(mesh_water, "water.obj");
+	loadTexture(tex_terrain, "sand.jpg");
+	loadTexture(tex_grass, "grass.jpg");
+	loadTexture(tex_leaves, "leave.jpg");
+	loadTexture(tex_stems, "palmstem.jpg");
+	loadTexture(tex_plants, "plant.jpg");
+	loadTexture(tex_rocks, "rock.jpg");
+	loadTexture(tex_water, "water.jpg");
+
+	JobSystem::JobHandle grassLoaded = loadVegetation(vegetation_grass, "grass.obj", tex_grass);
+	JobSystem::JobHandle plantsLoaded = loadVegetation(vegetation_plants, "plants.obj", tex_plants);
+
+	// the palms are taken apart the same way, the leaves go with the stem they are closest to
+	{
+		auto stems = std::make_shared<std::unique_ptr<Mesh>>();
+		auto leaves = std::make_shared<std::unique_ptr<Mesh>>();
+		auto transforms = std::make_shared<std::vector<glm::mat4>>();
+		JobSystem::JobHandle stemsParsed = jobSystem.Submit("Parse OBJ", [stems] { *stems = ObjParser::load("stems.obj"); });
+		JobSystem::JobHandle leavesParsed = jobSystem.Submit("Parse OBJ", [leaves] { *leaves = ObjParser::load("leaves.obj"); });
+		JobSystem::JobHandle extract = jobSystem.Submit("Extract palm", [stems, leaves, transforms]
+		{
+			// the crowns reach a little past the trunks' footprints
+			VegetationSource source(**stems, 2.0f);
+			*leaves = source.Attached(**leaves);
+			*stems = source.Prototype();
+			*transforms = source.Transforms();
+		}, { stemsParsed, leavesParsed });
+		uploads.push_back(jobSystem.SubmitMainThread("Upload palm", [this, stems, leaves, transforms]
+		{
+			(*stems)->initBuffers("stems.obj");
+			vegetation_palms = std::make_unique<VegetationLayer>(std::move(*stems), tex_stems);
+			// no leaf piece may be nearest to the prototype's stem, the palms are drawn bare then
+			if ((*leaves)->getIndices().empty())
+				std::cerr << "[LoadAssets] No leaves belong to the prototype palm" << std::endl;
+			else
+			{
+				(*leaves)->initBuffers("leaves.obj");
+				vegetation_palms->AddPart(std::move(*leaves), tex_leaves);
+			}
+			vegetation_palms->SetInstances(std::move(*transforms));
+		}, { extract }));
+	}
 
-	mesh_leaves = ObjParser::parse("leaves.obj");
-	tex_leaves.FromFile("leave.jpg");
-	std::cout << "leaves assets loaded\n";
+	// waiting on the main thread runs the uploads that are ready meanwhile
+	jobSystem.Wait({ terrainParsed, grassLoaded, plantsLoaded });
+	vegetationPlacer = std::make_unique<VegetationPlacer>(*mesh_terrain);
+	PlaceVegetation();
 
-	mesh_stems = ObjParser::parse("stems.obj");
-	tex_stems.FromFile("palmstem.jpg");
-	std::cout << "stems assets loaded\n";
+	jobSystem.Wait(uploads);
+	std::cout << "assets loaded on " << jobSystem.WorkerCount() << " workers\n";
+}
 
-	mesh_plants = ObjParser::parse("plants.obj");
-	tex_plants.FromFile("plant.jpg");
-	std::cout << "plants assets loaded\n";
+void CMyApp::PlaceVegetation()
+{
+	CPU_ZONE("CMyApp::PlaceVegetation");
+	// the water plane is at 26 and rises by 5, nothing grows below that or on steep slopes
+	auto grassDensity = [](const glm::vec3& position, const glm::vec3& normal)
+	{
+		return 0.02f * glm::smoothstep(32.0f, 36.0f, position.y) * glm::smoothstep(0.85f, 0.95f, normal.y);
+	};
+	auto plantDensity = [](const glm::vec3& position, const glm::vec3& normal)
+	{
+		return 0.002f * glm::smoothstep(31.0f, 34.0f, position.y) * glm::smoothstep(0.75f, 0.9f, normal.y);
+	};
 
-	mesh_rocks = ObjParser::parse("rocks.obj");
-	tex_rocks.FromFile("rock.jpg");
-	std::cout << "rocks assets loaded\n";
+	// fixed seeds keep the layout the same between runs and density changes
+	vegetation_grass->SetInstances(vegetationPlacer->Scatter(grassDensity, vegetationDensity, glm::vec2(0.8f, 1.2f), 1));
+	vegetation_plants->SetInstances(vegetationPlacer->Scatter(plantDensity, vegetationDensity, glm::vec2(0.8f, 1.2f), 2));
 
-	mesh_water = ObjParser::parse("water.obj");
-	tex_water.FromFile("water.jpg");
-	std::cout << "water assets loaded\n";
+	std::cout << "vegetation placed: " << vegetation_grass->InstanceCount() << " grass, " << vegetation_plants->InstanceCount() << " plants\n";
 }
 
 inline void setTexture2DParameters(GLenum magfilter = GL_LINEAR, GLenum minfilter = GL_LINEAR, GLenum wrap_s = GL_CLAMP_TO_EDGE, GLenum wrap_t = GL_CLAMP_TO_EDGE)
@@ -70,400 +207,1014 @@ inline void setTexture2DParameters(GLenum magfilter = GL_LINEAR, GLenum minfilte
 
 void CMyApp::CreateFrameBuffers()
 {
-	// Clear if the function is not being called for the first time
-	if (frameBufferCreated)
-	{
-		glDeleteTextures(1, &colorBuffer);
-		glDeleteTextures(1, &normalBuffer);
-		glDeleteTextures(1, &positionBuffer);
-		glDeleteTextures(1, &materialBuffer);
-		glDeleteRenderbuffers(1, &depthBuffer);
-		glDeleteFramebuffers(1, &fbo);
-		glDeleteTextures(1, &shadow_depth_texture);
-		glDeleteFramebuffers(1, &shadow_fbo);
-	}
-
-	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-	// (Attachment 0.) Target for the base (texture) color of pixels
-	glGenTextures(1, &colorBuffer);
-	glBindTexture(GL_TEXTURE_2D, colorBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_FLOAT, nullptr); // last 3 parameters are only for initial values
+	// The window sized targets belong to the render graph, the pool allocates them when it is first compiled
+	renderTargets.Resize(width, height);
+	renderTargets.Update();
+	renderGraph.SetBackbufferSize(width, height);
+
+	// The depth map rendered from the light, its resolution does not depend on the window
+	shadow_depth_texture = GpuResources::CreateTexture("Shadow map depth");
+	GpuResources::TexImage2D(GL_TEXTURE_2D, shadow_depth_texture, GL_DEPTH_COMPONENT32F, DIR_SHADOW_MAP_RES, DIR_SHADOW_MAP_RES, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 	setTexture2DParameters(GL_NEAREST, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffer, 0);
-	if (glGetError() != GL_NO_ERROR) {
-		std::cout << "Error creating color attachment 0" << GLenum(glGetError()) << std::endl;
-		exit(1);
-	}
+	glBindTexture(GL_TEXTURE_2D, 0);
 
-	// (Attachment 1.) Target for normal vectors of pixels
-	glGenTextures(1, &normalBuffer);
-	glBindTexture(GL_TEXTURE_2D, normalBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16_SNORM, width, height, 0, GL_RGBA, GL_FLOAT, nullptr); // last 3 parameters are only for initial values
-	setTexture2DParameters(GL_NEAREST, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalBuffer, 0);
-	if (glGetError() != GL_NO_ERROR) {
-		std::cout << "Error creating color attachment 1" << std::endl;
-		exit(1);
-	}
-
-	// (Attachment 2.) Target for world coordinates of pixels
-	glGenTextures(1, &positionBuffer);
-	glBindTexture(GL_TEXTURE_2D, positionBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr); // last 3 parameters are only for initial values
-	setTexture2DParameters(GL_NEAREST, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, positionBuffer, 0);
-	if (glGetError() != GL_NO_ERROR) {
-		std::cout << "Error creating color attachment 2" << std::endl;
-		exit(1);
-	}
+	BuildRenderGraph();
+	frameBufferCreated = true;
+}
 
-	// (Attachment 3.) Target for material properties of pixels
-	glGenTextures(1, &materialBuffer);
-	glBindTexture(GL_TEXTURE_2D, materialBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr); // last 3 parameters are only for initial values
-	setTexture2DParameters(GL_NEAREST, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, materialBuffer, 0);
-	if (glGetError() != GL_NO_ERROR) {
-		std::cout << "Error creating color attachment 3" << std::endl;
-		exit(1);
-	}
-
-	// Depth renderbuffer
-	glGenRenderbuffers(1, &depthBuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
-	if (glGetError() != GL_NO_ERROR) {
-		std::cout << "Error creating depth attachment" << std::endl;
-		exit(1);
-	}
-
-	//Specifying which color outputs are active
-	GLenum drawBuffers[4] = { GL_COLOR_ATTACHMENT0,
-							  GL_COLOR_ATTACHMENT1,
-							  GL_COLOR_ATTACHMENT2,
-							  GL_COLOR_ATTACHMENT3 };
-	glDrawBuffers(4, drawBuffers);
-
-	// Completeness check
-	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-	if (status != GL_FRAMEBUFFER_COMPLETE)
-	{
-		std::cout << "Incomplete framebuffer (";
-		switch (status)
+void CMyApp::BuildRenderGraph()
+{
+	using Load = RenderGraph::Load;
+	renderGraph.SetProfilers(&gpuProfiler, &pipelineStatistics);
+
+	// G-buffer: base (texture) color, normal vectors, world coordinates and material properties of pixels, and depth
+	colorTarget = renderGraph.CreateTarget({ "G-buffer color", GL_RGBA8, GL_RGBA, GL_FLOAT, GL_NEAREST, false });
+	normalTarget = renderGraph.CreateTarget({ "G-buffer normal", GL_RGB16_SNORM, GL_RGBA, GL_FLOAT, GL_NEAREST, false });
+	RenderGraph::Resource position = renderGraph.CreateTarget({ "G-buffer position", GL_RGB32F, GL_RGBA, GL_FLOAT, GL_NEAREST, false });
+	RenderGraph::Resource material = renderGraph.CreateTarget({ "G-buffer material", GL_RGB32F, GL_RGBA, GL_FLOAT, GL_NEAREST, false });
+	RenderGraph::Resource depth = renderGraph.CreateTarget({ "G-buffer depth", GL_DEPTH_COMPONENT24, GL_NONE, GL_NONE, GL_NONE, true });
+	// Overdraw counters, written as an image, and the heat map made of them
+	RenderGraph::Resource overdrawCounts = renderGraph.CreateTarget({ "Overdraw counts", GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, GL_NEAREST, false });
+	RenderGraph::Resource overdrawDepth = renderGraph.CreateTarget({ "Overdraw depth", GL_DEPTH_COMPONENT24, GL_NONE, GL_NONE, GL_NONE, true });
+	overdrawHeatMapTarget = renderGraph.CreateTarget({ "Overdraw heat map", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_LINEAR, false });
+	RenderGraph::Resource shadowMap = renderGraph.Import("Shadow map", shadow_depth_texture, GL_DEPTH_COMPONENT32F, DIR_SHADOW_MAP_RES, DIR_SHADOW_MAP_RES);
+
+	// shown by ImGui after the graph ran
+	renderGraph.Export(colorTarget);
+	renderGraph.Export(normalTarget);
+	renderGraph.Export(overdrawHeatMapTarget);
+
+	const std::array<RenderGraph::Resource, 4> gBuffer = { colorTarget, normalTarget, position, material };
+	auto writeGBuffer = [&](RenderGraph::PassBuilder pass, Load colorLoad, Load depthLoad)
+	{
+		for (size_t i = 0; i < gBuffer.size(); ++i)
+			pass.Write(gBuffer[i], GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i), colorLoad);
+		pass.Write(depth, GL_DEPTH_ATTACHMENT, depthLoad);
+	};
+
+	// the default state tests and writes depth without blending
+	RenderGraph::RenderState depthOnly;
+	depthOnly.colorWrite = false;
+	RenderGraph::RenderState afterPrepass;
+	afterPrepass.depthFunc = GL_EQUAL;
+	afterPrepass.depthWrite = false;
+	RenderGraph::RenderState fullscreenQuad;
+	fullscreenQuad.depthTest = false;
+	fullscreenQuad.depthWrite = false;
+	RenderGraph::RenderState additive = fullscreenQuad;
+	additive.blend = true;
+
+	// Timings of the light markers, drawn into the G-buffer before this frame's scene is drawn over them
+	writeGBuffer(renderGraph.AddPass("Light marker benchmark", [this]()
 		{
-		case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
-			std::cout << "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
-			break;
-		case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
-			std::cout << "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
-			break;
-		case GL_FRAMEBUFFER_UNSUPPORTED:
-			std::cout << "GL_FRAMEBUFFER_UNSUPPORTED";	
-			break;
-		}
-		std::cout << ")" << std::endl;
-		exit(1);
-	}
-
-	// Unbind framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// Now the fbo to render from the light
-	glGenFramebuffers(1, &shadow_fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, shadow_fbo);
+			BenchmarkLightMarkers();
+			runLightMarkerBenchmark = false;
+		})
+		.Condition([this]() { return runLightMarkerBenchmark; })
+		.SideEffect(), Load::DontCare, Load::DontCare);
+
+	// Lay down the depth first, then the G-buffer is only written by the visible fragments
+	writeGBuffer(renderGraph.AddPass("Depth pre-pass", [this]()
+		{
+			DrawSceneDepth(*programDepthPrepass, *programDepthPrepassInstanced, snapshots.ReadBuffer(), true);
+		})
+		.Condition([this]() { return depthPrepassEnabled; })
+		.State(depthOnly), Load::Clear, Load::Clear);
+
+	// "Forward rendering": rendering the geometry into the G-buffer's attachments
+	writeGBuffer(renderGraph.AddPass("G-buffer", [this]() { DrawScene(snapshots.ReadBuffer()); })
+		.Condition([this]() { return !depthPrepassEnabled; }), Load::Clear, Load::Clear);
+	writeGBuffer(renderGraph.AddPass("G-buffer", [this]() { DrawScene(snapshots.ReadBuffer()); })
+		.Condition([this]() { return depthPrepassEnabled; })
+		.State(afterPrepass), Load::Keep, Load::Keep);
+
+	// impostors and lights are not part of the depth pre-pass so they are tested the usual way
+	writeGBuffer(renderGraph.AddPass("Impostors and light markers", [this]() { DrawImpostorsAndLights(snapshots.ReadBuffer()); }),
+		Load::Keep, Load::Keep);
+
+	// G-buffer captures read the colour targets through a framebuffer of their own
+	RenderGraph::PassBuilder capture = renderGraph.AddPass("G-buffer capture", [this]()
+		{
+			std::string prefix = "gbuffer_" + std::to_string(captureCount++);
+			GLuint framebuffer = renderGraph.Framebuffer();
+			GLsizei targetWidth = renderTargets.ViewportWidth();
+			GLsizei targetHeight = renderTargets.ViewportHeight();
+			frameReadback.Capture(framebuffer, GL_COLOR_ATTACHMENT0, targetWidth, targetHeight, prefix + "_color.tga");
+			frameReadback.Capture(framebuffer, GL_COLOR_ATTACHMENT1, targetWidth, targetHeight, prefix + "_normal.tga");
+			frameReadback.Capture(framebuffer, GL_COLOR_ATTACHMENT2, targetWidth, targetHeight, prefix + "_position.tga");
+			frameReadback.Capture(framebuffer, GL_COLOR_ATTACHMENT3, targetWidth, targetHeight, prefix + "_material.tga");
+			captureGBuffer = false;
+		})
+		.Condition([this]() { return captureGBuffer; })
+		.SideEffect();
+	for (size_t i = 0; i < gBuffer.size(); ++i)
+		capture.Read(gBuffer[i], GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i));
 
-	glGenTextures(1, &shadow_depth_texture);
-	glBindTexture(GL_TEXTURE_2D, shadow_depth_texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, DIR_SHADOW_MAP_RES, DIR_SHADOW_MAP_RES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-	setTexture2DParameters(GL_NEAREST, GL_NEAREST);
+	// Create a depth map from the direction of the main light
+	renderGraph.AddPass("Shadow map", [this]() { DrawSceneDepth(programShadowMapper, *programShadowInstanced, snapshots.ReadBuffer(), false); })
+		.Condition([this]() { return shadowsEnabled; })
+		.Write(shadowMap, GL_DEPTH_ATTACHMENT, Load::Clear);
 
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow_depth_texture, 0);
-	if (glGetError() != GL_NO_ERROR) {
-		std::cout << "Error creating depth attachment for shadow map" << std::endl;
-		exit(1);
-	}
+	// -- Lights: fullscreen quads added up in the window
+	// Add the effect of the directional light
+	RenderGraph::PassBuilder directional = renderGraph.AddPass("Directional light", [this, gBuffer]()
+		{
+			ProgramObject& directionalLight = *programDirectionalLight[shadowsEnabled ? 1 : 0];
+			directionalLight.Use();
+			directionalLight.SetTexture("colorTexture", 0, renderGraph.Name(gBuffer[0]));
+			directionalLight.SetTexture("normalTexture", 1, renderGraph.Name(gBuffer[1]));
+			directionalLight.SetTexture("positionTexture", 2, renderGraph.Name(gBuffer[2]));
+			directionalLight.SetTexture("materialTexture", 3, renderGraph.Name(gBuffer[3]));
+			if (shadowsEnabled)
+				directionalLight.SetTexture("shadowDepthTexture", 4, shadow_depth_texture);
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			directionalLight.Unuse();
+		})
+		.State(additive)
+		.Write(RenderGraph::BACKBUFFER, GL_BACK, Load::Clear)
+		.Sample(shadowMap);
+	for (RenderGraph::Resource target : gBuffer)
+		directional.Sample(target);
 
-	// No need for any color output!
-	glDrawBuffer(GL_NONE);
-	   		
-	// Completeness check
-	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-	if (status != GL_FRAMEBUFFER_COMPLETE)
-	{
-		std::cout << "Incomplete framebuffer (";
-		switch (status)
+	// Add the effect of the point lights
+	RenderGraph::PassBuilder point = renderGraph.AddPass("Point lights", [this, gBuffer]()
 		{
-		case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
-			std::cout << "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
-			break;
-		case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
-			std::cout << "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
-			break;
-		case GL_FRAMEBUFFER_UNSUPPORTED:
-			std::cout << "GL_FRAMEBUFFER_UNSUPPORTED";
-			break;
-		}
-		std::cout << ")" << std::endl;
-		exit(1);
+			// positions, strengths and colors straight from the light marker buffer or this frame's markers
+			if (gpuLightAnimation)
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, static_cast<GLuint>(StorageBufferBinding::LightMarkers), lightMarkerBuffer);
+			else if (streamedLightMarkers.data != nullptr)
+				streamBuffer.BindRange(GL_UNIFORM_BUFFER, static_cast<GLuint>(UniformBlockBinding::PointLights), streamedLightMarkers);
+			else
+				return;
+			ProgramObject& pointLights = gpuLightAnimation ? *programLightRendererSsbo : programLightRenderer;
+			pointLights.Use();
+			pointLights.SetTexture("colorTexture", 0, renderGraph.Name(gBuffer[0]));
+			pointLights.SetTexture("normalTexture", 1, renderGraph.Name(gBuffer[1]));
+			pointLights.SetTexture("positionTexture", 2, renderGraph.Name(gBuffer[2]));
+			pointLights.SetTexture("materialTexture", 3, renderGraph.Name(gBuffer[3]));
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			pointLights.Unuse();
+		})
+		.State(additive)
+		.Write(RenderGraph::BACKBUFFER, GL_BACK);
+	for (RenderGraph::Resource target : gBuffer)
+		point.Sample(target);
+
+	// Overdraw heat map: the G-buffer pass drawn again, counting the fragments of every pixel, then turned into
+	// colours. The counters are cleared through their attachment, then only written through the image
+	for (bool depthTested : { true, false })
+	{
+		RenderGraph::RenderState overdraw;
+		overdraw.depthTest = depthTested;
+		renderGraph.AddPass("Overdraw", [this, overdrawCounts]()
+			{
+				// the same geometry as the G-buffer pass, without the impostors and light markers
+				glBindImageTexture(0, renderGraph.Name(overdrawCounts), 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+				DrawSceneDepth(*programOverdraw, *programOverdrawInstanced, snapshots.ReadBuffer(), true);
+			})
+			.Condition([this, depthTested]() { return overdrawEnabled && overdrawDepthTest == depthTested; })
+			.State(overdraw)
+			.Write(overdrawCounts, GL_COLOR_ATTACHMENT0, Load::Clear)
+			.Image(overdrawCounts)
+			.Write(overdrawDepth, GL_DEPTH_ATTACHMENT, Load::Clear);
 	}
 
-	// Unbind
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	frameBufferCreated = true;
+	renderGraph.AddPass("Overdraw resolve", [this, overdrawCounts]()
+		{
+			programOverdrawResolve->Use();
+			programOverdrawResolve->SetTexture("overdraw_count", 0, renderGraph.Name(overdrawCounts));
+			programOverdrawResolve->SetUniform("overdraw_max", overdrawMax);
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			programOverdrawResolve->Unuse();
+		})
+		.Condition([this]() { return overdrawEnabled; })
+		.State(fullscreenQuad)
+		.Sample(overdrawCounts)
+		.Write(overdrawHeatMapTarget, GL_COLOR_ATTACHMENT0, Load::DontCare);
 }
 
 bool CMyApp::Init()
 {	
+	CPU_ZONE("CMyApp::Init");
+	auto initStart = std::chrono::high_resolution_clock::now();
+
 	// Set clear color
 	glClearColor(0.0f, 0.0f, 0.0f, 1);
 	// For this scene we just keep all faces
 	//glEnable(GL_CULL_FACE);
 		
-	programShadowMapper.Init({ // Shadow shader
+	// Programs are restored from the binary cache when possible, the startup cost is reported to compare cold and warm runs.
+	// Everything that misses the cache is only submitted here, so the driver compiles while the assets are loading.
+	auto programsStart = std::chrono::high_resolution_clock::now();
+	bool parallelCompile = ProgramObject::EnableParallelCompile();
+
+	// Constants baked into every shader instead of being duplicated in the GLSL sources
+	sceneDefines = { { "NUM_POINT_LIGHTS", std::to_string(NUM_POINT_LIGHTS) } };
+
+	programShadowMapper.Submit(programCache, { // Shadow shader
 		{ GL_VERTEX_SHADER,		"shadow_map.vert" },
 		{ GL_FRAGMENT_SHADER,	"shadow_map.frag" }
-	});
+	}, sceneDefines);
 
-	programForwardRenderer.Init({
+	programForwardRenderer.Submit(programCache, {
 		{ GL_VERTEX_SHADER,		"forward.vert" },
 		{ GL_FRAGMENT_SHADER,	"forward.frag" }
-	});
+	}, sceneDefines);
 
-	programLightRenderer.Init({
-		{ GL_VERTEX_SHADER,		"deferredPoint.vert" },
+	programLightRenderer.Submit(programCache, {
+		{ GL_VERTEX_SHADER,		"fullscreen_quad.vert" },
 		{ GL_FRAGMENT_SHADER,	"deferredPoint.frag" }
-	});
+	}, sceneDefines);
 
-	programLightSpheres.Init({
+	programLightSpheres.Submit(programCache, {
 		{ GL_VERTEX_SHADER,			"sphere.vert" },
 		{ GL_TESS_CONTROL_SHADER,	"sphere.tcs" },
 		{ GL_TESS_EVALUATION_SHADER,"sphere.tes" },
 		{ GL_FRAGMENT_SHADER,		"sphere.frag" }
-	});
+	}, sceneDefines);
+
+	programLightImpostors.Submit(programCache, {
+		{ GL_VERTEX_SHADER,		"sphere_impostor.vert" },
+		{ GL_FRAGMENT_SHADER,	"sphere_impostor.frag" }
+	}, sceneDefines);
+
+	// Every program sees the same per-frame block through one binding point, bound as soon as the program is linked
+	programVariants.AddUniformBlockBinding("PerFrame", static_cast<GLuint>(UniformBlockBinding::PerFrame));
+	programVariants.AddUniformBlockBinding("PerMaterial", static_cast<GLuint>(UniformBlockBinding::PerMaterial));
+	programVariants.AddUniformBlockBinding("PointLights", static_cast<GLuint>(UniformBlockBinding::PointLights));
+	for (ProgramObject* program : { &programForwardRenderer, &programLightRenderer, &programLightSpheres, &programLightImpostors, &programShadowMapper })
+	{
+		program->BindUniformBlock("PerFrame", static_cast<GLuint>(UniformBlockBinding::PerFrame));
+		program->BindUniformBlock("PerMaterial", static_cast<GLuint>(UniformBlockBinding::PerMaterial));
+		program->BindUniformBlock("PointLights", static_cast<GLuint>(UniformBlockBinding::PointLights));
+	}
 
-	programDirectionalLight.Init({
-		{ GL_VERTEX_SHADER,		"directionalLight.vert" },
+	// The directional light is specialized on whether shadows are on, both variants are built up front
+	ShaderDefines shadowDefines = sceneDefines;
+	shadowDefines["ENABLE_SHADOWS"] = "1";
+	programDirectionalLight[0] = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"fullscreen_quad.vert" },
+		{ GL_FRAGMENT_SHADER,	"directionalLight.frag" }
+	}, sceneDefines);
+	programDirectionalLight[1] = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"fullscreen_quad.vert" },
 		{ GL_FRAGMENT_SHADER,	"directionalLight.frag" }
+	}, shadowDefines);
+
+	// The depth pre-pass reuses the position-only shadow map program, seen from the camera
+	programDepthPrepass = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"shadow_map.vert" },
+		{ GL_FRAGMENT_SHADER,	"shadow_map.frag" }
+	}, { { "DEPTH_PREPASS", "1" } });
+
+	// Vegetation takes its model matrices from a per-instance attribute
+	programForwardInstanced = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"forward.vert" },
+		{ GL_FRAGMENT_SHADER,	"forward.frag" }
+	}, { { "INSTANCED", "1" } });
+	programShadowInstanced = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"shadow_map.vert" },
+		{ GL_FRAGMENT_SHADER,	"shadow_map.frag" }
+	}, { { "INSTANCED", "1" } });
+	programDepthPrepassInstanced = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"shadow_map.vert" },
+		{ GL_FRAGMENT_SHADER,	"shadow_map.frag" }
+	}, { { "DEPTH_PREPASS", "1" }, { "INSTANCED", "1" } });
+	programImpostorBake = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"impostor_bake.vert" },
+		{ GL_FRAGMENT_SHADER,	"impostor_bake.frag" }
+	});
+	programVegetationImpostors = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"impostor.vert" },
+		{ GL_FRAGMENT_SHADER,	"impostor.frag" }
+	});
+
+	// The overdraw view draws the camera depth pass geometry, counting instead of writing depth only
+	programOverdraw = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"shadow_map.vert" },
+		{ GL_FRAGMENT_SHADER,	"overdraw.frag" }
+	}, { { "DEPTH_PREPASS", "1" } });
+	programOverdrawInstanced = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"shadow_map.vert" },
+		{ GL_FRAGMENT_SHADER,	"overdraw.frag" }
+	}, { { "DEPTH_PREPASS", "1" }, { "INSTANCED", "1" } });
+	programOverdrawResolve = &programVariants.Get({
+		{ GL_VERTEX_SHADER,		"fullscreen_quad.vert" },
+		{ GL_FRAGMENT_SHADER,	"overdraw_resolve.frag" }
 	});
 
+	programs = { &programForwardRenderer, &programLightRenderer, &programLightSpheres, &programLightImpostors, &programShadowMapper, programDirectionalLight[0], programDirectionalLight[1], programDepthPrepass,
+		programForwardInstanced, programShadowInstanced, programDepthPrepassInstanced, programImpostorBake, programVegetationImpostors,
+		programOverdraw, programOverdrawInstanced, programOverdrawResolve };
+
+	// The lights can live in the light marker buffer only: a compute shader moves them, the point-light pass reads them as a storage buffer
+	gpuLightAnimationSupported = GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object;
+	if (gpuLightAnimationSupported)
+	{
+		ShaderDefines ssboDefines = sceneDefines;
+		ssboDefines["LIGHTS_FROM_SSBO"] = "1";
+		programLightRendererSsbo = &programVariants.Get({
+			{ GL_VERTEX_SHADER,		"fullscreen_quad.vert" },
+			{ GL_FRAGMENT_SHADER,	"deferredPoint.frag" }
+		}, ssboDefines);
+		programLightAnimation = &programVariants.Get({
+			{ GL_COMPUTE_SHADER,	"light_animation.comp" }
+		});
+		programs.push_back(programLightRendererSsbo);
+		programs.push_back(programLightAnimation);
+	}
+
+	std::chrono::duration<double, std::milli> submitTime = std::chrono::high_resolution_clock::now() - programsStart;
+
 	LoadAssets();
 
+	std::cout << PollPrograms() << "/" << programs.size() << " shader programs finished during asset loading"
+			  << (parallelCompile ? "" : " (KHR_parallel_shader_compile is not available)") << "\n";
+
+	// Only now do we block on whatever the driver has not finished yet
+	auto finalizeStart = std::chrono::high_resolution_clock::now();
+	{
+		CPU_ZONE("ProgramObject::Finalize (all)");
+		for (ProgramObject* program : programs)
+			program->Finalize();
+	}
+	std::chrono::duration<double, std::milli> finalizeTime = std::chrono::high_resolution_clock::now() - finalizeStart;
+
+	std::cout << "shader programs submitted in " << submitTime.count() << " ms, waited " << finalizeTime.count() << " ms for the rest ("
+			  << (programCache.IsSupported() ? "" : "binary cache unsupported, ")
+			  << programCache.Hits() << " cached, " << programCache.Misses() << " compiled, "
+			  << programCache.Rejected() << " rejected by the driver)\n";
+
+	CreateUniformBuffers();
+
 	// Create point lights
+	lightSimulation = std::make_unique<LightSimulation>(NUM_POINT_LIGHTS, glm::vec3(-350.0f, 35.0f, -350.0f), glm::vec3(350.0f, 135.0f, 350.0f),
+														POINT_LIGHT_SPEED, static_cast<uint32_t>(rng()));
+	lightParallelFor = [this](size_t count, const JobSystem::RangeFunction& body) { jobSystem.ParallelFor(count, body, LIGHT_SIMULATION_GRAIN); };
 	for (int i = 0; i < NUM_POINT_LIGHTS; ++i)
 	{
-		pointLightPositions.push_back(glm::vec3(rand() / (double)RAND_MAX * 700.0f - 350.0f,
-												rand() / (double)RAND_MAX * 100.0f + 35.0f,
-												rand() / (double)RAND_MAX * 700.0f - 350.0f));
-		pointLightNextPositions.push_back(glm::vec3(rand() / (double)RAND_MAX * 700.0f - 350.0f,
-													rand() / (double)RAND_MAX * 100.0f + 35.0f,
-													rand() / (double)RAND_MAX * 700.0f - 350.0f));
-		pointLightColors.push_back(glm::vec3(rand() / (double)RAND_MAX * 0.5f + 0.5f,
-											 rand() / (double)RAND_MAX * 0.5f + 0.5f,
-											 rand() / (double)RAND_MAX * 0.5f + 0.5f));
-		pointLightStrengths.push_back(rand() / (double)RAND_MAX * 1.5f + 0.5f);
+		pointLightColors.push_back(glm::vec3(RandomUnit() * 0.5f + 0.5f,
+											 RandomUnit() * 0.5f + 0.5f,
+											 RandomUnit() * 0.5f + 0.5f));
+		pointLightStrengths.push_back(RandomUnit() * 1.5f + 0.5f);
+	}
+
+	// Light markers are drawn straight from a buffer holding one LightMarker per light
+	lightMarkerBuffer.SetOwner("Light markers");
+	lightMarkerBuffer.BufferData(sizeof(LightMarker) * NUM_POINT_LIGHTS);
+	SetLightMarkerSource(lightMarkerBuffer, 0);
+	if (gpuLightAnimationSupported)
+	{
+		lightMotionBuffer.SetOwner("Light motions");
+		lightMotionBuffer.BufferData(sizeof(LightMotion) * NUM_POINT_LIGHTS);
 	}
 
 	CreateFrameBuffers();
 
+	// Vegetation seen from far away is drawn from pictures taken once here
+	{
+		CPU_ZONE("Bake impostors");
+		vegetation_grass->BakeImpostors(*programImpostorBake, IMPOSTOR_VIEW_COUNT, IMPOSTOR_TILE_RES);
+		vegetation_plants->BakeImpostors(*programImpostorBake, IMPOSTOR_VIEW_COUNT, IMPOSTOR_TILE_RES);
+		vegetation_palms->BakeImpostors(*programImpostorBake, IMPOSTOR_VIEW_COUNT, IMPOSTOR_TILE_RES);
+	}
+
+	// Specify the directional light, it does not move so its matrices are computed only once
+	glm::vec3 m_light_dir = glm::normalize(glm::vec3(0, -1, -1));
+	glm::mat4 m_light_proj = glm::ortho<float>(-500, 500, -300, 300, 0, 1000);
+	glm::mat4 m_light_view = glm::lookAt<float>(glm::vec3(400, 190, 250), m_light_dir, glm::vec3(0, 1, 0));
+	lightViewProj = m_light_proj * m_light_view;
+
+	std::chrono::duration<double, std::milli> initTime = std::chrono::high_resolution_clock::now() - initStart;
+	std::cout << "startup finished in " << initTime.count() << " ms\n";
+
 	return true;
 }
 
+int CMyApp::PollPrograms()
+{
+	int ready = 0;
+	for (ProgramObject* program : programs)
+	{
+		if (program->IsReady())
+			++ready;
+	}
+	return ready;
+}
+
+void CMyApp::CreateUniformBuffers()
+{
+	streamBuffer.Init("Per-frame stream");
+
+	// Materials are laid out one after the other, each starting on an offset the driver accepts for glBindBufferRange
+	GLint offsetAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	materialStride = (sizeof(MaterialUniforms) + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+
+	std::array<MaterialUniforms, static_cast<size_t>(MaterialId::Count)> materials;
+	materials[static_cast<size_t>(MaterialId::Default)]	= { 0.5f, 0.6f, 0.1f, 50.0f };
+	materials[static_cast<size_t>(MaterialId::Rock)]	= { 0.5f, 0.2f, 0.1f, 50.0f };
+	materials[static_cast<size_t>(MaterialId::Water)]	= { 0.5f, 0.8f, 1.0f, 30.0f };
+
+	// The materials are constant, so they are laid out once into immutable storage and only the bound range changes
+	// between draws
+	std::vector<unsigned char> strided(materialStride * materials.size());
+	for (size_t i = 0; i < materials.size(); ++i)
+		std::memcpy(&strided[materialStride * i], &materials[i], sizeof(MaterialUniforms));
+	materialUniformBuffer.SetOwner("Material uniforms");
+	materialUniformBuffer.BufferStorage(strided);
+}
+
+void CMyApp::UpdateFrameUniforms(const FrameSnapshot& snapshot)
+{
+	PerFrameUniforms* frame = streamBuffer.Allocate<PerFrameUniforms>(1, frameUniforms);
+	if (frame == nullptr)
+		return;
+
+	frame->view				= snapshot.view;
+	frame->proj				= snapshot.proj;
+	frame->viewProj			= snapshot.viewProj;
+	frame->lightViewProj	= lightViewProj;
+	frame->eyePos			= snapshot.eye;
+	frame->time				= snapshot.time;
+	frame->viewportSize		= glm::vec2(renderTargets.ViewportWidth(), renderTargets.ViewportHeight());
+	frame->targetScale		= glm::vec2(renderTargets.ScaleX(), renderTargets.ScaleY());
+
+	streamBuffer.Flush(frameUniforms);
+	streamBuffer.BindRange(GL_UNIFORM_BUFFER, static_cast<GLuint>(UniformBlockBinding::PerFrame), frameUniforms);
+}
+
+void CMyApp::UpdateLightMarkers(const FrameSnapshot& snapshot)
+{
+	// the GPU animation has already moved them in the light marker buffer
+	streamedLightMarkers = {};
+	if (gpuLightAnimation)
+		return;
+
+	// read by the markers as vertex attributes and by the point-light pass as a uniform block
+	LightMarker* markers = streamBuffer.Allocate<LightMarker>(NUM_POINT_LIGHTS, streamedLightMarkers);
+	if (markers == nullptr)
+		return;
+	for (size_t i = 0; i < NUM_POINT_LIGHTS; ++i)
+		markers[i] = { snapshot.pointLightPositions[i], pointLightStrengths[i], pointLightColors[i], 0.0f };
+	streamBuffer.Flush(streamedLightMarkers);
+}
+
+void CMyApp::BindMaterial(MaterialId material)
+{
+	materialUniformBuffer.BindRange(static_cast<GLuint>(UniformBlockBinding::PerMaterial), materialStride * static_cast<GLsizeiptr>(material), sizeof(MaterialUniforms));
+}
+
 
 void CMyApp::Clean()
 {
+	simulationThread.reset();
+
 	if (frameBufferCreated)
 	{
-		glDeleteTextures(1, &colorBuffer);
-		glDeleteTextures(1, &normalBuffer);
-		glDeleteTextures(1, &positionBuffer);
-		glDeleteTextures(1, &materialBuffer);
-		glDeleteRenderbuffers(1, &depthBuffer);
-		glDeleteFramebuffers(1, &fbo);
-		glDeleteTextures(1, &shadow_depth_texture);
-		glDeleteFramebuffers(1, &shadow_fbo);
+		renderGraph.Clean();
+		renderTargets.Clean();
+		GpuResources::DeleteTexture(shadow_depth_texture);
 	}
+	streamBuffer.Clean();
 }
 
 void CMyApp::Update()
 {
 	// static declaration runs only once per application
 	static Uint32 last_time = SDL_GetTicks();
-	delta_time = (SDL_GetTicks() - last_time) / 1000.0f;
+	delta_time = fixedTimestep > 0.0 ? fixedTimestep : (SDL_GetTicks() - last_time) / 1000.0f;
+
+	// read before the events are taken, every event queued by then is among them
+	uint64_t frameInputTime = inputTime;
+	ApplyInput();
 
+	if (cameraPath != nullptr)
+	{
+		CameraPath::Key key = cameraPath->Sample(cameraPathTime);
+		camera.SetView(key.eye, key.at, glm::vec3(0, 1, 0));
+		cameraPathTime += static_cast<float>(delta_time);
+	}
 	camera.Update(static_cast<float>(delta_time));
 
 	if (!frozen)
 	{
-		// Move point lights
-		for (int i = 0; i < NUM_POINT_LIGHTS; ++i)
-		{
-			glm::vec3 toGoal = pointLightNextPositions[i] - pointLightPositions[i];
-			if (glm::length(toGoal) < 2.0f)
-			{
-				pointLightNextPositions[i] = glm::vec3(rand() / (double)RAND_MAX * 700.0f - 350.0f,
-					rand() / (double)RAND_MAX * 100.0f + 35.0f,
-					rand() / (double)RAND_MAX * 700.0f - 350.0f);
-				toGoal = pointLightNextPositions[i] - pointLightPositions[i];
-			}
-			pointLightPositions[i] += glm::normalize(toGoal);
-		}
+		// Move point lights; on the GPU they are moved at the start of Render
+		lightTime += delta_time;
+		if (!gpuLightAnimation)
+			lightSimulation->Step(static_cast<float>(delta_time), LightSimulation::Kernel::Simd, lightParallelFor);
 		// Increment elapsed time
 		t += delta_time;
 	}
 
+	// Hand the frame over to Render; the slot may hold an older frame, so every field is written
+	FrameSnapshot& frame = snapshots.WriteBuffer();
+	frame.number		= ++simulatedFrames;
+	frame.view			= camera.GetViewMatrix();
+	frame.proj			= camera.GetProj();
+	frame.viewProj		= camera.GetViewProj();
+	frame.eye			= camera.GetEye();
+	frame.time			= t;
+	frame.inputTime		= frameInputTime;
+	frame.lightTime		= lightTime;
+	frame.waterLevel	= glm::translate(glm::vec3(0, 5 * sin(t), 0));
+	lightSimulation->GatherPositions(frame.pointLightPositions.data());
+	snapshots.Publish();
+
 	last_time = SDL_GetTicks();
 }
 
-void CMyApp::DrawScene(glm::mat4 waterLevel)
+void CMyApp::SetSimulationThread(bool enable)
+{
+	if (enable == HasSimulationThread())
+		return;
+
+	if (enable)
+	{
+		simulationThread = std::make_unique<SimulationThread>([this]
+		{
+			CPU_ZONE("CMyApp::Update");
+			Update();
+		}, simulatedFrames);
+	}
+	else
+		simulationThread.reset();
+}
+
+void CMyApp::QueueInput(const SDL_Event& ev)
+{
+	{
+		std::lock_guard<std::mutex> lock(inputMutex);
+		pendingInput.push_back(ev);
+	}
+	inputPending = true;
+}
+
+void CMyApp::ApplyInput()
+{
+	if (!inputPending.exchange(false))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(inputMutex);
+		std::swap(pendingInput, simulationInput);
+	}
+
+	for (SDL_Event& ev : simulationInput)
+	{
+		switch (ev.type)
+		{
+		case SDL_KEYDOWN:
+			if (ev.key.keysym.sym == SDLK_f)
+				frozen = !frozen;
+			camera.KeyboardDown(ev.key);
+			break;
+		case SDL_KEYUP:
+			camera.KeyboardUp(ev.key);
+			break;
+		case SDL_MOUSEMOTION:
+			camera.MouseMove(ev.motion);
+			break;
+		case SDL_WINDOWEVENT:
+			camera.Resize(ev.window.data1, ev.window.data2);
+			break;
+		}
+	}
+	simulationInput.clear();
+}
+
+void CMyApp::DrawScene(const FrameSnapshot& frame)
 {
 	programForwardRenderer.Use();
 
 	programForwardRenderer.SetUniform("world", glm::mat4());
-	programForwardRenderer.SetUniform("MVP", camera.GetViewProj());
 	programForwardRenderer.SetUniform("worldIT", glm::mat4());
-	programForwardRenderer.SetUniform("eye_pos", camera.GetEye());
-	programForwardRenderer.SetUniform("Ka", 0.5f);
-	programForwardRenderer.SetUniform("Kd", 0.6f);
-	programForwardRenderer.SetUniform("Ks", 0.1f);
-	programForwardRenderer.SetUniform("specular_power", 50.0f);
+	BindMaterial(MaterialId::Default);
 
 	programForwardRenderer.SetTexture("texImage", 0, tex_terrain);
 	mesh_terrain->draw();
 
-	programForwardRenderer.SetTexture("texImage", 0, tex_grass);
-	mesh_grass->draw();
-
-	programForwardRenderer.SetTexture("texImage", 0, tex_leaves);
-	mesh_leaves->draw();
-
-	programForwardRenderer.SetTexture("texImage", 0, tex_stems);
-	mesh_stems->draw();
-
-	programForwardRenderer.SetTexture("texImage", 0, tex_plants);
-	mesh_plants->draw();
-
-	programForwardRenderer.SetUniform("Kd", 0.2f);
+	BindMaterial(MaterialId::Rock);
 	programForwardRenderer.SetTexture("texImage", 0, tex_rocks);
 	mesh_rocks->draw();
 
-	programForwardRenderer.SetUniform("Kd", 0.8f);
-	programForwardRenderer.SetUniform("Ks", 1.0f);
-	programForwardRenderer.SetUniform("specular_power", 30.0f);
-	programForwardRenderer.SetUniform("world", waterLevel);
-	programForwardRenderer.SetUniform("MVP", camera.GetViewProj() * waterLevel);
-	programForwardRenderer.SetUniform("worldIT", glm::transpose(glm::inverse(waterLevel)));
+	BindMaterial(MaterialId::Water);
+	programForwardRenderer.SetUniform("world", frame.waterLevel);
+	programForwardRenderer.SetUniform("worldIT", glm::transpose(glm::inverse(frame.waterLevel)));
 	programForwardRenderer.SetTexture("texImage", 0, tex_water);
 	mesh_water->draw();
 
 	programForwardRenderer.Unuse();
 
-	// put on lights
-	programLightSpheres.Use();
-	programLightSpheres.SetUniform("MVP", camera.GetViewProj());
-	programLightSpheres.SetUniform("tess_level", 15.0f);
-	programLightSpheres.SetUniform("eye_pos", camera.GetEye());
-	glUniform3fv(glGetUniformLocation(programLightSpheres, "lightPoints"), NUM_POINT_LIGHTS, glm::value_ptr(pointLightPositions.front()));
-	glUniform1fv(glGetUniformLocation(programLightSpheres, "lightRads"), NUM_POINT_LIGHTS, &pointLightStrengths.front());
-	glUniform3fv(glGetUniformLocation(programLightSpheres, "lightColors"), NUM_POINT_LIGHTS, glm::value_ptr(pointLightColors.front()));
-	glPatchParameteri(GL_PATCH_VERTICES, 1);
-	glDrawArrays(GL_PATCHES, 0, NUM_POINT_LIGHTS);
-	programLightSpheres.Unuse();
+	// vegetation, one instanced draw per prototype and run of nearby cells
+	glm::vec3 eye = frame.eye;
+	programForwardInstanced->Use();
+	SetImpostorFade(*programForwardInstanced);
+	BindMaterial(MaterialId::Default);
+
+	vegetation_grass->DrawNear(*programForwardInstanced, eye, VegetationGeometryDistance());
+	vegetation_plants->DrawNear(*programForwardInstanced, eye, VegetationGeometryDistance());
+	vegetation_palms->DrawNear(*programForwardInstanced, eye, VegetationGeometryDistance());
+
+	programForwardInstanced->Unuse();
 }
 
-void CMyApp::Render()
+void CMyApp::DrawImpostorsAndLights(const FrameSnapshot& frame)
 {
-	// Update dynamic parameter of scene
-	glm::mat4 waterLevel = glm::translate(glm::vec3(0, 5 * sin(t), 0));
-	// "Forward rendering": rendering the geometry into the framebuffer's attachements
-	// Bind target
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	// Enable depth test for this
-	glEnable(GL_DEPTH_TEST);
-	glDepthMask(GL_TRUE);
-	glDisable(GL_BLEND);
-	// Clear it
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	// Run shader program
-	DrawScene(waterLevel);
+	glm::vec3 eye = frame.eye;
+	if (impostorsEnabled)
+	{
+		programVegetationImpostors->Use();
+		SetImpostorFade(*programVegetationImpostors);
 
-	// Create a depth map from the direction of the main light
-	// Bind target
-	glBindFramebuffer(GL_FRAMEBUFFER, shadow_fbo);
-	// This has a custom resolution
-	glViewport(0, 0, DIR_SHADOW_MAP_RES, DIR_SHADOW_MAP_RES);
-	// Clear the previous frame's shadow depth info
-	glClear(GL_DEPTH_BUFFER_BIT);
-	// Specify the directional light
-	glm::vec3 m_light_dir = glm::normalize(glm::vec3(0, -1, -1));
-	glm::mat4 m_light_proj = glm::ortho<float>(-500, 500, -300, 300, 0, 1000);
-	glm::mat4 m_light_view = glm::lookAt<float>(glm::vec3(400, 190, 250), m_light_dir, glm::vec3(0, 1, 0));
-	glm::mat4 m_light_vp = m_light_proj * m_light_view;
-	// Shadow map program
-	programShadowMapper.Use();
-	programShadowMapper.SetUniform("MVP", m_light_vp * glm::mat4(1));
+		vegetation_grass->Impostors().Apply(*programVegetationImpostors, 0);
+		vegetation_grass->DrawImpostors(eye, impostorDistance);
+
+		vegetation_plants->Impostors().Apply(*programVegetationImpostors, 0);
+		vegetation_plants->DrawImpostors(eye, impostorDistance);
+
+		vegetation_palms->Impostors().Apply(*programVegetationImpostors, 0);
+		vegetation_palms->DrawImpostors(eye, impostorDistance);
+
+		programVegetationImpostors->Unuse();
+	}
+
+	// put on lights, from where UpdateLightMarkers put them this frame; the GPU animation keeps them in place
+	if (!gpuLightAnimation)
+	{
+		if (streamedLightMarkers.data == nullptr)
+			return;
+		SetLightMarkerSource(streamBuffer, streamedLightMarkers.offset, streamBuffer.Generation());
+	}
+
+	// Count what is really rasterized, read back a few frames later to avoid a stall
+	spherePrimitivesQuery.TryGetResult(spherePrimitives);
+	spherePrimitivesQuery.Begin();
+	DrawLightMarkers(lightMarkerMode, spheres_vao, impostors_vao, NUM_POINT_LIGHTS);
+	spherePrimitivesQuery.End();
+}
+
+void CMyApp::DrawSceneDepth(ProgramObject& program, ProgramObject& instanced, const FrameSnapshot& frame, bool fromCamera)
+{
+	program.Use();
+	program.SetUniform("world", glm::mat4(1));
 	mesh_terrain->draw();
-	mesh_grass->draw();
-	mesh_leaves->draw();
-	mesh_stems->draw();
-	mesh_plants->draw();
 	mesh_rocks->draw();
-	programShadowMapper.SetUniform("MVP", m_light_vp * glm::mat4(1) * waterLevel);
+	program.SetUniform("world", frame.waterLevel);
 	mesh_water->draw();
-	programShadowMapper.Unuse();
-
-	// -- Lights
-	// Bind back the frontbuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	// Set resolution back
-	glViewport(0, 0, width, height);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	// We will add two fullscreen quads
-	glDisable(GL_DEPTH_TEST);
-	glDepthMask(GL_FALSE);
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_ONE, GL_ONE);
+	program.Unuse();
 
-	// Add the effect of the directional light
-	programDirectionalLight.Use();
-	programDirectionalLight.SetUniform("eye_pos", camera.GetEye());
-	programDirectionalLight.SetUniform("shadowVP", m_light_vp * glm::mat4(1));
-	programDirectionalLight.SetTexture("colorTexture", 0, colorBuffer);
-	programDirectionalLight.SetTexture("normalTexture", 1, normalBuffer);
-	programDirectionalLight.SetTexture("positionTexture", 2, positionBuffer);
-	programDirectionalLight.SetTexture("materialTexture", 3, materialBuffer);
-	programDirectionalLight.SetTexture("shadowDepthTexture", 4, shadow_depth_texture);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	programDirectionalLight.Unuse();
+	instanced.Use();
+	if (fromCamera)
+	{
+		// only what the G-buffer pass draws as geometry, with the same dithered fade
+		SetImpostorFade(instanced);
+		vegetation_grass->DrawNear(instanced, frame.eye, VegetationGeometryDistance());
+		vegetation_plants->DrawNear(instanced, frame.eye, VegetationGeometryDistance());
+		vegetation_palms->DrawNear(instanced, frame.eye, VegetationGeometryDistance());
+	}
+	else
+	{
+		vegetation_grass->Draw(instanced);
+		vegetation_plants->Draw(instanced);
+		vegetation_palms->Draw(instanced);
+	}
+	instanced.Unuse();
+}
 
-	// Add the effect of the point lights
-	programLightRenderer.Use();
-	glUniform3fv(glGetUniformLocation(programLightRenderer, "lightPositions"), NUM_POINT_LIGHTS, glm::value_ptr(pointLightPositions.front()));
-	glUniform1fv(glGetUniformLocation(programLightRenderer, "lightStrengths"), NUM_POINT_LIGHTS, &pointLightStrengths.front());
-	glUniform3fv(glGetUniformLocation(programLightRenderer, "lightColors"), NUM_POINT_LIGHTS, glm::value_ptr(pointLightColors.front()));
-	programLightRenderer.SetUniform("eye_pos", camera.GetEye());
-	programLightRenderer.SetTexture("colorTexture", 0, colorBuffer);
-	programLightRenderer.SetTexture("normalTexture", 1, normalBuffer);
-	programLightRenderer.SetTexture("positionTexture", 2, positionBuffer);
-	programLightRenderer.SetTexture("materialTexture", 3, materialBuffer);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	programLightRenderer.Unuse();
+void CMyApp::SetGpuLightAnimation(bool enable)
+{
+	if (enable == gpuLightAnimation || (enable && !gpuLightAnimationSupported))
+		return;
+
+	// Update reads the flag and steps the simulation, neither may change under it
+	SimulationThread::Pause pause(simulationThread.get());
+	if (enable)
+	{
+		// the GPU carries on from where the CPU simulation is
+		LightMarker* markers = frameArena.AllocateArray<LightMarker>(NUM_POINT_LIGHTS);
+		LightMotion* motions = frameArena.AllocateArray<LightMotion>(NUM_POINT_LIGHTS);
+		for (size_t i = 0; i < NUM_POINT_LIGHTS; ++i)
+		{
+			LightSimulation::LightState state = lightSimulation->GetState(i);
+			markers[i] = { state.position, pointLightStrengths[i], pointLightColors[i], 0.0f };
+			motions[i] = { state.goal, state.random };
+		}
+		lightMarkerBuffer.BufferSubData(0, sizeof(LightMarker) * NUM_POINT_LIGHTS, markers);
+		lightMotionBuffer.BufferSubData(0, sizeof(LightMotion) * NUM_POINT_LIGHTS, motions);
+	}
+	else
+	{
+		// a one-off read back, so that the CPU simulation continues the GPU flight
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		std::vector<LightMarker> markers = lightMarkerBuffer;
+		std::vector<LightMotion> motions = lightMotionBuffer;
+		for (size_t i = 0; i < NUM_POINT_LIGHTS; ++i)
+			lightSimulation->SetState(i, { markers[i].position, motions[i].goal, motions[i].random });
+	}
+
+	// the streamed markers are picked up again by the next frame
+	if (enable)
+		SetLightMarkerSource(lightMarkerBuffer, 0);
+
+	gpuLightTime = lightTime;
+	gpuLightAnimation = enable;
+}
+
+void CMyApp::AnimateLightsOnGpu(float seconds)
+{
+	GpuProfiler::Scope scope(gpuProfiler, "Light animation");
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, static_cast<GLuint>(StorageBufferBinding::LightMarkers), lightMarkerBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, static_cast<GLuint>(StorageBufferBinding::LightMotions), lightMotionBuffer);
+
+	programLightAnimation->Use();
+	programLightAnimation->SetUniform("light_count", static_cast<GLuint>(NUM_POINT_LIGHTS));
+	programLightAnimation->SetUniform("max_step", lightSimulation->Speed() * seconds);
+	programLightAnimation->SetUniform("bounds_min", lightSimulation->BoundsMin());
+	programLightAnimation->SetUniform("bounds_size", lightSimulation->BoundsSize());
+	glDispatchCompute((NUM_POINT_LIGHTS + 63) / 64, 1, 1);
+	programLightAnimation->Unuse();
+
+	// the markers read the positions as vertex attributes, the point-light pass as a storage buffer
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void CMyApp::SetImpostorFade(ProgramObject& program)
+{
+	// without impostors the fade never starts
+	program.SetUniform("impostor_fade_start", impostorsEnabled ? impostorDistance : 1e20f);
+	program.SetUniform("impostor_fade_end", impostorsEnabled ? impostorDistance + IMPOSTOR_FADE_RANGE : 2e20f);
+}
+
+float CMyApp::VegetationGeometryDistance() const
+{
+	return impostorsEnabled ? impostorDistance + IMPOSTOR_FADE_RANGE : std::numeric_limits<float>::max();
+}
+
+void CMyApp::InitLightMarkerVaos(GLuint buffer, GLintptr offset, VertexArrayObject& patches, VertexArrayObject& instances)
+{
+	// the markers start at offset, which moves every frame when they are streamed
+	for (VertexArrayObject* vao : { &patches, &instances })
+	{
+		for (AttributeData attribute : { CreateAttribute<0, glm::vec3, offsetof(LightMarker, position), sizeof(LightMarker)>,
+										 CreateAttribute<1, float, offsetof(LightMarker, radius), sizeof(LightMarker)>,
+										 CreateAttribute<2, glm::vec3, offsetof(LightMarker, color), sizeof(LightMarker)> })
+		{
+			attribute.ptr = static_cast<char*>(attribute.ptr) + offset;
+			vao->AddAttribute(attribute, buffer);
+		}
+		vao->Unbind();
+	}
+
+	// the impostor quad is generated from gl_VertexID, the light data advances per instance
+	instances.SetAttribDivisor(0, 1).SetAttribDivisor(1, 1).SetAttribDivisor(2, 1).Unbind();
+}
+
+void CMyApp::SetLightMarkerSource(GLuint buffer, GLintptr offset, size_t generation)
+{
+	// a stream buffer that grew may have got its old id back, the generation tells them apart
+	if (buffer == lightMarkerVaoBuffer && offset == lightMarkerVaoOffset && generation == lightMarkerVaoGeneration)
+		return;
+
+	InitLightMarkerVaos(buffer, offset, spheres_vao, impostors_vao);
+	lightMarkerVaoBuffer = buffer;
+	lightMarkerVaoOffset = offset;
+	lightMarkerVaoGeneration = generation;
+}
+
+void CMyApp::DrawLightMarkers(LightMarkerMode mode, VertexArrayObject& patches, VertexArrayObject& instances, GLsizei count)
+{
+	if (mode == LightMarkerMode::Tessellated)
+	{
+		programLightSpheres.Use();
+		programLightSpheres.SetUniform("tess_level", 15.0f);
+		programLightSpheres.SetUniform("adaptive_tess", adaptiveTessellation ? 1 : 0);
+		programLightSpheres.SetUniform("pixels_per_edge", tessPixelsPerEdge);
+		glPatchParameteri(GL_PATCH_VERTICES, 1);
+		patches.Bind();
+		glDrawArrays(GL_PATCHES, 0, count);
+		patches.Unbind();
+		programLightSpheres.Unuse();
+	}
+	else
+	{
+		// one camera facing quad per light, the sphere is ray cast in the fragment shader
+		programLightImpostors.Use();
+		instances.Bind();
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+		instances.Unbind();
+		programLightImpostors.Unuse();
+	}
+}
+
+void CMyApp::BenchmarkLightMarkers()
+{
+	const int repetitions = 10;
+
+	// fixed seed, so that every run measures the same light distribution
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// drawn as a pass of the render graph, into the G-buffer
+	lightMarkerBenchmarks.clear();
+	std::cout << "light marker benchmark (GPU ms per draw, seen from the current camera):\n";
+	for (int count : { 100, 1000, 10000 })
+	{
+		std::vector<LightMarker> markers(count);
+		for (LightMarker& marker : markers)
+		{
+			marker.position = glm::vec3(unit(rng) * 700.0f - 350.0f, unit(rng) * 100.0f + 35.0f, unit(rng) * 700.0f - 350.0f);
+			marker.radius	= unit(rng) * 1.5f + 0.5f;
+			marker.color	= glm::vec3(unit(rng) * 0.5f + 0.5f, unit(rng) * 0.5f + 0.5f, unit(rng) * 0.5f + 0.5f);
+			marker.padding	= 0.0f;
+		}
+
+		ArrayBuffer buffer;
+		buffer.BufferData(markers);
+		VertexArrayObject patches;
+		VertexArrayObject instances;
+		InitLightMarkerVaos(buffer, 0, patches, instances);
+
+		LightMarkerBenchmark result{ count, 0.0, 0.0 };
+		for (LightMarkerMode mode : { LightMarkerMode::Tessellated, LightMarkerMode::Impostor })
+		{
+			// warm-up draw, so that no lazy driver work ends up in the measurement
+			glClear(GL_DEPTH_BUFFER_BIT);
+			DrawLightMarkers(mode, patches, instances, count);
+
+			QueryObject<QueryType::TimeElapsed> timer;
+			timer.Begin();
+			for (int i = 0; i < repetitions; ++i)
+			{
+				glClear(GL_DEPTH_BUFFER_BIT);
+				DrawLightMarkers(mode, patches, instances, count);
+			}
+			timer.End();
+
+			double ms = timer.GetResult() / 1e6 / repetitions;
+			(mode == LightMarkerMode::Tessellated ? result.tessellatedMs : result.impostorMs) = ms;
+		}
+
+		lightMarkerBenchmarks.push_back(result);
+		std::cout << "  " << count << " lights: tessellated " << result.tessellatedMs << " ms, impostors " << result.impostorMs << " ms\n";
+	}
+}
+
+void CMyApp::BenchmarkLightSimulation()
+{
+	// the simulation would compete for the same workers
+	SimulationThread::Pause pause(simulationThread.get());
+	unsigned int threads = jobSystem.WorkerCount() + 1;
+	lightSimulationBenchmarks = LightSimulation::Benchmark({ 100, 1000, 10000, 100000 }, 100, lightParallelFor);
+
+	std::cout << "light simulation benchmark (CPU ms per step, SIMD: " << LightSimulation::SimdName() << ", " << threads << " threads):\n";
+	for (const LightSimulation::BenchmarkResult& result : lightSimulationBenchmarks)
+		std::cout << "  " << result.count << " lights: scalar " << result.scalarMs << " ms, SIMD " << result.simdMs
+				  << " ms, threaded " << result.parallelMs << " ms\n";
+}
+
+void CMyApp::Render()
+{
+	// The newest simulated frame. With a fixed timestep every one is rendered exactly once, so that runs repeat;
+	// otherwise the simulation is only waited for before its first frame, a slow one shows the same frame again
+	if (simulationThread)
+		simulationThread->WaitForStep(fixedTimestep > 0.0 ? renderedFrame + 1 : 1);
+	snapshots.Acquire();
+	const FrameSnapshot& frame = snapshots.ReadBuffer();
+	renderedFrame = frame.number;
+	if (simulationThread)
+		simulationThread->Consumed(renderedFrame);
+	framePacer.SetInputTime(frame.inputTime);
+
+	// a new frame: the previous one's transient data is gone, its allocations are counted
+	frameArena.Reset();
+	streamBuffer.BeginFrame();
+	AllocationCounter::Totals totals = AllocationCounter::Now();
+	frameAllocations = { totals.allocations - allocationTotals.allocations, totals.bytes - allocationTotals.bytes };
+	allocationTotals = totals;
+
+	// a resize reallocates the window sized targets only once the window has settled
+	if (renderTargets.Update())
+		renderGraph.Reattach();
+
+	if (vegetationDirty)
+	{
+		PlaceVegetation();
+		vegetationDirty = false;
+	}
 
+	// captures of earlier frames that have arrived go to the writer thread
+	frameReadback.Poll();
+
+	// the frame may be behind the light time of the last switch to the GPU
+	if (gpuLightAnimation && frame.lightTime > gpuLightTime)
+	{
+		AnimateLightsOnGpu(static_cast<float>(frame.lightTime - gpuLightTime));
+		gpuLightTime = frame.lightTime;
+	}
+
+	// Camera and light matrices for every program, and the lights, written straight into the stream buffer
+	UpdateFrameUniforms(frame);
+	UpdateLightMarkers(frame);
+	// The passes, see BuildRenderGraph; the window's framebuffer is bound afterwards
+	renderGraph.Execute();
+	streamBuffer.EndFrame();
+
+	for (const std::string& filename : captureRequests)
+		frameReadback.Capture(0, GL_BACK, width, height, filename);
+	captureRequests.clear();
+
+	gpuProfiler.ShowWindow("GPU profiler");
+	framePacer.ShowWindow("Frame pacing");
+	renderGraph.ShowWindow("Render graph");
+	pipelineStatistics.ShowWindow("Pipeline statistics");
+	GpuResources::ShowWindow("GPU memory");
+
+	if (ImGui::Begin("Settings"))
+	{
+		if (AllocationCounter::Enabled())
+			ImGui::Text("Allocations last frame: %llu (%llu bytes)", static_cast<unsigned long long>(frameAllocations.allocations),
+						static_cast<unsigned long long>(frameAllocations.bytes));
+		else
+			ImGui::Text("Allocations are counted in builds with COUNT_ALLOCATIONS");
+		// the thread is started or stopped between two frames, Update runs on the main thread from the next one
+		bool threaded = HasSimulationThread();
+		if (ImGui::Checkbox("Simulation thread (overlaps, adds a frame of latency)", &threaded))
+			SetSimulationThread(threaded);
+		ImGui::Text("Simulated frame %llu", static_cast<unsigned long long>(renderedFrame));
+		ImGui::Text("Render targets: %dx%d of %dx%d, %d allocations", renderTargets.ViewportWidth(), renderTargets.ViewportHeight(),
+					renderTargets.AllocatedWidth(), renderTargets.AllocatedHeight(), static_cast<int>(renderTargets.Reallocations()));
+		ImGui::Text("Frame arena: %d KB used, %d KB capacity, %d overflows", static_cast<int>(frameArena.HighWater() / 1024),
+					static_cast<int>(frameArena.Capacity() / 1024), static_cast<int>(frameArena.Overflows()));
+		ImGui::Text("Stream buffer (%s): %d KB used of %d KB per frame, %d waits, %d overflows",
+					streamBuffer.IsPersistent() ? "persistent" : "glBufferSubData", static_cast<int>(streamBuffer.HighWater() / 1024),
+					static_cast<int>(streamBuffer.SliceSize() / 1024), static_cast<int>(streamBuffer.Waits()), static_cast<int>(streamBuffer.Overflows()));
+		ImGui::Checkbox("Shadows", &shadowsEnabled);
+		ImGui::Checkbox("Depth pre-pass", &depthPrepassEnabled);
+		ImGui::Checkbox("Overdraw heat map", &overdrawEnabled);
+		if (ImGui::Button("Capture G-buffer"))
+			captureGBuffer = true;
+		// instances are placed again at the start of the next frame
+		if (ImGui::SliderFloat("Vegetation density", &vegetationDensity, 0.0f, 10.0f))
+			vegetationDirty = true;
+		ImGui::Text("Vegetation instances: %d grass, %d plants, %d palms", vegetation_grass->InstanceCount(), vegetation_plants->InstanceCount(), vegetation_palms->InstanceCount());
+		ImGui::Checkbox("Vegetation impostors", &impostorsEnabled);
+		ImGui::SliderFloat("Impostor distance", &impostorDistance, 10.0f, 500.0f);
+		ImGui::Checkbox("Adaptive light sphere tessellation", &adaptiveTessellation);
+		ImGui::SliderFloat("Pixels per tessellated edge", &tessPixelsPerEdge, 2.0f, 64.0f);
+		ImGui::Text("Light marker triangles: %llu", static_cast<unsigned long long>(spherePrimitives));
+
+		int markerMode = static_cast<int>(lightMarkerMode);
+		if (ImGui::Combo("Light markers", &markerMode, "Tessellated spheres\0Ray-cast impostors\0"))
+			lightMarkerMode = static_cast<LightMarkerMode>(markerMode);
+		if (ImGui::Button("Benchmark light markers"))
+			runLightMarkerBenchmark = true;
+		for (const LightMarkerBenchmark& result : lightMarkerBenchmarks)
+			ImGui::Text("%5d lights: tessellated %.3f ms, impostors %.3f ms", result.count, result.tessellatedMs, result.impostorMs);
+
+		bool gpuLights = gpuLightAnimation;
+		if (!gpuLightAnimationSupported)
+			ImGui::Text("Animate lights on the GPU: needs compute shaders and storage buffers");
+		else if (ImGui::Checkbox("Animate lights on the GPU", &gpuLights))
+			SetGpuLightAnimation(gpuLights);
+
+		// CPU only, so it can run right here
+		if (ImGui::Button("Benchmark light simulation"))
+			BenchmarkLightSimulation();
+		for (const LightSimulation::BenchmarkResult& result : lightSimulationBenchmarks)
+			ImGui::Text("%6d lights: scalar %.3f ms, %s %.3f ms, threaded %.3f ms", static_cast<int>(result.count), result.scalarMs,
+						LightSimulation::SimdName(), result.simdMs, result.parallelMs);
+	}
+	ImGui::End();
+
+	// only the viewport's corner of the window sized targets
+	ImVec2 targetUv0(0, renderTargets.ScaleY());
+	ImVec2 targetUv1(renderTargets.ScaleX(), 0);
 	if (ImGui::Begin("Base Color"))
 	{
-		ImGui::Image((ImTextureID)colorBuffer, ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
+		ImGui::Image((ImTextureID)renderGraph.Name(colorTarget), ImVec2(256, 256), targetUv0, targetUv1);
 	}
 	ImGui::End();
 
 	if (ImGui::Begin("Normal Vectors"))
 	{
-		ImGui::Image((ImTextureID)normalBuffer, ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
+		ImGui::Image((ImTextureID)renderGraph.Name(normalTarget), ImVec2(256, 256), targetUv0, targetUv1);
 	}
 	ImGui::End();
 
+	if (overdrawEnabled)
+	{
+		if (ImGui::Begin("Overdraw"))
+		{
+			ImGui::Image((ImTextureID)renderGraph.Name(overdrawHeatMapTarget), ImVec2(256, 256), targetUv0, targetUv1);
+			ImGui::Checkbox("Depth tested", &overdrawDepthTest);
+			ImGui::SliderFloat("Red at", &overdrawMax, 2.0f, 32.0f);
+			ImGui::Text("1: blue, green, yellow, red, above: white");
+		}
+		ImGui::End();
+	}
+
 	if (ImGui::Begin("Depth from dir. light"))
 	{
 		ImGui::Image((ImTextureID)shadow_depth_texture, ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
@@ -473,21 +1224,28 @@ void CMyApp::Render()
 
 void CMyApp::KeyboardDown(SDL_KeyboardEvent& key)
 {
-	if (key.keysym.sym == SDLK_f)
+	if (key.keysym.sym == SDLK_F12)
 	{
-		frozen = !frozen;
+		RequestCapture("screenshot_" + std::to_string(captureCount++) + ".tga");
 	}
-	camera.KeyboardDown(key);
+	// the camera and freezing belong to the simulation, the events are applied by the next Update
+	SDL_Event ev;
+	ev.key = key;
+	QueueInput(ev);
 }
 
 void CMyApp::KeyboardUp(SDL_KeyboardEvent& key)
 {
-	camera.KeyboardUp(key);
+	SDL_Event ev;
+	ev.key = key;
+	QueueInput(ev);
 }
 
 void CMyApp::MouseMove(SDL_MouseMotionEvent& mouse)
 {
-	camera.MouseMove(mouse);
+	SDL_Event ev;
+	ev.motion = mouse;
+	QueueInput(ev);
 }
 
 void CMyApp::MouseDown(SDL_MouseButtonEvent& mouse)
@@ -506,9 +1264,15 @@ void CMyApp::MouseWheel(SDL_MouseWheelEvent& wheel)
 void CMyApp::Resize(int _w, int _h)
 {
 	glViewport(0, 0, _w, _h );
-	camera.Resize(_w, _h);
+	SDL_Event ev;
+	ev.window.type = SDL_WINDOWEVENT;
+	ev.window.event = SDL_WINDOWEVENT_SIZE_CHANGED;
+	ev.window.data1 = _w;
+	ev.window.data2 = _h;
+	QueueInput(ev);
 	width = _w;
 	height = _h;
-	CreateFrameBuffers();
+	renderTargets.Resize(_w, _h);
+	renderGraph.SetBackbufferSize(_w, _h);
 	std::cout << "new width = " << _w << " | new height = " << _h << "\n";
 }
\ No newline at end of file
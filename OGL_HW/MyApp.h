@@ -3,6 +3,9 @@
 // C++ includes
 #include <memory>
 #include <array>
+#include <atomic>
+#include <mutex>
+#include <random>
 
 // GLEW
 #include <GL/glew.h>
@@ -20,24 +23,91 @@
 
 #include "Mesh_OGL3.h"
 #include "ProgramObject.h"
+#include "ProgramBinaryCache.h"
+#include "ProgramVariantCache.h"
 #include "BufferObject.h"
 #include "VertexArrayObject.h"
 #include "TextureObject.h"
+#include "UniformBlocks.h"
+#include "QueryObject.h"
+#include "Vegetation.h"
+#include "GpuProfiler.h"
+#include "CameraPath.h"
+#include "PipelineStatistics.h"
+#include "FrameReadback.h"
+#include "LightSimulation.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "AllocationCounter.h"
+#include "TripleBuffer.h"
+#include "SimulationThread.h"
+#include "FramePacer.h"
+#include "RenderTargetPool.h"
+#include "RenderGraph.h"
+#include "StreamBuffer.h"
 
 const static unsigned int NUM_POINT_LIGHTS = 100;
+// units per second
+const static float POINT_LIGHT_SPEED = 60.0f;
+// lights per job of the simulation, fewer than this are moved on the calling thread
+const static size_t LIGHT_SIMULATION_GRAIN = 4096;
 const static int DIR_SHADOW_MAP_RES = 2048;
+// vegetation impostors: views baked around the vertical axis, resolution of one view, width of the cross-fade band
+const static int IMPOSTOR_VIEW_COUNT = 16;
+const static int IMPOSTOR_TILE_RES = 128;
+const static float IMPOSTOR_FADE_RANGE = 20.0f;
+
+// Per light data read by the light marker shaders: one patch vertex (tessellated) or one instance (impostor) per light
+struct LightMarker
+{
+	glm::vec3	position;
+	float		radius;
+	glm::vec3	color;
+	float		padding;
+};
+
+// Everything Render needs from a simulated frame. Update fills one in on the simulation thread and Render draws the
+// newest one, so the simulation never touches what is being rendered
+struct FrameSnapshot
+{
+	uint64_t	number;		// counted from 1, 0 before the first Update
+	glm::mat4	view;
+	glm::mat4	proj;
+	glm::mat4	viewProj;
+	glm::vec3	eye;
+	float		time;
+	uint64_t	inputTime;	// CpuProfiler::Now() when the input this frame reacts to was read
+	double		lightTime;	// seconds the lights have moved for, the GPU animation catches up with it
+	glm::mat4	waterLevel;
+	std::array<glm::vec3, NUM_POINT_LIGHTS>	pointLightPositions;
+};
+
+enum class LightMarkerMode : int
+{
+	Tessellated = 0,
+	Impostor
+};
 
 class CMyApp
 {
 public:
-	CMyApp(int, int);
+	// the seed drives every random choice of the scene (light placement and movement), so a run can be repeated;
+	// CPU heavy work (asset loading, light simulation) is spread over the job system's workers
+	CMyApp(int, int, JobSystem&, unsigned int seed = 1);
 	~CMyApp(void);
 
 	bool Init();
 	void Clean();
 
+	// Update simulates a frame, Render draws the newest simulated one. Without the simulation thread both are
+	// called by the main loop; with it, the thread runs Update while the main thread renders the frame before.
+	// The thread adds a frame between reading the input and showing it, so it can be turned off for latency
 	void Update();
 	void Render();
+	void SetSimulationThread(bool enable);
+	bool HasSimulationThread() const { return simulationThread != nullptr; }
+	// the main loop has just read the input events
+	void SetInputTime(uint64_t ns) { inputTime = ns; }
 
 	void KeyboardDown(SDL_KeyboardEvent&);
 	void KeyboardUp(SDL_KeyboardEvent&);
@@ -46,32 +116,85 @@ public:
 	void MouseUp(SDL_MouseButtonEvent&);
 	void MouseWheel(SDL_MouseWheelEvent&);
 	void Resize(int, int);
+
+	// main.cpp brackets the frame and the ImGui pass with it
+	GpuProfiler& GetGpuProfiler() { return gpuProfiler; }
+	// and the swap with this
+	FramePacer& GetFramePacer() { return framePacer; }
+
+	// for benchmark runs: a fixed simulated time per frame instead of the wall clock (0 goes back to it),
+	// and a path the camera follows instead of the user's input (nullptr to stop)
+	void SetFixedTimestep(double seconds) { fixedTimestep = seconds; }
+	void SetCameraPath(const CameraPath* path) { cameraPath = path; cameraPathTime = 0.0f; }
+
+	// the next rendered frame, without the GUI, is written to filename (TGA) a few frames later
+	void RequestCapture(const std::string& filename) { captureRequests.push_back(filename); }
 protected:
 	void LoadAssets();
 	void CreateFrameBuffers();
-	void DrawScene(glm::mat4);
+	void BuildRenderGraph();
+	void DrawScene(const FrameSnapshot&);
+	void DrawImpostorsAndLights(const FrameSnapshot&);
+	void DrawSceneDepth(ProgramObject&, ProgramObject& instanced, const FrameSnapshot&, bool fromCamera);
+	void SetGpuLightAnimation(bool);
+	void AnimateLightsOnGpu(float seconds);
+	void QueueInput(const SDL_Event&);
+	void ApplyInput();
+	void SetImpostorFade(ProgramObject&);
+	float VegetationGeometryDistance() const;
+	void PlaceVegetation();
+	void CreateUniformBuffers();
+	int  PollPrograms();
+	void UpdateFrameUniforms(const FrameSnapshot&);
+	void UpdateLightMarkers(const FrameSnapshot&);
+	void BindMaterial(MaterialId);
+	void InitLightMarkerVaos(GLuint buffer, GLintptr offset, VertexArrayObject& patches, VertexArrayObject& instances);
+	void SetLightMarkerSource(GLuint buffer, GLintptr offset, size_t generation = 0);
+	void DrawLightMarkers(LightMarkerMode, VertexArrayObject& patches, VertexArrayObject& instances, GLsizei count);
+	void BenchmarkLightMarkers();
+	void BenchmarkLightSimulation();
+	float RandomUnit();
 
 	int						width;
 	int						height;
 	bool					frameBufferCreated;
 
-	GLuint					shadow_fbo;
 	GLuint					shadow_depth_texture;
 
-	GLuint					fbo;
-	GLuint					colorBuffer;
-	GLuint					normalBuffer;
-	GLuint					positionBuffer;
-	GLuint					materialBuffer;
-	GLuint					depthBuffer;
+	// the window sized textures and renderbuffers of the render graph's transient targets
+	RenderTargetPool		renderTargets;
+	// the passes of a frame, see BuildRenderGraph; the targets below are shown by ImGui after it ran
+	RenderGraph				renderGraph;
+	RenderGraph::Resource	colorTarget;
+	RenderGraph::Resource	normalTarget;
+	RenderGraph::Resource	overdrawHeatMapTarget;
 
 	gCamera					camera;
 
+	ProgramBinaryCache		programCache;
 	ProgramObject			programForwardRenderer;
 	ProgramObject			programLightRenderer;
 	ProgramObject			programLightSpheres;
+	ProgramObject			programLightImpostors;
 	ProgramObject			programShadowMapper;
-	ProgramObject			programDirectionalLight;
+	ProgramVariantCache		programVariants;
+	// [0]: without shadows, [1]: shadow mapped, both specializations of directionalLight.frag
+	std::array<ProgramObject*, 2>	programDirectionalLight;
+	ProgramObject*			programDepthPrepass;
+	// INSTANCED variants of the above, for the vegetation
+	ProgramObject*			programForwardInstanced;
+	ProgramObject*			programShadowInstanced;
+	ProgramObject*			programDepthPrepassInstanced;
+	ProgramObject*			programImpostorBake;
+	ProgramObject*			programVegetationImpostors;
+	ProgramObject*			programOverdraw;
+	ProgramObject*			programOverdrawInstanced;
+	ProgramObject*			programOverdrawResolve;
+	// only built with compute shaders and storage buffers, see gpuLightAnimation
+	ProgramObject*			programLightAnimation;
+	ProgramObject*			programLightRendererSsbo;
+	std::vector<ProgramObject*>	programs;
+	ShaderDefines			sceneDefines;
 
 	Texture2D				tex_terrain;
 	Texture2D				tex_grass;
@@ -82,22 +205,108 @@ protected:
 	Texture2D				tex_water;
 
 	std::unique_ptr<Mesh>	mesh_terrain;
-	std::unique_ptr<Mesh>	mesh_grass;
-	std::unique_ptr<Mesh>	mesh_leaves;
-	std::unique_ptr<Mesh>	mesh_stems;
-	std::unique_ptr<Mesh>	mesh_plants;
 	std::unique_ptr<Mesh>	mesh_rocks;
 	std::unique_ptr<Mesh>	mesh_water;
 
-	std::vector<glm::vec3>	pointLightPositions;
-	std::vector<glm::vec3>	pointLightNextPositions;
+	// grass and plants are prototype meshes repeated over the terrain
+	std::unique_ptr<VegetationPlacer>	vegetationPlacer;
+	std::unique_ptr<VegetationLayer>	vegetation_grass;
+	std::unique_ptr<VegetationLayer>	vegetation_plants;
+	std::unique_ptr<VegetationLayer>	vegetation_palms;	// stems and leaves, where the palms were modelled
+	float					vegetationDensity;
+	bool					vegetationDirty;
+	// instances farther than this are faded over to their impostors
+	bool					impostorsEnabled;
+	float					impostorDistance;
+
+	JobSystem&				jobSystem;
+	// transient data of the frame being rendered, reset at the start of Render
+	FrameArena				frameArena;
+	AllocationCounter::Totals	allocationTotals;	// at the start of the last Render
+	AllocationCounter::Totals	frameAllocations;	// during the frame before
+
+	// simulated frames, from Update to Render
+	TripleBuffer<FrameSnapshot>	snapshots;
+	uint64_t				simulatedFrames;
+	uint64_t				renderedFrame;		// number of the snapshot last rendered
+	// input for the camera, handed from the main thread to Update; the lock is only taken when there are events
+	std::mutex				inputMutex;
+	std::vector<SDL_Event>	pendingInput;
+	std::vector<SDL_Event>	simulationInput;	// swapped with pendingInput by Update
+	std::atomic<bool>		inputPending;
+	std::atomic<uint64_t>	inputTime;
+
+	std::unique_ptr<LightSimulation>	lightSimulation;
+	LightSimulation::ParallelFor	lightParallelFor;	// on the job system, wrapped once
+	double					lightTime;			// seconds the lights have moved for, advanced by Update
+	// lights moved by light_animation.comp inside lightMarkerBuffer, which both the markers and the point-light
+	// pass read, so nothing about the lights is uploaded per frame; switched while the simulation is paused
+	bool					gpuLightAnimationSupported;
+	bool					gpuLightAnimation;
+	double					gpuLightTime;		// lightTime the GPU lights have moved up to
+	BufferObject<BufferType::ShaderStorage, BufferUsage::DynamicCopy>	lightMotionBuffer;
 	std::vector<float>		pointLightStrengths;
 	std::vector<glm::vec3>	pointLightColors;
-	ArrayBuffer				spherePositions;
-	VertexArrayObject		spheres_vao;
+	// everything the CPU writes per frame: the per-frame uniforms and, without the GPU animation, the light markers
+	StreamBuffer			streamBuffer;
+	StreamBuffer::Allocation	frameUniforms;
+	StreamBuffer::Allocation	streamedLightMarkers;
+	BufferObject<BufferType::Uniform, BufferUsage::StaticDraw>	materialUniformBuffer;
+	GLsizeiptr				materialStride;
+	glm::mat4				lightViewProj;
+
+	bool					adaptiveTessellation;
+	float					tessPixelsPerEdge;
+	QueryRing<QueryType::PrimitivesGenerated>	spherePrimitivesQuery;
+	GLuint64				spherePrimitives;
+
+	LightMarkerMode			lightMarkerMode;
+	ArrayBuffer				lightMarkerBuffer;
+	VertexArrayObject		spheres_vao;	// one patch vertex per light
+	VertexArrayObject		impostors_vao;	// one instance per light
+	GLuint					lightMarkerVaoBuffer;	// where the two above read the markers from
+	GLintptr				lightMarkerVaoOffset;
+	size_t					lightMarkerVaoGeneration;
+
+	struct LightMarkerBenchmark
+	{
+		int		count;
+		double	tessellatedMs;
+		double	impostorMs;
+	};
+	std::vector<LightMarkerBenchmark>	lightMarkerBenchmarks;
+	bool					runLightMarkerBenchmark;
+	std::vector<LightSimulation::BenchmarkResult>	lightSimulationBenchmarks;
 
 	double					delta_time;
+	double					fixedTimestep;
 	float					t;
+	std::mt19937			rng;
+
+	const CameraPath*		cameraPath;
+	float					cameraPathTime;
+
 	bool					frozen;
+	bool					shadowsEnabled;
+
+	// optional camera depth pass before the G-buffer pass, so that the MRT writes happen once per pixel
+	bool					depthPrepassEnabled;
+
+	GpuProfiler				gpuProfiler;
+	FramePacer				framePacer;
+	PipelineStatistics		pipelineStatistics;
+
+	FrameReadback			frameReadback;
+	std::vector<std::string>	captureRequests;
+	bool					captureGBuffer;
+	int						captureCount;
+
+	bool					overdrawEnabled;
+	// off: every fragment counts, not only the ones that pass the depth test
+	bool					overdrawDepthTest;
+	float					overdrawMax;
+
+	// runs Update; last, so that it stops before anything it uses is destroyed
+	std::unique_ptr<SimulationThread>	simulationThread;
 };
 
@@ -2,10 +2,26 @@
 
 #include <string>
 
+#include "CpuProfiler.h"
+
 using namespace std;
 
 std::unique_ptr<Mesh> ObjParser::parse(const char* fileName)
 {
+	CPU_ZONE("ObjParser::parse", fileName);
+	std::unique_ptr<Mesh> mesh = load(fileName);
+
+	{
+		CPU_ZONE("Mesh::initBuffers");
+		mesh->initBuffers(fileName);
+	}
+
+	return mesh;
+}
+
+std::unique_ptr<Mesh> ObjParser::load(const char* fileName)
+{
+	CPU_ZONE("ObjParser::load", fileName);
 	ObjParser theParser;
 
 	theParser.ifs.open(fileName, ios::in|ios::binary);
@@ -14,17 +30,18 @@ std::unique_ptr<Mesh> ObjParser::parse(const char* fileName)
 
 	theParser.mesh = new Mesh();
 
-	while(theParser.skipCommentLine()) 
 	{
-		if (false == theParser.processLine())
-			break;
+		CPU_ZONE("ObjParser::processLines");
+		while(theParser.skipCommentLine()) 
+		{
+			if (false == theParser.processLine())
+				break;
+		}
 	}
 
 	theParser.ifs.close();
 
-	theParser.mesh->initBuffers();
-
-	return std::make_unique<Mesh>(*theParser.mesh);
+	return std::unique_ptr<Mesh>(theParser.mesh);
 }
 
 bool ObjParser::processLine()
@@ -16,6 +16,8 @@ class ObjParser
 {
 public:
 	static std::unique_ptr<Mesh> parse(const char* fileName);
+	// parse without initBuffers, touches no GL so it can run on any thread
+	static std::unique_ptr<Mesh> load(const char* fileName);
 
 	enum Exception { EXC_FILENOTFOUND };
 private:
@@ -0,0 +1,117 @@
+#include "PipelineStatistics.h"
+
+#include <iostream>
+
+#include <imgui/imgui.h>
+
+namespace
+{
+	const char* const COUNTER_NAMES[PipelineStatistics::COUNTER_COUNT] = { "Vertices", "Primitives", "VS inv.", "TES inv.", "Clipped prims", "FS inv.", "Samples" };
+}
+
+PipelineStatistics::PipelineStatistics()
+{
+	m_supported = GLEW_ARB_pipeline_statistics_query != GL_FALSE;
+}
+
+void PipelineStatistics::BeginPass(const char* name)
+{
+	if (m_active != nullptr)
+	{
+		std::cerr << "[PipelineStatistics] " << name << " started inside " << m_active->name << ", passes cannot nest" << std::endl;
+		return;
+	}
+	if (!m_enabled)
+		return;
+
+	auto it = m_passIndices.find(name);
+	if (it == m_passIndices.end())
+	{
+		it = m_passIndices.emplace(name, m_passes.size()).first;
+		m_passes.push_back(std::make_unique<Pass>());
+		m_passes.back()->name = name;
+	}
+
+	m_active = m_passes[it->second].get();
+	if (m_supported)
+	{
+		m_active->vertices.Begin();
+		m_active->primitives.Begin();
+		m_active->vertexShader.Begin();
+		m_active->tessEvaluationShader.Begin();
+		m_active->clipped.Begin();
+		m_active->fragmentShader.Begin();
+	}
+	m_active->samples.Begin();
+}
+
+void PipelineStatistics::EndPass()
+{
+	if (m_active == nullptr)
+		return;
+
+	if (m_supported)
+	{
+		m_active->vertices.End();
+		m_active->primitives.End();
+		m_active->vertexShader.End();
+		m_active->tessEvaluationShader.End();
+		m_active->clipped.End();
+		m_active->fragmentShader.End();
+	}
+	m_active->samples.End();
+	m_active = nullptr;
+}
+
+void PipelineStatistics::Collect(Pass& pass)
+{
+	if (m_supported)
+	{
+		pass.vertices.TryGetResult(pass.counts[VerticesSubmitted]);
+		pass.primitives.TryGetResult(pass.counts[PrimitivesSubmitted]);
+		pass.vertexShader.TryGetResult(pass.counts[VertexShaderInvocations]);
+		pass.tessEvaluationShader.TryGetResult(pass.counts[TessEvaluationShaderInvocations]);
+		pass.clipped.TryGetResult(pass.counts[ClippingOutputPrimitives]);
+		pass.fragmentShader.TryGetResult(pass.counts[FragmentShaderInvocations]);
+	}
+	pass.samples.TryGetResult(pass.counts[SamplesPassed]);
+}
+
+void PipelineStatistics::ShowWindow(const char* title)
+{
+	if (ImGui::Begin(title))
+	{
+		ImGui::Checkbox("Count", &m_enabled);
+		if (!m_supported)
+			ImGui::Text("ARB_pipeline_statistics_query is not available, only samples are counted");
+
+		ImGui::Columns(COUNTER_COUNT + 1, "pipeline_statistics");
+		ImGui::Text("Pass");
+		ImGui::NextColumn();
+		for (const char* name : COUNTER_NAMES)
+		{
+			ImGui::Text("%s", name);
+			ImGui::NextColumn();
+		}
+		ImGui::Separator();
+
+		for (const std::unique_ptr<Pass>& pass : m_passes)
+		{
+			if (m_enabled)
+				Collect(*pass);
+
+			ImGui::Text("%s", pass->name.c_str());
+			ImGui::NextColumn();
+			for (int counter = 0; counter < COUNTER_COUNT; ++counter)
+			{
+				if (m_supported || counter == SamplesPassed)
+					ImGui::Text("%llu", static_cast<unsigned long long>(pass->counts[counter]));
+				else
+					ImGui::Text("-");
+				ImGui::NextColumn();
+			}
+		}
+		ImGui::Columns(1);
+	}
+	ImGui::End();
+}
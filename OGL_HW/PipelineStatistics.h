@@ -0,0 +1,83 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <array>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "QueryObject.h"
+
+/*
+	Per pass counts of the work the pipeline did: vertices and primitives submitted, vertex and tessellation
+	evaluation shader invocations, primitives out of the clipper, fragment shader invocations and samples
+	passed. All but the samples need ARB_pipeline_statistics_query; without it only the samples are counted.
+
+	Only one query of a kind can be active at a time, so passes cannot nest. The counts are read from
+	QueryRings, a few frames late, and only while the statistics are enabled.
+*/
+class PipelineStatistics final
+{
+public:
+	enum Counter
+	{
+		VerticesSubmitted = 0,
+		PrimitivesSubmitted,
+		VertexShaderInvocations,
+		TessEvaluationShaderInvocations,
+		ClippingOutputPrimitives,
+		FragmentShaderInvocations,
+		SamplesPassed,
+		COUNTER_COUNT
+	};
+
+	class Scope final
+	{
+	public:
+		Scope(PipelineStatistics& statistics, const char* name) : m_statistics(statistics) { m_statistics.BeginPass(name); }
+		~Scope() { m_statistics.EndPass(); }
+
+		Scope(const Scope&)				= delete;
+		Scope& operator=(const Scope&)	= delete;
+
+	private:
+		PipelineStatistics&	m_statistics;
+	};
+
+	PipelineStatistics();
+
+	bool IsSupported() const { return m_supported; }
+	void SetEnabled(bool enabled) { m_enabled = enabled; }
+	bool IsEnabled() const { return m_enabled; }
+
+	void BeginPass(const char* name);
+	void EndPass();
+
+	// reads the results that have arrived and shows the last count of every pass
+	void ShowWindow(const char* title);
+
+private:
+	struct Pass
+	{
+		std::string														name;
+		QueryRing<QueryType::VerticesSubmitted>							vertices;
+		QueryRing<QueryType::PrimitivesSubmitted>						primitives;
+		QueryRing<QueryType::VertexShaderInvocations>					vertexShader;
+		QueryRing<QueryType::TessEvaluationShaderInvocations>			tessEvaluationShader;
+		QueryRing<QueryType::ClippingOutputPrimitives>					clipped;
+		QueryRing<QueryType::FragmentShaderInvocations>					fragmentShader;
+		QueryRing<QueryType::SamplesPassed>								samples;
+		std::array<GLuint64, COUNTER_COUNT>								counts{};
+	};
+
+	void Collect(Pass& pass);
+
+	bool									m_supported;
+	bool									m_enabled = false;
+	std::vector<std::unique_ptr<Pass>>		m_passes;	// in the order they first ran
+	std::map<std::string, size_t, std::less<>>	m_passIndices;	// found by const char* without a std::string
+	Pass*									m_active = nullptr;	// also nullptr while disabled
+};
@@ -0,0 +1,157 @@
+#include "ProgramBinaryCache.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+namespace
+{
+	// "OGLB", written in front of every binary so that stray files are never fed to the driver
+	const uint32_t CACHE_FILE_MAGIC = 0x424C474F;
+
+	struct CacheFileHeader
+	{
+		uint32_t	magic;
+		GLenum		format;
+		uint32_t	length;
+	};
+
+	// 64 bit FNV-1a, good enough to tell shader sources apart
+	uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	uint64_t HashString(uint64_t hash, const std::string& str)
+	{
+		// the terminating zero keeps "ab"+"c" and "a"+"bc" apart
+		return HashBytes(hash, str.c_str(), str.size() + 1);
+	}
+
+	std::string GLString(GLenum name)
+	{
+		const GLubyte* str = glGetString(name);
+		return str != nullptr ? reinterpret_cast<const char*>(str) : "";
+	}
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& directory) : m_directory(directory)
+{
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	m_supported = formatCount > 0;
+
+	m_driverId = GLString(GL_VENDOR) + "|" + GLString(GL_RENDERER) + "|" + GLString(GL_VERSION);
+
+	if (m_supported)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(m_directory, error);
+		if (error)
+		{
+			std::cerr << "[ProgramBinaryCache] Cannot create cache directory " << m_directory << ": " << error.message() << std::endl;
+			m_supported = false;
+		}
+	}
+}
+
+std::string ProgramBinaryCache::MakeKey(const std::vector<TypeSourcePair>& sources, const std::string& defines) const
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = HashString(hash, m_driverId);
+	hash = HashString(hash, defines);
+	for (const TypeSourcePair& source : sources)
+	{
+		hash = HashBytes(hash, &source.first, sizeof(source.first));
+		hash = HashString(hash, source.second);
+	}
+
+	std::ostringstream key;
+	key << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return key.str();
+}
+
+std::string ProgramBinaryCache::FilePath(const std::string& key) const
+{
+	return m_directory + "/" + key + ".bin";
+}
+
+bool ProgramBinaryCache::Load(GLuint program, const std::string& key)
+{
+	if (!m_supported)
+		return false;
+
+	std::ifstream file(FilePath(key), std::ios::in | std::ios::binary | std::ios::ate);
+	const std::streamoff fileSize = file.is_open() ? static_cast<std::streamoff>(file.tellg()) : 0;
+	file.seekg(0);
+	CacheFileHeader header{};
+	if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != CACHE_FILE_MAGIC)
+	{
+		++m_misses;
+		return false;
+	}
+
+	// a truncated or damaged file must not size the allocation
+	if (header.length == 0 || header.length > fileSize - static_cast<std::streamoff>(sizeof(header)))
+	{
+		++m_misses;
+		return false;
+	}
+
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+	{
+		++m_misses;
+		return false;
+	}
+
+	glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+	// the driver is free to refuse a binary, e.g. after an update that kept the version string
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE)
+	{
+		++m_rejected;
+		++m_misses;
+		return false;
+	}
+
+	++m_hits;
+	return true;
+}
+
+void ProgramBinaryCache::Store(GLuint program, const std::string& key)
+{
+	if (!m_supported)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	CacheFileHeader header{ CACHE_FILE_MAGIC, 0, 0 };
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &header.format, binary.data());
+	header.length = static_cast<uint32_t>(written);
+
+	std::ofstream file(FilePath(key), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cerr << "[ProgramBinaryCache] Cannot write " << FilePath(key) << std::endl;
+		return;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(binary.data(), written);
+}
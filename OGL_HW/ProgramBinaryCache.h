@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <string>
+#include <vector>
+
+#include "GLconversions.hpp"
+
+/*
+	On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary). Entries are keyed on
+	the shader sources, the injected defines and the driver (vendor, renderer, version), so a driver update
+	or an edited shader simply results in a cache miss. The driver may still reject a binary (Load returns
+	false), in that case the caller has to compile from source and Store the new binary.
+*/
+class ProgramBinaryCache final
+{
+public:
+	explicit ProgramBinaryCache(const std::string& directory = "shader_cache");
+
+	ProgramBinaryCache(const ProgramBinaryCache&)				= delete;
+	ProgramBinaryCache& operator=(const ProgramBinaryCache&)	= delete;
+
+	bool IsSupported() const { return m_supported; }
+
+	std::string MakeKey(const std::vector<TypeSourcePair>& sources, const std::string& defines = "") const;
+
+	bool Load(GLuint program, const std::string& key);
+	void Store(GLuint program, const std::string& key);
+
+	int Hits() const		{ return m_hits; }
+	int Misses() const		{ return m_misses; }
+	int Rejected() const	{ return m_rejected; }
+
+private:
+	std::string FilePath(const std::string& key) const;
+
+	std::string	m_directory;
+	std::string	m_driverId;
+	bool		m_supported{};
+
+	int			m_hits{};
+	int			m_misses{};
+	int			m_rejected{};
+};
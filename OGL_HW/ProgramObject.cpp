@@ -1,4 +1,6 @@
 #include "ProgramObject.h"
+#include "ProgramBinaryCache.h"
+#include "CpuProfiler.h"
 #include <SDL.h>
 
 #include <iostream>
@@ -28,8 +30,15 @@ ProgramObject::ProgramObject(ProgramObject && rhs)
 	m_id = rhs.m_id;
 	m_list_shaders_attached = std::move(rhs.m_list_shaders_attached);
 	m_map_uniform_locations = std::move(rhs.m_map_uniform_locations);
+	m_pending = rhs.m_pending;
+	m_linked = rhs.m_linked;
+	m_pending_shaders = std::move(rhs.m_pending_shaders);
+	m_pending_cache = rhs.m_pending_cache;
+	m_pending_cache_key = std::move(rhs.m_pending_cache_key);
+	m_pending_block_bindings = std::move(rhs.m_pending_block_bindings);
 
 	rhs.m_id = 0;
+	rhs.m_pending = false;
 }
 
 ProgramObject & ProgramObject::operator=(ProgramObject && rhs)
@@ -40,8 +49,15 @@ ProgramObject & ProgramObject::operator=(ProgramObject && rhs)
 	m_id = rhs.m_id;
 	m_list_shaders_attached = std::move(rhs.m_list_shaders_attached);
 	m_map_uniform_locations = std::move(rhs.m_map_uniform_locations);
+	m_pending = rhs.m_pending;
+	m_linked = rhs.m_linked;
+	m_pending_shaders = std::move(rhs.m_pending_shaders);
+	m_pending_cache = rhs.m_pending_cache;
+	m_pending_cache_key = std::move(rhs.m_pending_cache_key);
+	m_pending_block_bindings = std::move(rhs.m_pending_block_bindings);
 
 	rhs.m_id = 0;
+	rhs.m_pending = false;
 
 	return *this;
 }
@@ -57,6 +73,117 @@ bool ProgramObject::Init(std::initializer_list<ShaderObject> shaderList, std::in
 	return LinkProgram();
 }
 
+bool ProgramObject::Init(ProgramBinaryCache& cache, std::initializer_list<TypeSourcePair> shaderFiles, const ShaderDefines& defines)
+{
+	return Submit(cache, shaderFiles, defines) && Finalize();
+}
+
+bool ProgramObject::Submit(ProgramBinaryCache& cache, std::initializer_list<TypeSourcePair> shaderFiles, const ShaderDefines& defines)
+{
+	CPU_ZONE("ProgramObject::Submit");
+	if (m_id != 0)
+		Clean();
+
+	std::vector<TypeSourcePair> sources;
+	for (const TypeSourcePair& file : shaderFiles)
+	{
+		std::string source;
+		if (!ShaderPreprocessor::LoadFile(file.second, defines, source))
+		{
+			std::cerr << "[Submit] Cannot open shader file " << file.second << std::endl;
+			return false;
+		}
+		sources.emplace_back(file.first, std::move(source));
+	}
+
+	const std::string key = cache.MakeKey(sources, ShaderPreprocessor::DefinesKey(defines));
+	if (cache.Load(m_id, key))
+	{
+		m_pending = false;
+		m_linked = true;
+		return true;
+	}
+
+	// cache miss or rejected binary: build from source and ask the driver to keep the binary around
+	glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	for (const TypeSourcePair& source : sources)
+	{
+		ShaderObject shader(source.first);
+		shader.SubmitFromMemory(source.second);
+		AttachShader(shader);
+		// kept alive until Finalize, so that the compile logs can be printed if the link fails
+		m_pending_shaders.push_back(std::move(shader));
+	}
+
+	glLinkProgram(m_id);
+
+	m_pending = true;
+	m_linked = false;
+	m_pending_cache = &cache;
+	m_pending_cache_key = key;
+	return true;
+}
+
+bool ProgramObject::IsReady()
+{
+	if (!m_pending)
+		return true;
+
+	// without the extension any status query would block until the driver is done
+	if (!GLEW_KHR_parallel_shader_compile)
+		return false;
+
+	GLint completed = GL_FALSE;
+	glGetProgramiv(m_id, GL_COMPLETION_STATUS_KHR, &completed);
+	if (completed == GL_FALSE)
+		return false;
+
+	Finalize();
+	return true;
+}
+
+bool ProgramObject::Finalize()
+{
+	if (!m_pending)
+		return m_linked;
+
+	CPU_ZONE("ProgramObject::Finalize");
+	m_pending = false;
+	m_linked = CheckLinkStatus();
+
+	if (!m_linked)
+	{
+		for (const ShaderObject& shader : m_pending_shaders)
+			shader.CheckCompileStatus();
+	}
+	else if (m_pending_cache != nullptr)
+	{
+		m_pending_cache->Store(m_id, m_pending_cache_key);
+	}
+
+	m_pending_shaders.clear();
+	m_pending_cache = nullptr;
+	m_pending_cache_key.clear();
+
+	if (m_linked)
+	{
+		for (const auto& binding : m_pending_block_bindings)
+			BindUniformBlock(binding.first.c_str(), binding.second);
+	}
+	m_pending_block_bindings.clear();
+
+	return m_linked;
+}
+
+bool ProgramObject::EnableParallelCompile()
+{
+	if (!GLEW_KHR_parallel_shader_compile)
+		return false;
+
+	glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	return true;
+}
+
 void ProgramObject::Clean()
 {
 	for (auto shader : m_list_shaders_attached)
@@ -115,6 +242,13 @@ bool ProgramObject::LinkProgram()
 
 	glLinkProgram(m_id);
 
+	m_pending = false;
+	m_linked = CheckLinkStatus();
+	return m_linked;
+}
+
+bool ProgramObject::CheckLinkStatus() const
+{
 	// linkeles ellenorzese
 	GLint infoLogLength = 0, result = 0;
 
@@ -133,21 +267,39 @@ bool ProgramObject::LinkProgram()
 	return true;
 }
 
+void ProgramObject::BindUniformBlock(const char* _blockName, GLuint _bindingPoint)
+{
+	// block indices are only known after linking, but asking for them now would stall a deferred build
+	if (m_pending)
+	{
+		m_pending_block_bindings.emplace_back(_blockName, _bindingPoint);
+		return;
+	}
+
+	GLuint blockIndex = glGetUniformBlockIndex(m_id, _blockName);
+	// blocks not used by any of the stages are optimized away by the linker
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(m_id, blockIndex, _bindingPoint);
+}
+
 GLint ProgramObject::GetLocation(const char * _uniform)
 {
+	Finalize();
+
 	auto loc_it = m_map_uniform_locations.find(_uniform);
 	if (loc_it == m_map_uniform_locations.end())
 	{
 		GLint my_loc = glGetUniformLocation(m_id, _uniform);
-		m_map_uniform_locations[_uniform] = my_loc;
+		m_map_uniform_locations.emplace(_uniform, my_loc);
 		return my_loc;
 	}
 	else
 		return loc_it->second;
 }
 
-void ProgramObject::Use() const
+void ProgramObject::Use()
 {
+	Finalize();
 	glUseProgram(m_id);
 }
 
@@ -4,8 +4,9 @@
 #include <GL\GL.h>
 
 #include "ShaderObject.h"
+#include "ShaderPreprocessor.h"
 
-#include <unordered_map>
+#include <map>
 #include <string>
 #include <vector>
 #include <array>
@@ -13,6 +14,8 @@
 #include <initializer_list>
 #include <utility>
 
+class ProgramBinaryCache;
+
 class ProgramObject final
 {
 public:
@@ -32,6 +35,18 @@ public:
 	operator unsigned int() const { return m_id; }
 
 	bool Init(std::initializer_list<ShaderObject>, std::initializer_list< Binding > = {}, std::initializer_list< Binding > = {});
+	// same as Init, but takes shader file names and first tries to restore the linked binary from the cache
+	bool Init(ProgramBinaryCache&, std::initializer_list<TypeSourcePair>, const ShaderDefines& = {});
+
+	// Deferred build: Submit only hands the sources to the driver, IsReady polls without stalling (where
+	// KHR_parallel_shader_compile can tell) and Finalize blocks until the link result is known. Finalize is
+	// called implicitly by the first Use, uniform location or uniform block query.
+	bool Submit(ProgramBinaryCache&, std::initializer_list<TypeSourcePair>, const ShaderDefines& = {});
+	bool IsReady();
+	bool Finalize();
+
+	// lets the driver use as many compiler threads as it likes, if KHR_parallel_shader_compile is present
+	static bool EnableParallelCompile();
 	void Clean();
 
 	ProgramObject& AttachShader(const ShaderObject&);
@@ -45,6 +60,9 @@ public:
 
 	bool LinkProgram();
 
+	// connects a uniform block of the program to an indexed uniform buffer binding point (applied at Finalize if still building)
+	void BindUniformBlock(const char* _blockName, GLuint _bindingPoint);
+
 	void SetTexture(const char* _uniform, int _sampler, GLuint _textureID);
 	void SetCubeTexture(const char* _uniform, int _sampler, GLuint _textureID);
 
@@ -53,14 +71,25 @@ public:
 
 	GLint	GetLocation(const char* _uniform);
 
-	void Use() const;
+	void Use();
 	void Unuse() const;
 private:
 	GLuint m_id;
 
-	std::unordered_map< std::string, GLint >	m_map_uniform_locations;
+	// transparent comparator, so that looking up a const char* builds no std::string
+	std::map< std::string, GLint, std::less<> >	m_map_uniform_locations;
 	std::vector< GLuint >						m_list_shaders_attached;
 
+	// state of a submitted, not yet finalized build
+	bool										m_pending{};
+	bool										m_linked{};
+	std::vector< ShaderObject >					m_pending_shaders;
+	ProgramBinaryCache*							m_pending_cache{};
+	std::string									m_pending_cache_key;
+	std::vector< std::pair<std::string, GLuint> >	m_pending_block_bindings;
+
+	bool CheckLinkStatus() const;
+
 	GLint GLResolveUniformLocation(GLint _uniform);
 	GLint GLResolveUniformLocation(const char* _uniform);
 };
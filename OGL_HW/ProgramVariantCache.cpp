@@ -0,0 +1,30 @@
+#include "ProgramVariantCache.h"
+
+void ProgramVariantCache::AddUniformBlockBinding(const char* blockName, GLuint bindingPoint)
+{
+	m_blockBindings.emplace_back(blockName, bindingPoint);
+
+	for (auto& variant : m_variants)
+		variant.second->BindUniformBlock(blockName, bindingPoint);
+}
+
+ProgramObject& ProgramVariantCache::Get(std::initializer_list<TypeSourcePair> shaderFiles, const ShaderDefines& defines)
+{
+	std::string key;
+	for (const TypeSourcePair& file : shaderFiles)
+		key += std::to_string(file.first) + ":" + file.second + "|";
+	key += ShaderPreprocessor::DefinesKey(defines);
+
+	auto it = m_variants.find(key);
+	if (it != m_variants.end())
+		return *it->second;
+
+	std::unique_ptr<ProgramObject> program = std::make_unique<ProgramObject>();
+	program->Submit(m_binaryCache, shaderFiles, defines);
+	for (const auto& binding : m_blockBindings)
+		program->BindUniformBlock(binding.first.c_str(), binding.second);
+
+	ProgramObject& result = *program;
+	m_variants.emplace(key, std::move(program));
+	return result;
+}
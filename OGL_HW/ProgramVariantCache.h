@@ -0,0 +1,36 @@
+#pragma once
+
+#include "ProgramObject.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderPreprocessor.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Keeps one ProgramObject per (shader files, define set) combination, so specialized variants of a
+	program (baked constants, feature toggles) are built once and then simply looked up. New variants
+	are submitted as deferred builds and get the registered uniform block bindings automatically.
+*/
+class ProgramVariantCache final
+{
+public:
+	explicit ProgramVariantCache(ProgramBinaryCache& binaryCache) : m_binaryCache(binaryCache) {}
+
+	ProgramVariantCache(const ProgramVariantCache&)				= delete;
+	ProgramVariantCache& operator=(const ProgramVariantCache&)	= delete;
+
+	// uniform block bindings applied to every variant, including the ones already built
+	void AddUniformBlockBinding(const char* blockName, GLuint bindingPoint);
+
+	ProgramObject& Get(std::initializer_list<TypeSourcePair> shaderFiles, const ShaderDefines& defines = {});
+
+	size_t Size() const { return m_variants.size(); }
+
+private:
+	ProgramBinaryCache&												m_binaryCache;
+	std::unordered_map<std::string, std::unique_ptr<ProgramObject>>	m_variants;
+	std::vector<std::pair<std::string, GLuint>>						m_blockBindings;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <array>
+#include <cstddef>
+
+/*
+	QueryType stands for the OpenGL query targets (https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBeginQuery.xhtml)
+*/
+enum class QueryType : GLenum
+{
+	SamplesPassed						= GL_SAMPLES_PASSED,
+	AnySamplesPassed					= GL_ANY_SAMPLES_PASSED,
+	AnySamplesPassedConservative		= GL_ANY_SAMPLES_PASSED_CONSERVATIVE,
+	PrimitivesGenerated					= GL_PRIMITIVES_GENERATED,
+	TransformFeedbackPrimitivesWritten	= GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN,
+	TimeElapsed							= GL_TIME_ELAPSED,
+	Timestamp							= GL_TIMESTAMP,
+
+	// ARB_pipeline_statistics_query (core in OpenGL 4.6)
+	VerticesSubmitted					= GL_VERTICES_SUBMITTED_ARB,
+	PrimitivesSubmitted					= GL_PRIMITIVES_SUBMITTED_ARB,
+	VertexShaderInvocations				= GL_VERTEX_SHADER_INVOCATIONS_ARB,
+	TessControlShaderPatches			= GL_TESS_CONTROL_SHADER_PATCHES_ARB,
+	TessEvaluationShaderInvocations		= GL_TESS_EVALUATION_SHADER_INVOCATIONS_ARB,
+	GeometryShaderInvocations			= GL_GEOMETRY_SHADER_INVOCATIONS,
+	GeometryShaderPrimitivesEmitted		= GL_GEOMETRY_SHADER_PRIMITIVES_EMITTED_ARB,
+	FragmentShaderInvocations			= GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+	ComputeShaderInvocations			= GL_COMPUTE_SHADER_INVOCATIONS_ARB,
+	ClippingInputPrimitives				= GL_CLIPPING_INPUT_PRIMITIVES_ARB,
+	ClippingOutputPrimitives			= GL_CLIPPING_OUTPUT_PRIMITIVES_ARB
+};
+
+template <QueryType type>
+class QueryObject final
+{
+public:
+	QueryObject();
+	~QueryObject();
+
+	QueryObject(const QueryObject&) = delete;
+	QueryObject& operator=(const QueryObject&) = delete;
+
+	QueryObject(QueryObject&& rhs);
+	QueryObject& operator=(QueryObject&& rhs);
+
+	operator unsigned int() const { return m_id; }
+
+	void Begin();
+	void End();
+	// records the GPU time once all previous commands have finished (Timestamp queries only)
+	void Timestamp();
+
+	bool IsResultAvailable() const;
+	// blocks until the result arrives
+	GLuint64 GetResult() const;
+
+	void Clean();
+
+private:
+	GLuint m_id{};
+};
+
+/*
+	N queries used round robin, one per frame. The result read back is from the oldest query, issued N-1
+	frames earlier, which has normally arrived by then, so reading it never stalls the pipeline.
+*/
+template <QueryType type, size_t N = 3>
+class QueryRing final
+{
+public:
+	void Begin();
+	void End();
+
+	// the most recent result that has arrived, or false if there is none yet
+	bool TryGetResult(GLuint64& result);
+
+	GLuint64 LastResult() const { return m_lastResult; }
+
+private:
+	std::array<QueryObject<type>, N>	m_queries;
+	std::array<bool, N>					m_issued{};
+	size_t								m_current{};
+	GLuint64							m_lastResult{};
+};
+
+#include "QueryObject.inl"
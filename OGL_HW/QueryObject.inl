@@ -0,0 +1,117 @@
+#include "QueryObject.h"
+
+template<QueryType type>
+inline QueryObject<type>::QueryObject()
+{
+	glGenQueries(1, &m_id);
+}
+
+template<QueryType type>
+inline QueryObject<type>::~QueryObject()
+{
+	Clean();
+}
+
+template<QueryType type>
+inline QueryObject<type>::QueryObject(QueryObject && rhs)
+{
+	if (&rhs == this)
+		return;
+
+	m_id = rhs.m_id;
+	rhs.m_id = 0;
+}
+
+template<QueryType type>
+inline QueryObject<type> & QueryObject<type>::operator=(QueryObject && rhs)
+{
+	if (&rhs == this)
+		return *this;
+
+	Clean();
+
+	m_id = rhs.m_id;
+	rhs.m_id = 0;
+
+	return *this;
+}
+
+template<QueryType type>
+inline void QueryObject<type>::Clean()
+{
+	if (m_id != 0)
+	{
+		glDeleteQueries(1, &m_id);
+		m_id = 0;
+	}
+}
+
+template<QueryType type>
+inline void QueryObject<type>::Begin()
+{
+	static_assert(type != QueryType::Timestamp, "Timestamp queries are recorded with Timestamp(), not with Begin()/End().");
+	glBeginQuery(static_cast<GLenum>(type), m_id);
+}
+
+template<QueryType type>
+inline void QueryObject<type>::End()
+{
+	static_assert(type != QueryType::Timestamp, "Timestamp queries are recorded with Timestamp(), not with Begin()/End().");
+	glEndQuery(static_cast<GLenum>(type));
+}
+
+template<QueryType type>
+inline void QueryObject<type>::Timestamp()
+{
+	static_assert(type == QueryType::Timestamp, "Only Timestamp queries can record a timestamp.");
+	glQueryCounter(m_id, GL_TIMESTAMP);
+}
+
+template<QueryType type>
+inline bool QueryObject<type>::IsResultAvailable() const
+{
+	GLint available = GL_FALSE;
+	glGetQueryObjectiv(m_id, GL_QUERY_RESULT_AVAILABLE, &available);
+	return available == GL_TRUE;
+}
+
+template<QueryType type>
+inline GLuint64 QueryObject<type>::GetResult() const
+{
+	GLuint64 result = 0;
+	glGetQueryObjectui64v(m_id, GL_QUERY_RESULT, &result);
+	return result;
+}
+
+template<QueryType type, size_t N>
+inline void QueryRing<type, N>::Begin()
+{
+	m_queries[m_current].Begin();
+}
+
+template<QueryType type, size_t N>
+inline void QueryRing<type, N>::End()
+{
+	m_queries[m_current].End();
+	m_issued[m_current] = true;
+	m_current = (m_current + 1) % N;
+}
+
+template<QueryType type, size_t N>
+inline bool QueryRing<type, N>::TryGetResult(GLuint64& result)
+{
+	// walk from the newest to the oldest issued query, the first one that has arrived is the freshest result
+	bool found = false;
+	for (size_t age = 1; age <= N && !found; ++age)
+	{
+		size_t index = (m_current + N - age) % N;
+		if (m_issued[index] && m_queries[index].IsResultAvailable())
+		{
+			m_lastResult = m_queries[index].GetResult();
+			found = true;
+		}
+	}
+
+	result = m_lastResult;
+	return found;
+}
@@ -0,0 +1,830 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include <imgui/imgui.h>
+
+#include "CpuProfiler.h"
+#include "GpuProfiler.h"
+#include "GpuResources.h"
+#include "PipelineStatistics.h"
+
+namespace
+{
+	const size_t NONE = std::numeric_limits<size_t>::max();
+
+	enum class ClearType
+	{
+		Float,
+		Unsigned,
+		Signed,
+		Depth,
+		DepthStencil,
+	};
+
+	ClearType ClearTypeOf(GLenum internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_R8UI:
+		case GL_R16UI:
+		case GL_R32UI:
+		case GL_RG8UI:
+		case GL_RG16UI:
+		case GL_RG32UI:
+		case GL_RGBA8UI:
+		case GL_RGBA16UI:
+		case GL_RGBA32UI:			return ClearType::Unsigned;
+		case GL_R8I:
+		case GL_R16I:
+		case GL_R32I:
+		case GL_RG8I:
+		case GL_RG16I:
+		case GL_RG32I:
+		case GL_RGBA8I:
+		case GL_RGBA16I:
+		case GL_RGBA32I:			return ClearType::Signed;
+		case GL_DEPTH_COMPONENT16:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32:
+		case GL_DEPTH_COMPONENT32F:	return ClearType::Depth;
+		case GL_DEPTH24_STENCIL8:
+		case GL_DEPTH32F_STENCIL8:	return ClearType::DepthStencil;
+		default:					return ClearType::Float;
+		}
+	}
+
+	std::string AttachmentName(GLenum attachment)
+	{
+		switch (attachment)
+		{
+		case GL_DEPTH_ATTACHMENT:			return "DEPTH";
+		case GL_STENCIL_ATTACHMENT:			return "STENCIL";
+		case GL_DEPTH_STENCIL_ATTACHMENT:	return "DEPTH_STENCIL";
+		default:							return "COLOR" + std::to_string(attachment - GL_COLOR_ATTACHMENT0);
+		}
+	}
+
+	const char* DepthFuncName(GLenum func)
+	{
+		switch (func)
+		{
+		case GL_NEVER:		return "NEVER";
+		case GL_LESS:		return "LESS";
+		case GL_EQUAL:		return "EQUAL";
+		case GL_LEQUAL:		return "LEQUAL";
+		case GL_GREATER:	return "GREATER";
+		case GL_NOTEQUAL:	return "NOTEQUAL";
+		case GL_GEQUAL:		return "GEQUAL";
+		default:			return "ALWAYS";
+		}
+	}
+
+	bool IsAttached(GLenum attachment)
+	{
+		return attachment != GL_NONE;
+	}
+}
+
+bool RenderGraph::RenderState::operator==(const RenderState& other) const
+{
+	return depthTest == other.depthTest && depthWrite == other.depthWrite && depthFunc == other.depthFunc
+		&& colorWrite == other.colorWrite && blend == other.blend;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Condition(std::function<bool()> condition)
+{
+	m_graph.m_passes[m_pass].condition = std::move(condition);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::State(const RenderState& state)
+{
+	m_graph.m_passes[m_pass].state = state;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SideEffect()
+{
+	m_graph.m_passes[m_pass].sideEffect = true;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Sample(Resource resource)
+{
+	m_graph.m_passes[m_pass].uses.push_back({ resource, Access::Sample, GL_NONE, Load::Keep });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Image(Resource resource)
+{
+	m_graph.m_passes[m_pass].uses.push_back({ resource, Access::Image, GL_NONE, Load::Keep });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(Resource resource, GLenum attachment, Load load)
+{
+	m_graph.m_passes[m_pass].uses.push_back({ resource, Access::Write, attachment, load });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(Resource resource, GLenum attachment)
+{
+	m_graph.m_passes[m_pass].uses.push_back({ resource, Access::Read, attachment, Load::Keep });
+	return *this;
+}
+
+RenderGraph::RenderGraph(RenderTargetPool& pool) : m_pool(pool), m_boundFramebuffer(NONE)
+{
+	m_invalidateSupported = GLEW_ARB_invalidate_subdata != GL_FALSE;
+
+	Target backbuffer{};
+	backbuffer.name = "Backbuffer";
+	m_targets.push_back(backbuffer);
+
+	FramebufferObject framebuffer{};
+	framebuffer.owner = "Backbuffer";
+	framebuffer.attached = true;
+	m_framebuffers.push_back(framebuffer);
+}
+
+RenderGraph::~RenderGraph()
+{
+	Clean();
+}
+
+RenderGraph::Resource RenderGraph::CreateTarget(const RenderTargetPool::Target& desc)
+{
+	Target target{};
+	target.name = desc.owner;
+	target.desc = desc;
+	target.transient = true;
+	m_targets.push_back(target);
+	m_dirty = true;
+	return m_targets.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::Import(const std::string& name, GLuint& texture, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	Target target{};
+	target.name = name;
+	target.desc.internalFormat = internalFormat;
+	target.object = &texture;
+	target.width = width;
+	target.height = height;
+	m_targets.push_back(target);
+	m_dirty = true;
+	return m_targets.size() - 1;
+}
+
+void RenderGraph::Export(Resource resource)
+{
+	m_targets[resource].exported = true;
+	m_dirty = true;
+}
+
+RenderGraph::PassBuilder RenderGraph::AddPass(const char* name, std::function<void()> execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = std::move(execute);
+	m_passes.push_back(std::move(pass));
+	m_dirty = true;
+	return PassBuilder(*this, m_passes.size() - 1);
+}
+
+void RenderGraph::SetProfilers(GpuProfiler* profiler, PipelineStatistics* statistics)
+{
+	m_profiler = profiler;
+	m_statistics = statistics;
+}
+
+void RenderGraph::SetBackbufferSize(int width, int height)
+{
+	m_backbufferWidth = width;
+	m_backbufferHeight = height;
+}
+
+void RenderGraph::Reattach()
+{
+	for (FramebufferObject& framebuffer : m_framebuffers)
+		framebuffer.attached = framebuffer.name == 0;
+}
+
+bool RenderGraph::Overwrites(const Pass& pass, Resource resource) const
+{
+	for (const Use& use : pass.uses)
+		if (use.resource == resource && (use.access != Access::Write || use.load == Load::Keep))
+			return false;
+	return true;
+}
+
+size_t RenderGraph::StateChanges(const Pass& from, const Pass& to) const
+{
+	size_t changes = from.state.depthTest != to.state.depthTest;
+	changes += from.state.depthWrite != to.state.depthWrite;
+	changes += from.state.depthFunc != to.state.depthFunc;
+	changes += from.state.colorWrite != to.state.colorWrite;
+	changes += from.state.blend != to.state.blend;
+
+	// a different set of attachments is another framebuffer, more than any state
+	auto attachments = [](const Pass& pass, std::vector<std::pair<GLenum, Resource>>& out)
+	{
+		out.clear();
+		for (const Use& use : pass.uses)
+			if (IsAttached(use.attachment))
+				out.emplace_back(use.attachment, use.resource);
+		std::sort(out.begin(), out.end());
+	};
+	std::vector<std::pair<GLenum, Resource>> fromAttachments;
+	std::vector<std::pair<GLenum, Resource>> toAttachments;
+	attachments(from, fromAttachments);
+	attachments(to, toAttachments);
+	if (fromAttachments != toAttachments)
+		changes += 100;
+	return changes;
+}
+
+void RenderGraph::Compile()
+{
+	CPU_ZONE("RenderGraph::Compile");
+	m_enabled = m_conditions;
+	m_dirty = false;
+	++m_compilations;
+
+	// Culling, backwards: a pass runs if it has a side effect or writes a target still needed after it.
+	// Imported and exported targets are always needed; a transient one no longer is before a pass that
+	// overwrites all of it
+	std::vector<char> needed(m_targets.size());
+	for (size_t resource = 0; resource < m_targets.size(); ++resource)
+		needed[resource] = !m_targets[resource].transient || m_targets[resource].exported;
+
+	std::vector<char> alive(m_passes.size(), 0);
+	m_culled.clear();
+	for (size_t index = m_passes.size(); index-- > 0;)
+	{
+		const Pass& pass = m_passes[index];
+		if (!m_enabled[index])
+			continue;
+
+		bool runs = pass.sideEffect;
+		for (const Use& use : pass.uses)
+			runs = runs || ((use.access == Access::Write || use.access == Access::Image) && needed[use.resource]);
+		if (!runs)
+		{
+			m_culled.push_back(index);
+			continue;
+		}
+		alive[index] = 1;
+
+		for (const Use& use : pass.uses)
+			if (IsTransient(use.resource) && !m_targets[use.resource].exported && Overwrites(pass, use.resource))
+				needed[use.resource] = 0;
+		for (const Use& use : pass.uses)
+			if (!Overwrites(pass, use.resource))
+				needed[use.resource] = 1;
+	}
+	std::reverse(m_culled.begin(), m_culled.end());
+
+	// Dependencies in the order the passes were added: a read waits for the write before it, a write for
+	// both the write and the reads before it
+	std::vector<std::vector<size_t>> dependents(m_passes.size());
+	std::vector<size_t> waitingFor(m_passes.size(), 0);
+	std::vector<size_t> lastWriter(m_targets.size(), NONE);
+	std::vector<std::vector<size_t>> readers(m_targets.size());
+	auto depend = [&](size_t before, size_t after)
+	{
+		if (before != NONE && before != after)
+		{
+			dependents[before].push_back(after);
+			++waitingFor[after];
+		}
+	};
+	for (size_t index = 0; index < m_passes.size(); ++index)
+	{
+		if (!alive[index])
+			continue;
+		for (const Use& use : m_passes[index].uses)
+		{
+			bool writes = use.access == Access::Write || use.access == Access::Image;
+			depend(lastWriter[use.resource], index);
+			if (writes)
+			{
+				for (size_t reader : readers[use.resource])
+					depend(reader, index);
+				readers[use.resource].clear();
+				lastWriter[use.resource] = index;
+			}
+			else
+				readers[use.resource].push_back(index);
+		}
+	}
+
+	// Scheduling: of the passes whose dependencies have run, the one closest to the last in state, then the
+	// one added first
+	m_schedule.clear();
+	std::vector<size_t> ready;
+	for (size_t index = 0; index < m_passes.size(); ++index)
+		if (alive[index] && waitingFor[index] == 0)
+			ready.push_back(index);
+	while (!ready.empty())
+	{
+		auto next = ready.begin();
+		if (!m_schedule.empty())
+		{
+			const Pass& last = m_passes[m_schedule.back()];
+			size_t fewest = NONE;
+			for (auto it = ready.begin(); it != ready.end(); ++it)
+			{
+				size_t changes = StateChanges(last, m_passes[*it]);
+				if (changes < fewest || (changes == fewest && *it < *next))
+				{
+					fewest = changes;
+					next = it;
+				}
+			}
+		}
+		else
+			next = std::min_element(ready.begin(), ready.end());
+
+		size_t index = *next;
+		ready.erase(next);
+		m_schedule.push_back(index);
+		for (size_t dependent : dependents[index])
+			if (--waitingFor[dependent] == 0)
+				ready.push_back(dependent);
+	}
+
+	// Lifetimes, in schedule positions; an exported target lives to the end
+	for (Target& target : m_targets)
+	{
+		target.first = NONE;
+		target.last = 0;
+		target.slot = NONE;
+		if (target.transient)
+			target.object = nullptr;
+	}
+	for (size_t position = 0; position < m_schedule.size(); ++position)
+	{
+		for (const Use& use : m_passes[m_schedule[position]].uses)
+		{
+			Target& target = m_targets[use.resource];
+			target.first = std::min(target.first, position);
+			target.last = std::max(target.last, target.exported ? m_schedule.size() : position);
+		}
+	}
+
+	// Aliasing: in the order they are first used, transient targets take a free slot of the same format,
+	// and the pool only gets a new one when none is free
+	for (Slot& slot : m_slots)
+		slot.busyUntil = NONE;
+	for (size_t position = 0; position < m_schedule.size(); ++position)
+	{
+		for (const Use& use : m_passes[m_schedule[position]].uses)
+		{
+			Target& target = m_targets[use.resource];
+			if (!target.transient || target.first != position || target.slot != NONE)
+				continue;
+
+			for (size_t slot = 0; slot < m_slots.size() && target.slot == NONE; ++slot)
+			{
+				const RenderTargetPool::Target& desc = m_slots[slot].desc;
+				bool free = m_slots[slot].busyUntil == NONE || m_slots[slot].busyUntil < position;
+				if (free && desc.internalFormat == target.desc.internalFormat && desc.renderbuffer == target.desc.renderbuffer
+					&& desc.filter == target.desc.filter)
+					target.slot = slot;
+			}
+			if (target.slot == NONE)
+			{
+				Slot slot;
+				slot.desc = target.desc;
+				slot.desc.owner = "Render graph slot " + std::to_string(m_slots.size());
+				m_slots.push_back(slot);
+				m_pool.Add(m_slots.back().name, m_slots.back().desc);
+				target.slot = m_slots.size() - 1;
+			}
+			m_slots[target.slot].busyUntil = target.last;
+			target.object = &m_slots[target.slot].name;
+		}
+	}
+
+	// Framebuffers, memory barriers after image writes, and invalidation where a target's lifetime ends
+	std::vector<char> imageWritten(m_targets.size(), 0);
+	for (size_t position = 0; position < m_schedule.size(); ++position)
+	{
+		Pass& pass = m_passes[m_schedule[position]];
+		pass.framebuffer = FindFramebuffer(pass);
+		pass.barriers = 0;
+		pass.invalidateBefore.clear();
+		pass.invalidateAfter.clear();
+		pass.invalidateTextures.clear();
+
+		for (const Use& use : pass.uses)
+		{
+			if (imageWritten[use.resource])
+			{
+				pass.barriers |= use.access == Access::Sample ? GL_TEXTURE_FETCH_BARRIER_BIT
+					: (use.access == Access::Image ? GL_SHADER_IMAGE_ACCESS_BARRIER_BIT : GL_FRAMEBUFFER_BARRIER_BIT);
+				imageWritten[use.resource] = 0;
+			}
+		}
+		for (const Use& use : pass.uses)
+			if (use.access == Access::Image)
+				imageWritten[use.resource] = 1;
+
+		if (!m_invalidateSupported)
+			continue;
+		for (const Use& use : pass.uses)
+		{
+			const Target& target = m_targets[use.resource];
+			if (use.access == Access::Write && use.load == Load::DontCare && use.resource != BACKBUFFER)
+				pass.invalidateBefore.push_back(use.attachment);
+			if (!target.transient || target.exported || target.last != position)
+				continue;
+
+			// once per target: through the framebuffer if it is attached, otherwise the texture itself
+			bool attached = false;
+			bool seen = false;
+			for (const Use& other : pass.uses)
+			{
+				if (other.resource != use.resource)
+					continue;
+				attached = attached || IsAttached(other.attachment);
+				seen = seen || (&other < &use);
+			}
+			if (seen)
+				continue;
+			if (attached)
+			{
+				for (const Use& other : pass.uses)
+					if (other.resource == use.resource && IsAttached(other.attachment))
+						pass.invalidateAfter.push_back(other.attachment);
+			}
+			else if (!target.desc.renderbuffer)
+				pass.invalidateTextures.push_back(target.object);
+		}
+	}
+}
+
+size_t RenderGraph::FindFramebuffer(const Pass& pass)
+{
+	FramebufferObject wanted{};
+	wanted.owner = pass.name;
+	for (const Use& use : pass.uses)
+	{
+		if (!IsAttached(use.attachment))
+			continue;
+		if (use.resource == BACKBUFFER)
+			return 0;
+
+		const Target& target = m_targets[use.resource];
+		wanted.attachments.push_back({ use.attachment, target.object, target.desc.renderbuffer });
+		if (wanted.attachments.size() == 1)
+		{
+			wanted.windowSized = target.transient;
+			wanted.width = target.width;
+			wanted.height = target.height;
+		}
+
+		// only what the pass renders to is drawn to, images attached to be cleared are not
+		bool image = false;
+		for (const Use& other : pass.uses)
+			image = image || (other.resource == use.resource && other.access == Access::Image);
+		if (use.access == Access::Write && !image && use.attachment >= GL_COLOR_ATTACHMENT0 && use.attachment <= GL_COLOR_ATTACHMENT15)
+			wanted.drawBuffers.push_back(use.attachment);
+	}
+	if (wanted.attachments.empty())
+		return NONE;
+
+	std::sort(wanted.attachments.begin(), wanted.attachments.end(), [](const Attachment& a, const Attachment& b) { return a.point < b.point; });
+	std::sort(wanted.drawBuffers.begin(), wanted.drawBuffers.end());
+	for (size_t index = 1; index < m_framebuffers.size(); ++index)
+		if (m_framebuffers[index].attachments == wanted.attachments && m_framebuffers[index].drawBuffers == wanted.drawBuffers)
+			return index;
+
+	wanted.name = GpuResources::CreateFramebuffer(std::string("Render graph: ") + pass.name);
+	m_framebuffers.push_back(wanted);
+	return m_framebuffers.size() - 1;
+}
+
+void RenderGraph::Bind(size_t index)
+{
+	FramebufferObject& framebuffer = m_framebuffers[index];
+	if (index != m_boundFramebuffer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.name);
+		m_boundFramebuffer = index;
+	}
+
+	if (!framebuffer.attached)
+	{
+		bool color = false;
+		for (const Attachment& attachment : framebuffer.attachments)
+		{
+			if (attachment.renderbuffer)
+				glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment.point, GL_RENDERBUFFER, *attachment.object);
+			else
+				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment.point, GL_TEXTURE_2D, *attachment.object, 0);
+			color = color || (attachment.point >= GL_COLOR_ATTACHMENT0 && attachment.point <= GL_COLOR_ATTACHMENT15);
+		}
+		if (framebuffer.drawBuffers.empty())
+			glDrawBuffer(GL_NONE);
+		else
+			glDrawBuffers(static_cast<GLsizei>(framebuffer.drawBuffers.size()), framebuffer.drawBuffers.data());
+		if (!color)
+			glReadBuffer(GL_NONE);
+
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+			std::cerr << "[RenderGraph] The framebuffer of " << framebuffer.owner << " is incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+		framebuffer.attached = true;
+	}
+
+	int width = framebuffer.width;
+	int height = framebuffer.height;
+	if (index == 0)
+	{
+		width = m_backbufferWidth;
+		height = m_backbufferHeight;
+	}
+	else if (framebuffer.windowSized)
+	{
+		width = m_pool.ViewportWidth();
+		height = m_pool.ViewportHeight();
+	}
+	if (width != m_viewportWidth || height != m_viewportHeight)
+	{
+		glViewport(0, 0, width, height);
+		m_viewportWidth = width;
+		m_viewportHeight = height;
+	}
+}
+
+void RenderGraph::ApplyState(const RenderState& state)
+{
+	if (!m_stateKnown || state.depthTest != m_state.depthTest)
+	{
+		if (state.depthTest)
+			glEnable(GL_DEPTH_TEST);
+		else
+			glDisable(GL_DEPTH_TEST);
+	}
+	if (!m_stateKnown || state.depthWrite != m_state.depthWrite)
+		glDepthMask(state.depthWrite ? GL_TRUE : GL_FALSE);
+	if (!m_stateKnown || state.depthFunc != m_state.depthFunc)
+		glDepthFunc(state.depthFunc);
+	if (!m_stateKnown || state.colorWrite != m_state.colorWrite)
+	{
+		GLboolean write = state.colorWrite ? GL_TRUE : GL_FALSE;
+		glColorMask(write, write, write, write);
+	}
+	if (!m_stateKnown || state.blend != m_state.blend)
+	{
+		if (state.blend)
+		{
+			glEnable(GL_BLEND);
+			glBlendEquation(GL_FUNC_ADD);
+			glBlendFunc(GL_ONE, GL_ONE);
+		}
+		else
+			glDisable(GL_BLEND);
+	}
+	m_state = state;
+	m_stateKnown = true;
+}
+
+void RenderGraph::Clear(const Pass& pass)
+{
+	const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const GLuint zero[4] = { 0, 0, 0, 0 };
+	const GLint signedZero[4] = { 0, 0, 0, 0 };
+	const GLfloat one = 1.0f;
+
+	bool masked = false;
+	const FramebufferObject& framebuffer = m_framebuffers[pass.framebuffer];
+	for (const Use& use : pass.uses)
+	{
+		if (use.access != Access::Write || use.load != Load::Clear)
+			continue;
+
+		// clears obey the write masks
+		if (!masked)
+		{
+			RenderState unmasked = m_stateKnown ? m_state : pass.state;
+			unmasked.depthWrite = true;
+			unmasked.colorWrite = true;
+			ApplyState(unmasked);
+			masked = true;
+		}
+
+		if (use.resource == BACKBUFFER)
+		{
+			glClearBufferfv(GL_COLOR, 0, black);
+			glClearBufferfv(GL_DEPTH, 0, &one);
+			continue;
+		}
+
+		ClearType type = ClearTypeOf(m_targets[use.resource].desc.internalFormat);
+		if (type == ClearType::Depth)
+		{
+			glClearBufferfv(GL_DEPTH, 0, &one);
+			continue;
+		}
+		if (type == ClearType::DepthStencil)
+		{
+			glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+			continue;
+		}
+
+		// a colour attachment that is not drawn to is made draw buffer 0 for the clear only
+		auto drawBuffer = std::find(framebuffer.drawBuffers.begin(), framebuffer.drawBuffers.end(), use.attachment);
+		GLint index = static_cast<GLint>(drawBuffer - framebuffer.drawBuffers.begin());
+		if (drawBuffer == framebuffer.drawBuffers.end())
+		{
+			glDrawBuffer(use.attachment);
+			index = 0;
+		}
+
+		if (type == ClearType::Unsigned)
+			glClearBufferuiv(GL_COLOR, index, zero);
+		else if (type == ClearType::Signed)
+			glClearBufferiv(GL_COLOR, index, signedZero);
+		else
+			glClearBufferfv(GL_COLOR, index, black);
+
+		if (drawBuffer == framebuffer.drawBuffers.end())
+		{
+			if (framebuffer.drawBuffers.empty())
+				glDrawBuffer(GL_NONE);
+			else
+				glDrawBuffers(static_cast<GLsizei>(framebuffer.drawBuffers.size()), framebuffer.drawBuffers.data());
+		}
+	}
+}
+
+void RenderGraph::Execute()
+{
+	CPU_ZONE("RenderGraph::Execute");
+
+	m_conditions.resize(m_passes.size());
+	for (size_t index = 0; index < m_passes.size(); ++index)
+		m_conditions[index] = !m_passes[index].condition || m_passes[index].condition();
+	if (m_dirty || m_conditions != m_enabled)
+		Compile();
+
+	// anything may have changed the state since the last frame
+	m_boundFramebuffer = NONE;
+	m_stateKnown = false;
+	m_viewportWidth = 0;
+	m_viewportHeight = 0;
+
+	for (size_t index : m_schedule)
+	{
+		Pass& pass = m_passes[index];
+		CPU_ZONE("RenderGraph pass", pass.name);
+
+		if (pass.barriers != 0)
+			glMemoryBarrier(pass.barriers);
+		if (pass.framebuffer != NONE)
+		{
+			Bind(pass.framebuffer);
+			if (!pass.invalidateBefore.empty())
+				glInvalidateFramebuffer(GL_FRAMEBUFFER, static_cast<GLsizei>(pass.invalidateBefore.size()), pass.invalidateBefore.data());
+			Clear(pass);
+		}
+		ApplyState(pass.state);
+
+		if (m_profiler)
+			m_profiler->BeginSection(pass.name);
+		if (m_statistics)
+			m_statistics->BeginPass(pass.name);
+		pass.execute();
+		if (m_statistics)
+			m_statistics->EndPass();
+		if (m_profiler)
+			m_profiler->EndSection();
+
+		if (!pass.invalidateAfter.empty())
+			glInvalidateFramebuffer(GL_FRAMEBUFFER, static_cast<GLsizei>(pass.invalidateAfter.size()), pass.invalidateAfter.data());
+		for (GLuint* texture : pass.invalidateTextures)
+			glInvalidateTexImage(*texture, 0);
+	}
+
+	// what comes after the graph, like ImGui, draws to the window
+	if (m_boundFramebuffer != 0)
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_backbufferWidth, m_backbufferHeight);
+	m_boundFramebuffer = NONE;
+}
+
+GLuint RenderGraph::Name(Resource resource) const
+{
+	const GLuint* object = m_targets[resource].object;
+	return object ? *object : 0;
+}
+
+GLuint RenderGraph::Framebuffer() const
+{
+	return m_boundFramebuffer != NONE ? m_framebuffers[m_boundFramebuffer].name : 0;
+}
+
+void RenderGraph::Dump(std::ostream& out) const
+{
+	static const char* const ACCESS_NAMES[] = { "samples", "image", "writes", "reads" };
+	static const char* const LOAD_NAMES[] = { "", ", clear", ", don't care" };
+
+	out << "Render graph (compiled " << m_compilations << " times): " << m_schedule.size() << " of " << m_passes.size()
+		<< " passes run, " << m_culled.size() << " culled\n";
+	for (size_t position = 0; position < m_schedule.size(); ++position)
+	{
+		const Pass& pass = m_passes[m_schedule[position]];
+		const RenderState& state = pass.state;
+		out << "  " << std::setw(2) << position << " " << pass.name << "\n";
+		out << "       framebuffer " << (pass.framebuffer == NONE ? std::string("-") : std::to_string(pass.framebuffer))
+			<< ", depth " << (state.depthTest ? DepthFuncName(state.depthFunc) : "off") << (state.depthWrite ? " write" : "")
+			<< ", colour " << (state.colorWrite ? "write" : "off") << (state.blend ? ", additive" : "") << "\n";
+		for (const Use& use : pass.uses)
+		{
+			out << "       " << ACCESS_NAMES[static_cast<size_t>(use.access)] << " " << m_targets[use.resource].name;
+			if (IsAttached(use.attachment) && use.resource != BACKBUFFER)
+				out << " (" << AttachmentName(use.attachment) << LOAD_NAMES[static_cast<size_t>(use.load)] << ")";
+			else if (use.load == Load::Clear)
+				out << " (clear)";
+			out << "\n";
+		}
+		if (pass.barriers != 0)
+			out << "       memory barrier 0x" << std::hex << pass.barriers << std::dec << " first\n";
+		for (GLenum attachment : pass.invalidateBefore)
+			out << "       invalidates " << AttachmentName(attachment) << " first\n";
+		for (GLenum attachment : pass.invalidateAfter)
+			out << "       invalidates " << AttachmentName(attachment) << " after\n";
+		for (const GLuint* texture : pass.invalidateTextures)
+			for (const Target& target : m_targets)
+				if (target.object == texture && target.last == position)
+					out << "       invalidates " << target.name << " after\n";
+	}
+	for (size_t index : m_culled)
+		out << "  culled: " << m_passes[index].name << "\n";
+
+	out << "Transient targets (" << m_slots.size() << " textures and renderbuffers of " << m_pool.AllocatedWidth() << "x"
+		<< m_pool.AllocatedHeight() << "):\n";
+	for (const Target& target : m_targets)
+	{
+		if (!target.transient)
+			continue;
+		out << "  " << std::left << std::setw(24) << target.name << std::setw(14) << GpuResources::FormatName(target.desc.internalFormat) << std::right;
+		if (target.slot == NONE)
+			out << "unused\n";
+		else
+			out << "passes " << target.first << "-" << (target.exported ? std::string("end") : std::to_string(target.last))
+				<< ", slot " << target.slot << "\n";
+	}
+}
+
+void RenderGraph::ShowWindow(const char* title)
+{
+	if (ImGui::Begin(title))
+	{
+		ImGui::Text("%d passes run, %d culled, %d slots, compiled %d times", static_cast<int>(m_schedule.size()), static_cast<int>(m_culled.size()),
+					static_cast<int>(m_slots.size()), static_cast<int>(m_compilations));
+		for (size_t position = 0; position < m_schedule.size(); ++position)
+		{
+			const Pass& pass = m_passes[m_schedule[position]];
+			ImGui::Text("%2d %s", static_cast<int>(position), pass.name);
+		}
+		ImGui::Separator();
+		for (const Target& target : m_targets)
+		{
+			if (target.transient && target.slot != NONE)
+				ImGui::Text("%s: slot %d", target.name.c_str(), static_cast<int>(target.slot));
+		}
+
+		if (ImGui::Button("Dump to console"))
+			Dump(std::cout);
+	}
+	ImGui::End();
+}
+
+void RenderGraph::Clean()
+{
+	for (Slot& slot : m_slots)
+		m_pool.Remove(slot.name);
+	m_slots.clear();
+	for (Target& target : m_targets)
+	{
+		if (target.transient)
+			target.object = nullptr;
+	}
+
+	for (FramebufferObject& framebuffer : m_framebuffers)
+	{
+		GpuResources::DeleteFramebuffer(framebuffer.name);
+		framebuffer.attached = false;
+	}
+	m_framebuffers.resize(1);
+	m_framebuffers[0].attached = true;
+	m_dirty = true;
+}
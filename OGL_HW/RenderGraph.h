@@ -0,0 +1,234 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "RenderTargetPool.h"
+
+class GpuProfiler;
+class PipelineStatistics;
+
+/*
+	The passes of a frame and the targets they use. A pass declares what it samples, renders to and accesses
+	as an image, the depth and blend state it draws with and a condition; the graph binds its framebuffer,
+	sets the viewport and the state, clears the attachments that ask for it and times it, then calls it.
+
+	Compile, which runs again whenever a condition changes, keeps the enabled passes that lead to something
+	visible: an imported or exported target, or a pass marked as a side effect. They are ordered by their
+	dependencies, in the order they were added unless a pass with the same framebuffer and fewer state
+	changes is ready too. Attachments are invalidated once they are no longer needed, and transient targets
+	whose lifetimes do not overlap share one texture or renderbuffer of the pool.
+
+	Transient targets are window sized and only live within a frame; export those read after Execute.
+	Imported targets, like the shadow map, are owned by the caller and never invalidated or shared.
+	Passes must leave the tracked state (framebuffer, viewport, depth, blend and colour writes) as they got it.
+*/
+class RenderGraph final
+{
+public:
+	using Resource = size_t;
+
+	// the default framebuffer, attached alone
+	static const Resource BACKBUFFER = 0;
+
+	// what happens to an attachment's content when the pass starts
+	enum class Load
+	{
+		Keep,
+		Clear,		// to black, 1 for depth and 0 for integer formats
+		DontCare,	// invalidated, the pass overwrites all of it
+	};
+
+	struct RenderState
+	{
+		bool	depthTest	= true;
+		bool	depthWrite	= true;
+		GLenum	depthFunc	= GL_LESS;
+		bool	colorWrite	= true;
+		// additive when enabled
+		bool	blend		= false;
+
+		bool operator==(const RenderState& other) const;
+		bool operator!=(const RenderState& other) const { return !(*this == other); }
+	};
+
+	class PassBuilder final
+	{
+	public:
+		PassBuilder(RenderGraph& graph, size_t pass) : m_graph(graph), m_pass(pass) {}
+
+		// evaluated every frame; a disabled pass is left out as if it had not been added
+		PassBuilder& Condition(std::function<bool()> condition);
+		PassBuilder& State(const RenderState& state);
+		// kept even if nothing reads what it writes
+		PassBuilder& SideEffect();
+
+		PassBuilder& Sample(Resource resource);
+		// read and written through image load/store; bound by the pass itself
+		PassBuilder& Image(Resource resource);
+		// rendered to; a target that is an image of the same pass too is only attached to be cleared
+		PassBuilder& Write(Resource resource, GLenum attachment, Load load = Load::Keep);
+		// attached, but only read, for glReadPixels and blits
+		PassBuilder& Read(Resource resource, GLenum attachment);
+
+	private:
+		RenderGraph&	m_graph;
+		size_t			m_pass;
+	};
+
+	explicit RenderGraph(RenderTargetPool& pool);
+	~RenderGraph();
+
+	RenderGraph(const RenderGraph&)				= delete;
+	RenderGraph& operator=(const RenderGraph&)	= delete;
+
+	// transient, window sized target; desc.owner is only the name in listings
+	Resource CreateTarget(const RenderTargetPool::Target& desc);
+	// texture owned by the caller, read through the variable whenever it is attached
+	Resource Import(const std::string& name, GLuint& texture, GLenum internalFormat, GLsizei width, GLsizei height);
+	// kept until the end of the frame for readers outside the graph, like ImGui
+	void Export(Resource resource);
+
+	// execute is called with the pass' framebuffer bound and its state set
+	PassBuilder AddPass(const char* name, std::function<void()> execute);
+
+	// every pass is put into a section of the profiler and of the statistics
+	void SetProfilers(GpuProfiler* profiler, PipelineStatistics* statistics);
+	void SetBackbufferSize(int width, int height);
+	// after the pool reallocated the targets
+	void Reattach();
+
+	// compiles if a condition has changed, then runs the passes
+	void Execute();
+
+	// GL name of the texture or renderbuffer behind a target in the current schedule, 0 if it is not used
+	GLuint Name(Resource resource) const;
+	// the framebuffer of the running pass
+	GLuint Framebuffer() const;
+
+	// passes in the order they run with their framebuffers, states and invalidations, then the targets'
+	// lifetimes and what they share
+	void Dump(std::ostream& out) const;
+	void ShowWindow(const char* title);
+
+	void Clean();
+
+private:
+	enum class Access
+	{
+		Sample,
+		Image,
+		Write,
+		Read,
+	};
+
+	struct Use
+	{
+		Resource	resource;
+		Access		access;
+		GLenum		attachment;
+		Load		load;
+	};
+
+	struct Target
+	{
+		std::string				name;
+		RenderTargetPool::Target	desc;
+		bool					transient;
+		bool					exported;
+		GLuint*					object;			// imported: the caller's variable, transient: its slot's
+		GLsizei					width;			// imported only
+		GLsizei					height;
+		// the current schedule
+		size_t					first;
+		size_t					last;
+		size_t					slot;
+	};
+
+	// a pooled texture or renderbuffer that one or more transient targets live in
+	struct Slot
+	{
+		RenderTargetPool::Target	desc;
+		GLuint					name = 0;
+		size_t					busyUntil;
+	};
+
+	struct Attachment
+	{
+		GLenum		point;
+		GLuint*		object;
+		bool		renderbuffer;
+
+		bool operator==(const Attachment& other) const { return point == other.point && object == other.object; }
+	};
+
+	struct FramebufferObject
+	{
+		std::vector<Attachment>	attachments;
+		std::vector<GLenum>		drawBuffers;
+		const char*				owner;			// the first pass that used it
+		GLuint					name = 0;
+		bool					attached = false;
+		// the viewport: the pool's for transient targets, the imported target's size otherwise
+		bool					windowSized;
+		GLsizei					width;
+		GLsizei					height;
+	};
+
+	struct Pass
+	{
+		const char*				name;
+		std::function<void()>	execute;
+		std::function<bool()>	condition;
+		RenderState				state;
+		bool					sideEffect = false;
+		std::vector<Use>		uses;
+		// the current schedule
+		size_t					framebuffer;
+		GLbitfield				barriers;
+		std::vector<GLenum>		invalidateBefore;
+		std::vector<GLenum>		invalidateAfter;
+		std::vector<GLuint*>	invalidateTextures;
+	};
+
+	bool IsTransient(Resource resource) const { return m_targets[resource].transient; }
+	bool Overwrites(const Pass& pass, Resource resource) const;
+	size_t StateChanges(const Pass& from, const Pass& to) const;
+	void Compile();
+	size_t FindFramebuffer(const Pass& pass);
+	void Bind(size_t framebuffer);
+	void ApplyState(const RenderState& state);
+	void Clear(const Pass& pass);
+
+	RenderTargetPool&				m_pool;
+	GpuProfiler*					m_profiler = nullptr;
+	PipelineStatistics*				m_statistics = nullptr;
+	int								m_backbufferWidth = 0;
+	int								m_backbufferHeight = 0;
+	bool							m_invalidateSupported;
+
+	std::vector<Target>				m_targets;
+	std::vector<Pass>				m_passes;
+	std::deque<Slot>				m_slots;		// deque, so that the pool's pointers to the names stay valid
+	std::vector<FramebufferObject>	m_framebuffers;
+
+	std::vector<char>				m_enabled;		// the conditions of the current schedule
+	std::vector<char>				m_conditions;	// this frame's
+	bool							m_dirty = true;
+	std::vector<size_t>				m_schedule;
+	std::vector<size_t>				m_culled;		// enabled passes that lead to nothing visible
+	size_t							m_compilations = 0;
+
+	// what the GL state is known to be while the passes run
+	size_t							m_boundFramebuffer;
+	RenderState						m_state;
+	bool							m_stateKnown = false;
+	int								m_viewportWidth = 0;
+	int								m_viewportHeight = 0;
+};
@@ -0,0 +1,118 @@
+#include "RenderTargetPool.h"
+
+#include <algorithm>
+
+#include "CpuProfiler.h"
+#include "GpuResources.h"
+
+constexpr std::chrono::milliseconds RenderTargetPool::DEBOUNCE;
+
+RenderTargetPool::~RenderTargetPool()
+{
+	Clean();
+}
+
+void RenderTargetPool::Add(GLuint& name, const Target& target)
+{
+	m_targets.push_back({ &name, target });
+	// a target added later gets the current size right away, the others are left alone
+	if (m_allocatedWidth > 0)
+	{
+		Allocate(m_targets.back(), m_allocatedWidth, m_allocatedHeight);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	}
+}
+
+void RenderTargetPool::Remove(GLuint& name)
+{
+	auto entry = std::find_if(m_targets.begin(), m_targets.end(), [&](const Entry& entry) { return entry.name == &name; });
+	if (entry == m_targets.end())
+		return;
+
+	if (entry->target.renderbuffer)
+		GpuResources::DeleteRenderbuffer(name);
+	else
+		GpuResources::DeleteTexture(name);
+	m_targets.erase(entry);
+}
+
+void RenderTargetPool::Resize(int width, int height)
+{
+	m_requestedWidth = std::max(width, 1);
+	m_requestedHeight = std::max(height, 1);
+	m_lastResize = std::chrono::steady_clock::now();
+}
+
+int RenderTargetPool::Bucket(int size)
+{
+	return (size + BUCKET_SIZE - 1) / BUCKET_SIZE * BUCKET_SIZE;
+}
+
+bool RenderTargetPool::Update()
+{
+	if (m_requestedWidth == 0)
+		return false;
+
+	// a smaller window keeps the targets until it would leave more than half of them unused
+	int bucketWidth = Bucket(m_requestedWidth);
+	int bucketHeight = Bucket(m_requestedHeight);
+	bool fits = bucketWidth <= m_allocatedWidth && bucketHeight <= m_allocatedHeight
+		&& static_cast<long long>(m_allocatedWidth) * m_allocatedHeight <= 2LL * bucketWidth * bucketHeight;
+
+	bool allocate = m_allocatedWidth == 0 || (!fits && std::chrono::steady_clock::now() - m_lastResize >= DEBOUNCE);
+	if (allocate)
+		Allocate(bucketWidth, bucketHeight);
+
+	// while the reallocation waits, what fits into the old targets
+	m_viewportWidth = std::min(m_requestedWidth, m_allocatedWidth);
+	m_viewportHeight = std::min(m_requestedHeight, m_allocatedHeight);
+	return allocate;
+}
+
+void RenderTargetPool::Allocate(Entry& entry, int width, int height)
+{
+	const Target& target = entry.target;
+	if (target.renderbuffer)
+	{
+		GpuResources::DeleteRenderbuffer(*entry.name);
+		*entry.name = GpuResources::CreateRenderbuffer(target.owner);
+		GpuResources::RenderbufferStorage(*entry.name, target.internalFormat, width, height);
+	}
+	else
+	{
+		GpuResources::DeleteTexture(*entry.name);
+		*entry.name = GpuResources::CreateTexture(target.owner);
+		GpuResources::TexImage2D(GL_TEXTURE_2D, *entry.name, target.internalFormat, width, height, target.format, target.type, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, target.filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, target.filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+}
+
+void RenderTargetPool::Allocate(int width, int height)
+{
+	CPU_ZONE("RenderTargetPool::Allocate");
+	for (Entry& entry : m_targets)
+		Allocate(entry, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	m_allocatedWidth = width;
+	m_allocatedHeight = height;
+	++m_reallocations;
+}
+
+void RenderTargetPool::Clean()
+{
+	for (Entry& entry : m_targets)
+	{
+		if (entry.target.renderbuffer)
+			GpuResources::DeleteRenderbuffer(*entry.name);
+		else
+			GpuResources::DeleteTexture(*entry.name);
+	}
+	m_allocatedWidth = 0;
+	m_allocatedHeight = 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/*
+	Render targets that follow the window size. Textures and renderbuffers are allocated in size buckets
+	(multiples of BUCKET_SIZE) and rendered into a viewport in their lower left corner. A target is only
+	reallocated when the window outgrows it, or shrinks to less than half of it.
+	Reallocation waits until the window size has stayed the same for DEBOUNCE. Dragging a window edge
+	therefore costs one allocation at the end instead of one per event. Until then the old targets are used,
+	cut down to what fits.
+
+	Targets whose size does not depend on the window, like the shadow map, do not belong here.
+	The pool writes the GL name of every target into the variable given to Add. Framebuffers referring to the
+	targets have to attach them again after Update reallocated them.
+*/
+class RenderTargetPool final
+{
+public:
+	static const int BUCKET_SIZE = 256;
+	static constexpr std::chrono::milliseconds DEBOUNCE{ 200 };
+
+	struct Target
+	{
+		std::string		owner;
+		GLenum			internalFormat;
+		// texture only: the format and type of the (absent) initial data, and the filter
+		GLenum			format;
+		GLenum			type;
+		GLenum			filter;
+		bool			renderbuffer;
+	};
+
+	RenderTargetPool() = default;
+	~RenderTargetPool();
+
+	RenderTargetPool(const RenderTargetPool&)				= delete;
+	RenderTargetPool& operator=(const RenderTargetPool&)	= delete;
+
+	// name has to outlive the pool, it is set whenever the target is (re)allocated; a target added after the
+	// first Update is allocated at once
+	void Add(GLuint& name, const Target& target);
+	// deletes the target and forgets name
+	void Remove(GLuint& name);
+
+	// the window's size, applied by the next Update
+	void Resize(int width, int height);
+	// once a frame; true if the targets were reallocated
+	bool Update();
+
+	// the part of the targets rendered to
+	int ViewportWidth() const { return m_viewportWidth; }
+	int ViewportHeight() const { return m_viewportHeight; }
+	// texture coordinates of the viewport's upper right corner
+	float ScaleX() const { return m_allocatedWidth > 0 ? static_cast<float>(m_viewportWidth) / m_allocatedWidth : 1.0f; }
+	float ScaleY() const { return m_allocatedHeight > 0 ? static_cast<float>(m_viewportHeight) / m_allocatedHeight : 1.0f; }
+
+	int AllocatedWidth() const { return m_allocatedWidth; }
+	int AllocatedHeight() const { return m_allocatedHeight; }
+	size_t Reallocations() const { return m_reallocations; }
+
+	void Clean();
+
+private:
+	struct Entry
+	{
+		GLuint*		name;
+		Target		target;
+	};
+
+	static int Bucket(int size);
+	static void Allocate(Entry& entry, int width, int height);
+	void Allocate(int width, int height);
+
+	std::vector<Entry>		m_targets;
+	int						m_requestedWidth = 0;
+	int						m_requestedHeight = 0;
+	int						m_viewportWidth = 0;
+	int						m_viewportHeight = 0;
+	int						m_allocatedWidth = 0;
+	int						m_allocatedHeight = 0;
+	std::chrono::steady_clock::time_point	m_lastResize;
+	size_t					m_reallocations = 0;
+};
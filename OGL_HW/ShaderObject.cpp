@@ -1,7 +1,10 @@
 #include "ShaderObject.h"
 
+#include "ShaderPreprocessor.h"
+
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 ShaderObject::ShaderObject(GLenum pType)
 {
@@ -46,25 +49,30 @@ ShaderObject::ShaderObject(GLenum pType, const std::string &pFilenameOrSource)
 }
 
 bool ShaderObject::FromFile(GLenum _shaderType, const char* _filename)
+{
+	// shaderkod betoltese _fileName fajlbol, az #include-ok feloldasaval
+	std::string shaderCode = "";
+	if (!ShaderPreprocessor::LoadFile(_filename, {}, shaderCode))
+		return false;
+
+	// trjnk vissza a fordts eredmnyvel
+	return CompileShaderFromMemory(m_id, shaderCode) > 0;
+}
+
+bool ShaderObject::LoadSourceFile(const char* _filename, std::string& _source)
 {
 	// _fileName megnyitasa
-	std::ifstream shaderStream(_filename);
+	std::ifstream shaderStream(_filename, std::ios::in | std::ios::binary);
 
 	if (!shaderStream.is_open())
 		return false;
 
-	// shaderkod betoltese _fileName fajlbol
-	std::string shaderCode = "";
-
-	// file tartalmanak betoltese a shaderCode string-be
-	std::string line = "";
-	while (std::getline(shaderStream, line))
-		shaderCode += line + "\n";
-
-	shaderStream.close();
+	// file tartalmanak betoltese a _source string-be egy lepesben
+	std::ostringstream contents;
+	contents << shaderStream.rdbuf();
+	_source = contents.str();
 
-	// trjnk vissza a fordts eredmnyvel
-	return CompileShaderFromMemory(m_id, shaderCode) > 0;
+	return true;
 }
 
 bool ShaderObject::FromMemory(GLenum _shaderType, const std::string& _source)
@@ -76,34 +84,50 @@ bool ShaderObject::FromMemory(GLenum _shaderType, const std::string& _source)
 		return false;
 }
 
-GLuint ShaderObject::CompileShaderFromMemory(const GLuint _shaderObject, const std::string& _source)
+bool ShaderObject::SubmitFromMemory(const std::string& _source)
 {
+	if (m_id == 0)
+		return false;
+
 	// betoltott kod hozzarendelese a shader-hez
 	const char* sourcePointer = _source.c_str();
-	glShaderSource(_shaderObject, 1, &sourcePointer, nullptr);
+	glShaderSource(m_id, 1, &sourcePointer, nullptr);
 
-	// shader leforditasa
-	glCompileShader(_shaderObject);
+	// shader leforditasa, az eredmenyre nem varunk
+	glCompileShader(m_id);
+
+	return true;
+}
 
+bool ShaderObject::CheckCompileStatus() const
+{
 	// ellenorizzuk, h minden rendben van-e
 	GLint result = GL_FALSE;
 	int infoLogLength;
 
 	// forditas statuszanak lekerdezese
-	glGetShaderiv(_shaderObject, GL_COMPILE_STATUS, &result);
-	glGetShaderiv(_shaderObject, GL_INFO_LOG_LENGTH, &infoLogLength);
+	glGetShaderiv(m_id, GL_COMPILE_STATUS, &result);
+	glGetShaderiv(m_id, GL_INFO_LOG_LENGTH, &infoLogLength);
 
 	if (GL_FALSE == result)
 	{
 		GLchar* error = new char[infoLogLength];
-		glGetShaderInfoLog(_shaderObject, infoLogLength, nullptr, error);
+		glGetShaderInfoLog(m_id, infoLogLength, nullptr, error);
 
 		std::cerr << "Hiba: " << error << std::endl;
 
 		delete[] error;
 
-		return 0;
+		return false;
 	}
 
-	return _shaderObject;
-}
\ No newline at end of file
+	return true;
+}
+
+GLuint ShaderObject::CompileShaderFromMemory(const GLuint _shaderObject, const std::string& _source)
+{
+	if (_shaderObject != m_id || !SubmitFromMemory(_source))
+		return 0;
+
+	return CheckCompileStatus() ? _shaderObject : 0;
+}
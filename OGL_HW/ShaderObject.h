@@ -27,6 +27,14 @@ public:
 
 	bool FromFile(GLenum _shaderType, const char* _filename);
 	bool FromMemory(GLenum _shaderType, const std::string& _source);
+
+	// starts the compilation without waiting for its result (the driver may compile on its own threads)
+	bool SubmitFromMemory(const std::string& _source);
+	// blocks until the compilation finished, prints the info log on failure
+	bool CheckCompileStatus() const;
+
+	// reads the whole source file into _source, without compiling anything
+	static bool LoadSourceFile(const char* _filename, std::string& _source);
 private:
 	GLuint	CompileShaderFromMemory(const GLuint _shaderObject, const std::string& _source);
 
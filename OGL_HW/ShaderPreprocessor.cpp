@@ -0,0 +1,110 @@
+#include "ShaderPreprocessor.h"
+#include "ShaderObject.h"
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	std::string DirectoryOf(const std::string& filename)
+	{
+		size_t slash = filename.find_last_of("/\\");
+		return slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+	}
+
+	// returns the first non-whitespace position of the line, or npos for an empty line
+	size_t FirstToken(const std::string& line)
+	{
+		return line.find_first_not_of(" \t");
+	}
+
+	bool StartsWithDirective(const std::string& line, const char* directive)
+	{
+		size_t start = FirstToken(line);
+		return start != std::string::npos && line.compare(start, strlen(directive), directive) == 0;
+	}
+}
+
+bool ShaderPreprocessor::LoadFile(const std::string& filename, const ShaderDefines& defines, std::string& source)
+{
+	Context context{ defines, {}, {} };
+	source.clear();
+
+	return Expand(filename, context, source);
+}
+
+std::string ShaderPreprocessor::DefinesKey(const ShaderDefines& defines)
+{
+	std::string key;
+	for (const auto& define : defines)
+		key += define.first + "=" + define.second + ";";
+	return key;
+}
+
+bool ShaderPreprocessor::Expand(const std::string& filename, Context& context, std::string& out)
+{
+	std::string text;
+	if (!ShaderObject::LoadSourceFile(filename.c_str(), text))
+	{
+		// a missing main file is reported by the caller (ShaderObject also probes file names this way)
+		if (!context.files.empty())
+			std::cerr << "[ShaderPreprocessor] Cannot open " << filename << std::endl;
+		return false;
+	}
+
+	const bool isMainFile = context.files.empty();
+	const size_t fileIndex = context.files.size();
+	context.files.push_back(filename);
+	context.included.insert(filename);
+
+	std::istringstream lines(text);
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(lines, line))
+	{
+		++lineNumber;
+
+		if (StartsWithDirective(line, "#version"))
+		{
+			out += line + "\n";
+
+			// defines have to come after #version, which must stay the first statement of the shader
+			if (isMainFile)
+			{
+				for (const auto& define : context.defines)
+					out += "#define " + define.first + " " + define.second + "\n";
+				out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+			}
+			continue;
+		}
+
+		if (StartsWithDirective(line, "#include"))
+		{
+			size_t open = line.find('"');
+			size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+			if (close == std::string::npos)
+			{
+				std::cerr << "[ShaderPreprocessor] " << filename << "(" << lineNumber << "): malformed #include" << std::endl;
+				return false;
+			}
+
+			const std::string includeName = DirectoryOf(filename) + line.substr(open + 1, close - open - 1);
+			if (context.included.count(includeName) == 0)
+			{
+				out += "#line 1 " + std::to_string(context.files.size()) + "\n";
+				if (!Expand(includeName, context, out))
+				{
+					std::cerr << "[ShaderPreprocessor] included from " << filename << "(" << lineNumber << ")" << std::endl;
+					return false;
+				}
+				out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+			}
+			continue;
+		}
+
+		out += line + "\n";
+	}
+
+	return true;
+}
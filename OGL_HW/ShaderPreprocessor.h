@@ -0,0 +1,36 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Name -> value pairs injected as #defines. A std::map keeps them sorted, so the same set always gives the same key.
+using ShaderDefines = std::map<std::string, std::string>;
+
+/*
+	Minimal front end run on GLSL sources before they reach the driver:
+		- #include "file" is replaced by the contents of file (looked up next to the including file), every
+		  file is included at most once per shader,
+		- the host supplied defines are inserted right after the #version line,
+		- #line directives keep the driver's error messages pointing at the right line; the source string
+		  number is the index of the file in the order they were opened (0 is the main file).
+*/
+class ShaderPreprocessor final
+{
+public:
+	static bool LoadFile(const std::string& filename, const ShaderDefines& defines, std::string& source);
+
+	// canonical text form of a define set, used in cache keys
+	static std::string DefinesKey(const ShaderDefines& defines);
+
+private:
+	struct Context
+	{
+		const ShaderDefines&		defines;
+		std::vector<std::string>	files;
+		std::set<std::string>		included;
+	};
+
+	static bool Expand(const std::string& filename, Context& context, std::string& out);
+};
@@ -0,0 +1,108 @@
+#include "SimulationThread.h"
+
+#include "CpuProfiler.h"
+
+namespace
+{
+	// steps finished but not taken by the renderer yet
+	const uint64_t MAX_STEPS_AHEAD = 1;
+}
+
+SimulationThread::SimulationThread(std::function<void()> step, uint64_t steps)
+	: m_step(std::move(step))
+	, m_steps(steps)
+	, m_consumed(steps)
+	, m_thread(&SimulationThread::Loop, this)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_changed.notify_all();
+	m_thread.join();
+}
+
+void SimulationThread::Consumed(uint64_t step)
+{
+	m_consumed = step;
+	Wake();
+}
+
+void SimulationThread::WaitForStep(uint64_t step)
+{
+	if (m_steps >= step)
+		return;
+
+	CPU_ZONE("SimulationThread::WaitForStep");
+	std::unique_lock<std::mutex> lock(m_mutex);
+	++m_sleepers;
+	m_changed.wait(lock, [&] { return m_steps >= step || m_stop; });
+	--m_sleepers;
+}
+
+void SimulationThread::Wake()
+{
+	// the sleeper counts itself before checking the counters, and the counters were changed before this check
+	// (both sequentially consistent), so either it sees the change or it is seen here
+	if (m_sleepers > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_changed.notify_all();
+	}
+}
+
+void SimulationThread::Loop()
+{
+	CpuProfiler::SetThreadName("simulation");
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_idle = true;
+			if (m_pauses > 0)
+				m_changed.notify_all();
+
+			++m_sleepers;
+			m_changed.wait(lock, [this] { return m_stop || (m_pauses == 0 && m_steps - m_consumed < MAX_STEPS_AHEAD); });
+			--m_sleepers;
+
+			m_idle = false;
+			if (m_stop)
+				return;
+		}
+
+		m_step();
+		++m_steps;
+		Wake();
+	}
+}
+
+SimulationThread::Pause::Pause(SimulationThread* thread)
+	: m_thread(thread)
+{
+	if (m_thread == nullptr)
+		return;
+
+	std::unique_lock<std::mutex> lock(m_thread->m_mutex);
+	++m_thread->m_pauses;
+	++m_thread->m_sleepers;
+	m_thread->m_changed.wait(lock, [this] { return m_thread->m_idle || m_thread->m_stop; });
+	--m_thread->m_sleepers;
+}
+
+SimulationThread::Pause::~Pause()
+{
+	if (m_thread == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_thread->m_mutex);
+		--m_thread->m_pauses;
+	}
+	m_thread->m_changed.notify_all();
+}
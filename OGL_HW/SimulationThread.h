@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/*
+	Runs a step function (the simulation's Update) over and over on its own thread, at most one step ahead of the
+	renderer: step n + 1 only starts once the renderer has taken the result of step n, so simulating the next
+	frame overlaps with rendering the current one. The results are handed over by the step itself (through a
+	TripleBuffer); this class only paces the two sides.
+
+	Both sides only touch atomics, the mutex is taken only to wake a side that is asleep. The renderer never
+	sleeps unless it asks to with WaitForStep.
+
+	A Pause stops the thread between two steps, for the rare changes of the state the step reads.
+*/
+class SimulationThread final
+{
+public:
+	// steps: how many have been taken before (without the thread), so that the numbers go on from there
+	SimulationThread(std::function<void()> step, uint64_t steps);
+	// finishes the current step, then joins
+	~SimulationThread();
+
+	SimulationThread(const SimulationThread&)				= delete;
+	SimulationThread& operator=(const SimulationThread&)	= delete;
+
+	// steps are counted from 1; the renderer has taken the result of this step
+	void Consumed(uint64_t step);
+	// blocks until this many steps have finished
+	void WaitForStep(uint64_t step);
+	uint64_t Steps() const { return m_steps; }
+
+	// the thread idles between two steps while a Pause is alive; nullptr pauses nothing (no simulation thread)
+	class Pause final
+	{
+	public:
+		explicit Pause(SimulationThread* thread);
+		~Pause();
+
+		Pause(const Pause&)				= delete;
+		Pause& operator=(const Pause&)	= delete;
+
+	private:
+		SimulationThread*	m_thread;
+	};
+
+private:
+	void Loop();
+	// wakes whoever sleeps after one of the counters changed
+	void Wake();
+
+	std::function<void()>		m_step;
+
+	std::atomic<uint64_t>		m_steps{ 0 };		// finished
+	std::atomic<uint64_t>		m_consumed{ 0 };
+	std::atomic<int>			m_sleepers{ 0 };	// threads waiting or about to wait on m_changed
+
+	std::mutex					m_mutex;
+	std::condition_variable		m_changed;
+	int							m_pauses = 0;
+	bool						m_idle = false;		// between two steps, the step's state can be changed
+	bool						m_stop = false;
+
+	std::thread					m_thread;			// last, so that it starts with everything above initialized
+};
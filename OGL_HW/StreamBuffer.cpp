@@ -0,0 +1,195 @@
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "CpuProfiler.h"
+#include "GpuResources.h"
+
+namespace
+{
+	GLsizeiptr AlignUp(GLsizeiptr value, GLsizeiptr alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+StreamBuffer::StreamBuffer(GLsizeiptr sliceSize) : m_sliceSize(sliceSize)
+{
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	Clean();
+}
+
+void StreamBuffer::Init(const std::string& owner)
+{
+	m_owner = owner;
+	m_persistent = GLEW_ARB_buffer_storage != GL_FALSE;
+
+	// vertex data only needs 4 bytes, the ranges bound to blocks ask for more
+	GLint uniformAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	m_alignment = std::max<GLsizeiptr>(uniformAlignment, 16);
+	if (GLEW_ARB_shader_storage_buffer_object)
+	{
+		GLint storageAlignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+		m_alignment = std::max<GLsizeiptr>(m_alignment, storageAlignment);
+	}
+
+	Create();
+}
+
+void StreamBuffer::Create()
+{
+	m_sliceSize = AlignUp(m_sliceSize, m_alignment);
+	const GLsizeiptr size = m_sliceSize * SLICES;
+
+	m_id = GpuResources::CreateBuffer(m_owner);
+	++m_generation;
+	if (m_persistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		if (GpuResources::DirectStateAccess())
+		{
+			GpuResources::NamedBufferStorage(m_id, size, nullptr, flags);
+			m_mapped = static_cast<unsigned char*>(glMapNamedBufferRange(m_id, 0, size, flags));
+		}
+		else
+		{
+			GpuResources::BufferStorage(GL_COPY_WRITE_BUFFER, m_id, size, nullptr, flags);
+			m_mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		if (m_mapped == nullptr)
+		{
+			std::cerr << "[StreamBuffer] Could not map " << m_owner << " persistently, falling back to glBufferSubData" << std::endl;
+			GpuResources::DeleteBuffer(m_id);
+			m_persistent = false;
+			Create();
+			return;
+		}
+	}
+	else
+	{
+		if (GpuResources::DirectStateAccess())
+		{
+			GpuResources::NamedBufferData(m_id, size, nullptr, GL_STREAM_DRAW);
+		}
+		else
+		{
+			GpuResources::BufferData(GL_COPY_WRITE_BUFFER, m_id, size, nullptr, GL_STREAM_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		m_staging.resize(static_cast<size_t>(m_sliceSize));
+	}
+}
+
+void StreamBuffer::Clean()
+{
+	for (size_t i = 0; i < SLICES; ++i)
+		WaitForSlice(i);
+
+	if (m_mapped != nullptr)
+	{
+		if (GpuResources::DirectStateAccess())
+		{
+			glUnmapNamedBuffer(m_id);
+		}
+		else
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		m_mapped = nullptr;
+	}
+	GpuResources::DeleteBuffer(m_id);
+	m_staging.clear();
+}
+
+void StreamBuffer::WaitForSlice(size_t slice)
+{
+	GLsync& fence = m_fences[slice];
+	if (fence == nullptr)
+		return;
+
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+	if (status != GL_ALREADY_SIGNALED)
+		++m_waits;
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void StreamBuffer::BeginFrame()
+{
+	CPU_ZONE("StreamBuffer::BeginFrame");
+
+	// the largest frame seen, with some headroom; every slice may still be read, so all of them are waited for
+	if (m_overflowed && m_id != 0)
+	{
+		m_sliceSize = std::max(m_sliceSize, m_highWater + m_highWater / 2);
+		Clean();
+		Create();
+		m_overflowed = false;
+	}
+
+	m_slice = (m_slice + 1) % SLICES;
+	WaitForSlice(m_slice);
+	m_offset = 0;
+}
+
+void StreamBuffer::EndFrame()
+{
+	m_highWater = std::max(m_highWater, m_offset);
+	m_fences[m_slice] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+StreamBuffer::Allocation StreamBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	GLsizeiptr aligned = AlignUp(m_offset, alignment == 0 ? m_alignment : alignment);
+	if (m_id == 0 || aligned + size > m_sliceSize)
+	{
+		if (!m_overflowed)
+		{
+			std::cerr << "[StreamBuffer] " << m_owner << " is full, " << size << " bytes are dropped this frame" << std::endl;
+			++m_overflows;
+		}
+		// counted anyway, so that the slices grow enough
+		m_offset = std::max(m_offset, aligned + size);
+		m_overflowed = true;
+		return {};
+	}
+
+	m_offset = aligned + size;
+
+	Allocation allocation;
+	allocation.offset = m_sliceSize * static_cast<GLsizeiptr>(m_slice) + aligned;
+	allocation.size = size;
+	allocation.data = m_persistent ? m_mapped + allocation.offset : m_staging.data() + aligned;
+	return allocation;
+}
+
+void StreamBuffer::Flush(const Allocation& allocation)
+{
+	// coherent mapping: the writes are seen by every command issued after them
+	if (m_persistent || allocation.data == nullptr)
+		return;
+
+	if (GpuResources::DirectStateAccess())
+	{
+		glNamedBufferSubData(m_id, allocation.offset, allocation.size, allocation.data);
+		return;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, allocation.size, allocation.data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::BindRange(GLenum target, GLuint index, const Allocation& allocation) const
+{
+	if (allocation.data != nullptr)
+		glBindBufferRange(target, index, m_id, allocation.offset, allocation.size);
+}
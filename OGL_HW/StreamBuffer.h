@@ -0,0 +1,91 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <GL\GL.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "FramePacer.h"
+
+/*
+	Ring buffer for data written by the CPU every frame (uniform blocks, light arrays, vertex data), split into
+	one slice per frame that can be in flight plus the one being recorded. With ARB_buffer_storage the buffer
+	is mapped once, persistently and coherently, so Allocate hands out pointers into memory the GPU reads
+	directly: no glBufferSubData copy, no orphaning and no implicit synchronisation. A fence after the frame
+	guards its slice, BeginFrame only waits for it if the GPU is that far behind, which the frame pacer
+	normally prevents.
+
+	Without buffer storage the allocations are staged in CPU memory and Flush copies them with glBufferSubData.
+	A frame that does not fit gets null allocations; the next BeginFrame grows the slices to fit it.
+*/
+class StreamBuffer final
+{
+public:
+	static const size_t SLICES = FramePacer::MAX_FRAMES_IN_FLIGHT + 1;
+
+	struct Allocation
+	{
+		void*		data = nullptr;		// null if the slice was full
+		GLintptr	offset = 0;			// into the buffer, for binding
+		GLsizeiptr	size = 0;
+	};
+
+	explicit StreamBuffer(GLsizeiptr sliceSize = 1 << 16);
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer&)				= delete;
+	StreamBuffer& operator=(const StreamBuffer&)	= delete;
+
+	void Init(const std::string& owner);
+	void Clean();
+
+	// moves to the next slice
+	void BeginFrame();
+	// after the last command reading this frame's allocations
+	void EndFrame();
+
+	// alignment 0: one that suits uniform and storage buffer ranges, and vertex data
+	Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 0);
+	template <typename T>
+	T* Allocate(size_t count, Allocation& allocation) { allocation = Allocate(sizeof(T) * count); return static_cast<T*>(allocation.data); }
+
+	// call once the allocation is written; only copies without persistent mapping
+	void Flush(const Allocation& allocation);
+
+	void BindRange(GLenum target, GLuint index, const Allocation& allocation) const;
+
+	operator GLuint() const { return m_id; }
+
+	bool IsPersistent() const { return m_persistent; }
+	GLsizeiptr SliceSize() const { return m_sliceSize; }
+	// changes whenever the storage is recreated, which may reuse the id
+	size_t Generation() const { return m_generation; }
+	// most used by a single frame so far
+	GLsizeiptr HighWater() const { return m_highWater; }
+	// frames that found their slice still in use by the GPU
+	size_t Waits() const { return m_waits; }
+	// frames that did not fit
+	size_t Overflows() const { return m_overflows; }
+
+private:
+	void Create();
+	void WaitForSlice(size_t slice);
+
+	std::string							m_owner;
+	GLuint								m_id = 0;
+	bool								m_persistent = false;
+	unsigned char*						m_mapped = nullptr;
+	std::vector<unsigned char>			m_staging;			// one slice, without persistent mapping
+	GLsizeiptr							m_alignment = 256;
+	GLsizeiptr							m_sliceSize;
+	size_t								m_generation = 0;
+	std::array<GLsync, SLICES>			m_fences{};
+	size_t								m_slice = 0;
+	GLsizeiptr							m_offset = 0;		// into the current slice
+	bool								m_overflowed = false;
+	GLsizeiptr							m_highWater = 0;
+	size_t								m_waits = 0;
+	size_t								m_overflows = 0;
+};
@@ -5,6 +5,8 @@
 
 #include <string>
 
+struct SDL_Surface;
+
 enum class TextureType
 {
 	Texture1D					= GL_TEXTURE_1D, 
@@ -36,6 +38,8 @@ public:
 	TextureObject& operator=(const std::string& s);
 
 	void AttachFromFile(const std::string&, bool generateMipMap = true, GLuint role = static_cast<GLuint>(type));
+	// uploads an image decoded elsewhere (e.g. IMG_Load on a worker), name only labels the texture
+	void AttachFromSurface(SDL_Surface*, const std::string& name, bool generateMipMap = true, GLuint role = static_cast<GLuint>(type));
 	void FromFile(const std::string&);
 
 	operator unsigned int() const { return m_id; }
@@ -44,6 +48,7 @@ public:
 
 private:
 	GLuint m_id{};
+	bool m_immutable{};	// has storage from glTextureStorage2D
 };
 
 #include "TextureObject.inl"
@@ -1,6 +1,8 @@
 #include <GL\glew.h>
 #include <GL\GL.h>
 #include "TextureObject.h"
+#include "CpuProfiler.h"
+#include "GpuResources.h"
 
 #include <SDL.h>
 #include <SDL_image.h>
@@ -8,11 +10,11 @@
 template<TextureType type>
 inline TextureObject<type>::TextureObject()
 {
-	glGenTextures(1, &m_id);
+	m_id = GpuResources::CreateTexture("TextureObject", static_cast<GLenum>(type));
 }
 
 template<TextureType type>
-inline TextureObject<type>::TextureObject(const std::string &s)
+inline TextureObject<type>::TextureObject(const std::string &s) : TextureObject()
 {
 	AttachFromFile(s);
 }
@@ -30,6 +32,7 @@ inline TextureObject<type>::TextureObject(TextureObject && rhs)
 		return;
 
 	m_id = rhs.m_id;
+	m_immutable = rhs.m_immutable;
 	rhs.m_id = 0;
 }
 
@@ -40,6 +43,7 @@ inline TextureObject<type> & TextureObject<type>::operator=(TextureObject && rhs
 		return *this;
 
 	m_id = rhs.m_id;
+	m_immutable = rhs.m_immutable;
 	rhs.m_id = 0;
 
 	return *this;
@@ -55,39 +59,68 @@ inline TextureObject<type>& TextureObject<type>::operator=(const std::string & s
 template<TextureType type>
 inline void TextureObject<type>::AttachFromFile(const std::string& filename, bool generateMipMap, GLuint role)
 {
+	CPU_ZONE("TextureObject::AttachFromFile");
 	SDL_Surface* loaded_img = IMG_Load(filename.c_str());
 
-	int img_mode = 0;
-
 	if (loaded_img == 0)
 	{
 		std::cerr << "[AttachFromFile] Error loading image file " << filename << std::endl;
 		return;
 	}
 
+	AttachFromSurface(loaded_img, filename, generateMipMap, role);
+	SDL_FreeSurface(loaded_img);
+}
+
+template<TextureType type>
+inline void TextureObject<type>::AttachFromSurface(SDL_Surface* loaded_img, const std::string& name, bool generateMipMap, GLuint role)
+{
+	CPU_ZONE("TextureObject::AttachFromSurface");
+	int img_mode = 0;
+
 	if (loaded_img->format->BytesPerPixel == 4)
 		img_mode = GL_RGBA;
 	else
 		img_mode = GL_RGB;
 
-	glBindTexture(static_cast<GLenum>(type), m_id);
-	glTexImage2D(
+	// immutable storage for the whole mip chain, filled and set up by name
+	if (GpuResources::DirectStateAccess())
+	{
+		// storage cannot be given twice, a texture loaded again gets a new name
+		if (m_immutable)
+		{
+			Clean();
+			m_id = GpuResources::CreateTexture(name, static_cast<GLenum>(type));
+		}
+		m_immutable = true;
+
+		GpuResources::SetOwner(GpuResources::Kind::Texture, m_id, name);
+		GpuResources::TextureStorage2D(m_id, generateMipMap ? GpuResources::MipLevelCount(loaded_img->w, loaded_img->h) : 1, GL_RGBA8,
+									   loaded_img->w, loaded_img->h);
+		glTextureSubImage2D(m_id, 0, 0, 0, loaded_img->w, loaded_img->h, img_mode, GL_UNSIGNED_BYTE, loaded_img->pixels);
+		if (generateMipMap)
+			glGenerateTextureMipmap(m_id);
+
+		glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return;
+	}
+
+	GpuResources::SetOwner(GpuResources::Kind::Texture, m_id, name);
+	GpuResources::TexImage2D(
 		static_cast<GLenum>(type),		// melyik binding point-on van a textra erforrs, amihez trolst rendelnk
-		0,								// melyik rszletessgi szint adatait hatrozzuk meg
+		m_id,
 		GL_RGBA8,						// textra bels trolsi formtuma (GPU-n)
 		loaded_img->w, loaded_img->h,	// szlessg, magassg
-		0,								// nulla kell, hogy legyen ( https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glTexImage2D.xhtml )
 		img_mode,						// forrs (=CPU-n) formtuma
 		GL_UNSIGNED_BYTE,				// forrs egy pixelnek egy csatornjt hogyan troljuk
 		loaded_img->pixels);			// forrshoz pointer
 
 	if (generateMipMap)
-		glGenerateMipmap(static_cast<GLenum>(type));
+		GpuResources::GenerateMipmap(static_cast<GLenum>(type), m_id);
 
 	glTexParameteri(static_cast<GLenum>(type), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(static_cast<GLenum>(type), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	SDL_FreeSurface(loaded_img);
 }
 
 template<TextureType type>
@@ -99,9 +132,5 @@ inline void TextureObject<type>::FromFile(const std::string& s)
 template<TextureType type>
 inline void TextureObject<type>::Clean()
 {
-	if (m_id != 0)
-	{
-		glDeleteTextures(1, &m_id);
-		m_id = 0;
-	}
+	GpuResources::DeleteTexture(m_id);
 }
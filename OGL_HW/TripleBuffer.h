@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+/*
+	Hands the newest value from one producer thread to one consumer thread without locking or waiting. Of the
+	three slots, the producer owns one (WriteBuffer), the consumer owns one (ReadBuffer) and the third holds the
+	latest published value; Publish and Acquire swap their own slot with that one in a single atomic exchange.
+
+	The consumer only ever sees the newest value; values published in between are skipped. A slot returned to
+	the producer holds whatever was written two values ago, so every Publish has to fill in the whole value.
+*/
+template <typename T>
+class TripleBuffer final
+{
+public:
+	TripleBuffer() = default;
+
+	TripleBuffer(const TripleBuffer&)				= delete;
+	TripleBuffer& operator=(const TripleBuffer&)	= delete;
+
+	// producer side
+	T& WriteBuffer() { return m_slots[m_write]; }
+	void Publish();
+
+	// consumer side: true if a newer value has been taken into ReadBuffer
+	bool Acquire();
+	const T& ReadBuffer() const { return m_slots[m_read]; }
+
+private:
+	// set in m_latest while its slot has not been taken by the consumer
+	static const unsigned int FRESH = 4;
+
+	std::array<T, 3>			m_slots{};
+	unsigned int				m_write = 0;
+	unsigned int				m_read = 1;
+	alignas(64) std::atomic<unsigned int>	m_latest{ 2 };
+};
+
+#include "TripleBuffer.inl"
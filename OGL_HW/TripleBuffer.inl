@@ -0,0 +1,19 @@
+template <typename T>
+inline void TripleBuffer<T>::Publish()
+{
+	// release: the consumer that takes the slot sees everything written into it
+	unsigned int previous = m_latest.exchange(m_write | FRESH, std::memory_order_acq_rel);
+	m_write = previous & ~FRESH;
+}
+
+template <typename T>
+inline bool TripleBuffer<T>::Acquire()
+{
+	// only the producer sets FRESH, so once it is seen the exchange below gets a fresh slot too
+	if ((m_latest.load(std::memory_order_relaxed) & FRESH) == 0)
+		return false;
+
+	unsigned int latest = m_latest.exchange(m_read, std::memory_order_acq_rel);
+	m_read = latest & ~FRESH;
+	return true;
+}
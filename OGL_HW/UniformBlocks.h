@@ -0,0 +1,66 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include <glm/glm.hpp>
+
+/*
+	Host side mirrors of the std140 uniform blocks (and std430 storage buffers) declared in the shaders.
+	The member order (and the implicit padding) has to match the GLSL declarations exactly.
+*/
+
+enum class UniformBlockBinding : GLuint
+{
+	PerFrame	= 0,
+	PerMaterial	= 1,
+	PointLights	= 2		// LightMarker[NUM_POINT_LIGHTS], see deferredPoint.frag
+};
+
+// layout(std140) uniform PerFrame
+struct PerFrameUniforms
+{
+	glm::mat4	view;
+	glm::mat4	proj;
+	glm::mat4	viewProj;
+	glm::mat4	lightViewProj;
+	glm::vec3	eyePos;			// vec3 + float share one 16 byte slot in std140
+	float		time;
+	glm::vec2	viewportSize;	// of the off-screen targets, the part of them rendered to
+	glm::vec2	targetScale;	// texture coordinates of that part's far corner
+};
+
+// layout(std140) uniform PerMaterial
+struct MaterialUniforms
+{
+	float	Ka;
+	float	Kd;
+	float	Ks;
+	float	specularPower;
+};
+
+static_assert(sizeof(PerFrameUniforms) == 4 * 64 + 32, "PerFrameUniforms does not match the std140 layout of the PerFrame block");
+static_assert(sizeof(MaterialUniforms) == 16, "MaterialUniforms does not match the std140 layout of the PerMaterial block");
+
+// fixed binding = N in the shaders
+enum class StorageBufferBinding : GLuint
+{
+	LightMarkers	= 0,	// LightMarker per light, see MyApp.h and light_markers.glsl
+	LightMotions	= 1
+};
+
+// std430 buffer LightMotions in light_animation.comp, the GPU side of LightSimulation's goals and random states
+struct LightMotion
+{
+	glm::vec3	goal;
+	GLuint		random;
+};
+
+static_assert(sizeof(LightMotion) == 16, "LightMotion does not match the std430 layout of the LightMotions buffer");
+
+enum class MaterialId : int
+{
+	Default = 0,
+	Rock,
+	Water,
+	Count
+};
@@ -0,0 +1,481 @@
+#include "Vegetation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <random>
+#include <tuple>
+#include <unordered_map>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+VegetationPlacer::VegetationPlacer(const Mesh& terrain)
+{
+	const std::vector<Mesh::Vertex>& vertices = terrain.getVertices();
+	const std::vector<unsigned int>& indices = terrain.getIndices();
+
+	m_triangles.reserve(indices.size() / 3);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		Triangle triangle;
+		triangle.a = vertices[indices[i + 0]].position;
+		triangle.b = vertices[indices[i + 1]].position;
+		triangle.c = vertices[indices[i + 2]].position;
+
+		glm::vec3 cross = glm::cross(triangle.b - triangle.a, triangle.c - triangle.a);
+		triangle.area = 0.5f * glm::length(cross);
+		if (triangle.area <= 0.0f)
+			continue;
+
+		// the terrain may be wound either way, vegetation wants the upward side
+		triangle.normal = glm::normalize(cross);
+		if (triangle.normal.y < 0.0f)
+			triangle.normal = -triangle.normal;
+
+		m_triangles.push_back(triangle);
+	}
+}
+
+std::vector<glm::mat4> VegetationPlacer::Scatter(const VegetationDensity& density, float densityScale, glm::vec2 scaleRange, unsigned int seed) const
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<glm::mat4> transforms;
+	for (const Triangle& triangle : m_triangles)
+	{
+		glm::vec3 centroid = (triangle.a + triangle.b + triangle.c) / 3.0f;
+		float expected = density(centroid, triangle.normal) * densityScale * triangle.area;
+		if (expected <= 0.0f)
+			continue;
+
+		// the fractional part is kept as a probability, so sparse densities still average out right
+		int count = static_cast<int>(expected + unit(rng));
+		for (int i = 0; i < count; ++i)
+		{
+			// uniform point of the triangle
+			float u = unit(rng);
+			float v = unit(rng);
+			if (u + v > 1.0f)
+			{
+				u = 1.0f - u;
+				v = 1.0f - v;
+			}
+			glm::vec3 position = triangle.a + u * (triangle.b - triangle.a) + v * (triangle.c - triangle.a);
+
+			float yaw = unit(rng) * glm::two_pi<float>();
+			float scale = glm::mix(scaleRange.x, scaleRange.y, unit(rng));
+
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+			transform = glm::rotate(transform, yaw, glm::vec3(0, 1, 0));
+			transform = glm::scale(transform, glm::vec3(scale));
+			transforms.push_back(transform);
+		}
+	}
+
+	return transforms;
+}
+
+namespace
+{
+	const float MIN_PROTOTYPE_HEIGHT = 1e-3f;
+
+	// triangles connected to each other
+	struct Piece
+	{
+		std::vector<unsigned int>	triangles;		// offsets of the first index
+		glm::vec3					min, max;
+	};
+
+	unsigned int FindRoot(std::vector<unsigned int>& parents, unsigned int i)
+	{
+		while (parents[i] != i)
+		{
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+		return i;
+	}
+
+	void Unite(std::vector<unsigned int>& parents, unsigned int a, unsigned int b)
+	{
+		parents[FindRoot(parents, a)] = FindRoot(parents, b);
+	}
+
+	std::vector<Piece> SplitPieces(const std::vector<Mesh::Vertex>& vertices, const std::vector<unsigned int>& indices)
+	{
+		std::vector<unsigned int> parents(vertices.size());
+		std::iota(parents.begin(), parents.end(), 0u);
+
+		// the parser splits vertices at texture seams, their shared position keeps them together
+		std::map<std::tuple<float, float, float>, unsigned int> positions;
+		for (unsigned int i = 0; i < vertices.size(); ++i)
+		{
+			const glm::vec3& position = vertices[i].position;
+			auto inserted = positions.emplace(std::make_tuple(position.x, position.y, position.z), i);
+			if (!inserted.second)
+				Unite(parents, i, inserted.first->second);
+		}
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			Unite(parents, indices[i], indices[i + 1]);
+			Unite(parents, indices[i], indices[i + 2]);
+		}
+
+		std::vector<Piece> pieces;
+		std::unordered_map<unsigned int, size_t> pieceOfRoot;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			auto found = pieceOfRoot.emplace(FindRoot(parents, indices[i]), pieces.size());
+			if (found.second)
+				pieces.push_back({ {}, vertices[indices[i]].position, vertices[indices[i]].position });
+
+			Piece& piece = pieces[found.first->second];
+			piece.triangles.push_back(static_cast<unsigned int>(i));
+			for (size_t corner = 0; corner < 3; ++corner)
+			{
+				piece.min = glm::min(piece.min, vertices[indices[i + corner]].position);
+				piece.max = glm::max(piece.max, vertices[indices[i + corner]].position);
+			}
+		}
+		return pieces;
+	}
+
+	// distance between two boxes seen from above, 0 if they overlap
+	float GapXZ(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+	{
+		glm::vec2 gap = glm::max(glm::vec2(minB.x - maxA.x, minB.z - maxA.z), glm::vec2(minA.x - maxB.x, minA.z - maxB.z));
+		return glm::length(glm::max(gap, glm::vec2(0)));
+	}
+
+	// the given triangles as a mesh of their own, origin moved to 0
+	std::unique_ptr<Mesh> ExtractTriangles(const std::vector<Mesh::Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<unsigned int>& triangles, const glm::vec3& origin)
+	{
+		std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>();
+		std::unordered_map<unsigned int, unsigned int> remap;
+		for (unsigned int triangle : triangles)
+		{
+			for (unsigned int corner = 0; corner < 3; ++corner)
+			{
+				unsigned int index = indices[triangle + corner];
+				auto found = remap.emplace(index, static_cast<unsigned int>(remap.size()));
+				if (found.second)
+				{
+					Mesh::Vertex vertex = vertices[index];
+					vertex.position -= origin;
+					mesh->addVertex(vertex);
+				}
+				mesh->addIndex(found.first->second);
+			}
+		}
+		return mesh;
+	}
+}
+
+VegetationSource::VegetationSource(const Mesh& baked, float margin) : m_vertices(baked.getVertices()), m_indices(baked.getIndices())
+{
+	std::vector<Piece> pieces = SplitPieces(m_vertices, m_indices);
+
+	// swept along x, only the pieces starting within margin of one's end can be close to it
+	std::vector<unsigned int> byMinX(pieces.size());
+	std::iota(byMinX.begin(), byMinX.end(), 0u);
+	std::sort(byMinX.begin(), byMinX.end(), [&pieces](unsigned int lhs, unsigned int rhs) { return pieces[lhs].min.x < pieces[rhs].min.x; });
+
+	std::vector<unsigned int> parents(pieces.size());
+	std::iota(parents.begin(), parents.end(), 0u);
+	for (size_t i = 0; i < byMinX.size(); ++i)
+	{
+		const Piece& piece = pieces[byMinX[i]];
+		for (size_t j = i + 1; j < byMinX.size() && pieces[byMinX[j]].min.x <= piece.max.x + margin; ++j)
+		{
+			const Piece& other = pieces[byMinX[j]];
+			if (GapXZ(piece.min, piece.max, other.min, other.max) <= margin)
+				Unite(parents, byMinX[i], byMinX[j]);
+		}
+	}
+
+	std::unordered_map<unsigned int, size_t> plantOfRoot;
+	for (unsigned int i = 0; i < pieces.size(); ++i)
+	{
+		auto found = plantOfRoot.emplace(FindRoot(parents, i), m_plants.size());
+		if (found.second)
+			m_plants.push_back({ {}, pieces[i].min, pieces[i].max, glm::vec3(0), 0.0f });
+
+		Plant& plant = m_plants[found.first->second];
+		plant.triangles.insert(plant.triangles.end(), pieces[i].triangles.begin(), pieces[i].triangles.end());
+		plant.min = glm::min(plant.min, pieces[i].min);
+		plant.max = glm::max(plant.max, pieces[i].max);
+	}
+
+	for (Plant& plant : m_plants)
+	{
+		// the lowest and the highest tenth of the plant tell where it stands and where it leans to
+		float height = plant.max.y - plant.min.y;
+		glm::vec2 bottom(0), top(0);
+		float bottomCount = 0, topCount = 0;
+		for (unsigned int triangle : plant.triangles)
+		{
+			for (unsigned int corner = 0; corner < 3; ++corner)
+			{
+				const glm::vec3& position = m_vertices[m_indices[triangle + corner]].position;
+				if (position.y <= plant.min.y + 0.1f * height)
+				{
+					bottom += glm::vec2(position.x, position.z);
+					++bottomCount;
+				}
+				if (position.y >= plant.max.y - 0.1f * height)
+				{
+					top += glm::vec2(position.x, position.z);
+					++topCount;
+				}
+			}
+		}
+		bottom /= bottomCount;
+		top /= topCount;
+
+		plant.base = glm::vec3(bottom.x, plant.min.y, bottom.y);
+		glm::vec2 lean = top - bottom;
+		plant.yaw = glm::length(lean) > 0.05f * height ? atan2(lean.x, lean.y) : 0.0f;
+	}
+
+	if (m_plants.empty())
+	{
+		std::cerr << "[VegetationSource] The mesh has no triangles" << std::endl;
+		return;
+	}
+
+	// the median leaves out both fragments and plants that grew into each other; a flat plant cannot be
+	// scaled to the others' heights, so it is never the prototype
+	std::vector<size_t> bySize;
+	for (size_t i = 0; i < m_plants.size(); ++i)
+		if (m_plants[i].max.y - m_plants[i].min.y > MIN_PROTOTYPE_HEIGHT)
+			bySize.push_back(i);
+	if (bySize.empty())
+	{
+		std::cerr << "[VegetationSource] Every plant of the mesh is flat" << std::endl;
+		m_plants.clear();
+		return;
+	}
+	std::nth_element(bySize.begin(), bySize.begin() + bySize.size() / 2, bySize.end(), [this](size_t lhs, size_t rhs)
+	{
+		return m_plants[lhs].triangles.size() < m_plants[rhs].triangles.size();
+	});
+	m_prototype = bySize[bySize.size() / 2];
+}
+
+std::unique_ptr<Mesh> VegetationSource::Prototype() const
+{
+	if (m_plants.empty())
+		return std::make_unique<Mesh>();
+
+	const Plant& prototype = m_plants[m_prototype];
+	return ExtractTriangles(m_vertices, m_indices, prototype.triangles, prototype.base);
+}
+
+std::vector<glm::mat4> VegetationSource::Transforms() const
+{
+	std::vector<glm::mat4> transforms;
+	if (m_plants.empty())
+		return transforms;
+
+	const Plant& prototype = m_plants[m_prototype];
+	float prototypeHeight = prototype.max.y - prototype.min.y;
+	for (const Plant& plant : m_plants)
+	{
+		// a yaw about the base turns the prototype's lean into the plant's, the height gives the scale
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), plant.base);
+		transform = glm::rotate(transform, plant.yaw - prototype.yaw, glm::vec3(0, 1, 0));
+		transform = glm::scale(transform, glm::vec3((plant.max.y - plant.min.y) / prototypeHeight));
+		transforms.push_back(transform);
+	}
+	return transforms;
+}
+
+std::unique_ptr<Mesh> VegetationSource::Attached(const Mesh& other) const
+{
+	if (m_plants.empty())
+		return std::make_unique<Mesh>();
+
+	// every piece goes to the plant whose bounds are nearest to its centre
+	std::vector<unsigned int> triangles;
+	for (const Piece& piece : SplitPieces(other.getVertices(), other.getIndices()))
+	{
+		glm::vec3 centre = 0.5f * (piece.min + piece.max);
+		size_t nearest = 0;
+		float nearestDistance = std::numeric_limits<float>::max();
+		for (size_t i = 0; i < m_plants.size(); ++i)
+		{
+			float distance = glm::length(glm::max(glm::max(m_plants[i].min - centre, centre - m_plants[i].max), glm::vec3(0)));
+			if (distance < nearestDistance)
+			{
+				nearest = i;
+				nearestDistance = distance;
+			}
+		}
+		if (nearest == m_prototype)
+			triangles.insert(triangles.end(), piece.triangles.begin(), piece.triangles.end());
+	}
+	return ExtractTriangles(other.getVertices(), other.getIndices(), triangles, m_plants[m_prototype].base);
+}
+
+namespace
+{
+	// side of the cells instances are grouped into for distance based selection
+	const float CELL_SIZE = 64.0f;
+
+	float DistanceToBox(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max)
+	{
+		return glm::length(glm::max(glm::max(min - point, point - max), glm::vec3(0)));
+	}
+
+	float FarthestInBox(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max)
+	{
+		return glm::length(glm::max(glm::abs(min - point), glm::abs(max - point)));
+	}
+}
+
+VegetationLayer::VegetationLayer(std::unique_ptr<Mesh> prototype, GLuint texture)
+{
+	m_instances.SetOwner("Vegetation instances");
+	AddPart(std::move(prototype), texture);
+
+	glGenVertexArrays(1, &m_impostorVao);
+	glBindVertexArray(m_impostorVao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instances);
+	for (GLuint column = 0; column < 4; ++column)
+	{
+		glEnableVertexAttribArray(3 + column);
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(3 + column, 1);
+	}
+	glBindVertexArray(0);
+}
+
+VegetationLayer::~VegetationLayer()
+{
+	glDeleteVertexArrays(1, &m_impostorVao);
+}
+
+void VegetationLayer::AddPart(std::unique_ptr<Mesh> mesh, GLuint texture)
+{
+	// e.g. a source that found no plant; it has no buffers to draw from
+	if (mesh->getIndices().empty())
+	{
+		std::cerr << "[VegetationLayer] A part without triangles is left out" << std::endl;
+		return;
+	}
+
+	// glBufferData keeps the buffer name, so the attribute setup stays valid across SetInstances calls
+	mesh->setInstanceTransforms(m_instances);
+	m_parts.push_back({ std::move(mesh), texture });
+}
+
+void VegetationLayer::SetInstances(std::vector<glm::mat4> transforms)
+{
+	auto cellOf = [](const glm::mat4& transform)
+	{
+		return glm::ivec2(glm::floor(glm::vec2(transform[3].x, transform[3].z) / CELL_SIZE));
+	};
+	auto cellLess = [](const glm::ivec2& lhs, const glm::ivec2& rhs)
+	{
+		return lhs.y < rhs.y || (lhs.y == rhs.y && lhs.x < rhs.x);
+	};
+
+	// row by row, so that neighbouring cells of a row are neighbouring ranges of the buffer too
+	std::sort(transforms.begin(), transforms.end(), [&](const glm::mat4& lhs, const glm::mat4& rhs)
+	{
+		return cellLess(cellOf(lhs), cellOf(rhs));
+	});
+
+	m_cells.clear();
+	for (size_t i = 0; i < transforms.size(); ++i)
+	{
+		glm::vec3 origin(transforms[i][3]);
+		if (m_cells.empty() || cellOf(transforms[i]) != cellOf(transforms[m_cells.back().first]))
+			m_cells.push_back({ static_cast<GLuint>(i), 0, origin, origin });
+
+		Cell& cell = m_cells.back();
+		++cell.count;
+		cell.min = glm::min(cell.min, origin);
+		cell.max = glm::max(cell.max, origin);
+	}
+
+	m_instanceCount = static_cast<GLsizei>(transforms.size());
+	if (transforms.empty())
+		m_instances.BufferData(0, nullptr);
+	else
+		m_instances.BufferData(transforms);
+}
+
+template <typename Predicate, typename DrawRange>
+void VegetationLayer::ForEachRun(Predicate predicate, DrawRange draw) const
+{
+	GLuint first = 0;
+	GLsizei count = 0;
+	for (const Cell& cell : m_cells)
+	{
+		if (!predicate(cell))
+			continue;
+
+		if (count > 0 && first + count == cell.first)
+			count += cell.count;
+		else
+		{
+			if (count > 0)
+				draw(first, count);
+			first = cell.first;
+			count = cell.count;
+		}
+	}
+	if (count > 0)
+		draw(first, count);
+}
+
+void VegetationLayer::Draw(ProgramObject& program)
+{
+	if (m_instanceCount == 0)
+		return;
+
+	for (const Part& part : m_parts)
+	{
+		program.SetTexture("texImage", 0, part.texture);
+		part.mesh->drawInstanced(m_instanceCount);
+	}
+}
+
+void VegetationLayer::DrawNear(ProgramObject& program, const glm::vec3& eye, float maxDistance)
+{
+	for (const Part& part : m_parts)
+	{
+		program.SetTexture("texImage", 0, part.texture);
+		ForEachRun(
+			[&](const Cell& cell) { return DistanceToBox(eye, cell.min, cell.max) < maxDistance; },
+			[&](GLuint first, GLsizei count) { part.mesh->drawInstanced(count, first); });
+	}
+}
+
+void VegetationLayer::DrawImpostors(const glm::vec3& eye, float minDistance)
+{
+	if (m_parts.empty())
+		return;
+
+	glBindVertexArray(m_impostorVao);
+	ForEachRun(
+		[&](const Cell& cell) { return FarthestInBox(eye, cell.min, cell.max) > minDistance; },
+		[&](GLuint first, GLsizei count) { glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, count, first); });
+	glBindVertexArray(0);
+}
+
+void VegetationLayer::BakeImpostors(ProgramObject& bakeProgram, int viewCount, int tileSize)
+{
+	if (m_parts.empty())
+		return;
+
+	std::vector<ImpostorAtlas::Part> parts;
+	for (const Part& part : m_parts)
+		parts.push_back({ part.mesh.get(), part.texture });
+	m_impostors.Bake(parts, bakeProgram, viewCount, tileSize);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Mesh_OGL3.h"
+#include "BufferObject.h"
+#include "Impostor.h"
+
+// Instances per square unit at a point of the terrain, given its position and normal
+using VegetationDensity = std::function<float(const glm::vec3& position, const glm::vec3& normal)>;
+
+/*
+	Scatters instances over the terrain mesh. The density is evaluated on every terrain triangle, which
+	works as a density map draped over the terrain, and each triangle gets a number of instances
+	proportional to its area. Instances sit on the surface, with a random yaw and uniform scale.
+*/
+class VegetationPlacer final
+{
+public:
+	explicit VegetationPlacer(const Mesh& terrain);
+
+	std::vector<glm::mat4> Scatter(const VegetationDensity& density, float densityScale, glm::vec2 scaleRange, unsigned int seed) const;
+
+private:
+	struct Triangle
+	{
+		glm::vec3	a, b, c;
+		glm::vec3	normal;
+		float		area;
+	};
+
+	std::vector<Triangle>	m_triangles;
+};
+
+/*
+	Takes apart a mesh that was modelled with its plants in place. Triangles sharing vertices (or vertex
+	positions, across texture seams) form pieces, and pieces whose xz bounds come within margin of each other
+	form one plant. The plant of median size becomes the prototype, standing on the origin, and every plant can
+	be replaced by a transform of it that matches its base, height and the direction it leans in.
+*/
+class VegetationSource final
+{
+public:
+	VegetationSource(const Mesh& baked, float margin);
+
+	size_t PlantCount() const { return m_plants.size(); }
+
+	// without buffers, initBuffers is left to the main thread
+	std::unique_ptr<Mesh> Prototype() const;
+	// one per plant, moving the prototype to where the plant was
+	std::vector<glm::mat4> Transforms() const;
+	// the pieces of another mesh of the same plants (their leaves, say) that are closest to the prototype, in its space
+	std::unique_ptr<Mesh> Attached(const Mesh& other) const;
+
+private:
+	struct Plant
+	{
+		std::vector<unsigned int>	triangles;		// offsets of the first index
+		glm::vec3					min, max;
+		glm::vec3					base;			// centre of the lowest vertices, at the lowest height
+		float						yaw;			// of the lean from base to top, 0 if upright
+	};
+
+	std::vector<Mesh::Vertex>	m_vertices;
+	std::vector<unsigned int>	m_indices;
+	std::vector<Plant>			m_plants;
+	size_t						m_prototype = 0;
+};
+
+/*
+	One prototype mesh drawn once per transform in its instance buffer with glDrawElementsInstanced.
+	Raising the density only grows the instance buffer (a mat4 per instance), never the geometry. A prototype
+	made of several textured parts (trunk and leaves) draws each part with the same instances.
+
+	The instances are sorted into square cells of the xz plane, so that the ones near to or far from the
+	eye can be drawn as a few contiguous instance ranges: geometry up close, impostors in the distance.
+*/
+class VegetationLayer final
+{
+public:
+	// the meshes' buffers must be initialised; meshes without triangles are left out, a layer without parts draws nothing
+	VegetationLayer(std::unique_ptr<Mesh> prototype, GLuint texture);
+	~VegetationLayer();
+
+	VegetationLayer(const VegetationLayer&)				= delete;
+	VegetationLayer& operator=(const VegetationLayer&)	= delete;
+
+	// one more mesh in the prototype's space, drawn with its own texture
+	void AddPart(std::unique_ptr<Mesh> mesh, GLuint texture);
+
+	void SetInstances(std::vector<glm::mat4> transforms);
+
+	// every instance as geometry, the parts' textures are bound to texImage of the program in use
+	void Draw(ProgramObject& program);
+	// geometry of the cells that have instances closer than maxDistance
+	void DrawNear(ProgramObject& program, const glm::vec3& eye, float maxDistance);
+	// impostor quads of the cells that have instances farther than minDistance
+	void DrawImpostors(const glm::vec3& eye, float minDistance);
+
+	void BakeImpostors(ProgramObject& bakeProgram, int viewCount, int tileSize);
+	const ImpostorAtlas& Impostors() const { return m_impostors; }
+
+	GLsizei InstanceCount() const { return m_instanceCount; }
+
+private:
+	struct Cell
+	{
+		GLuint		first;
+		GLsizei		count;
+		glm::vec3	min, max;	// bounds of the instance origins
+	};
+
+	// calls draw(first, count) for the runs of consecutive cells accepted by the predicate
+	template <typename Predicate, typename DrawRange>
+	void ForEachRun(Predicate predicate, DrawRange draw) const;
+
+	struct Part
+	{
+		std::unique_ptr<Mesh>	mesh;
+		GLuint					texture;
+	};
+
+	std::vector<Part>		m_parts;
+	// respecified by SetInstances whenever the density changes
+	BufferObject<BufferType::Array, BufferUsage::DynamicDraw>	m_instances;
+	GLsizei					m_instanceCount = 0;
+	std::vector<Cell>		m_cells;
+
+	// no vertex data, only the instance transforms: impostor.vert builds the quad from gl_VertexID
+	GLuint					m_impostorVao = 0;
+	ImpostorAtlas			m_impostors;
+};
@@ -1,8 +1,13 @@
 #include "VertexArrayObject.h"
 
+#include "GpuResources.h"
+
 VertexArrayObject::VertexArrayObject()
 {
-	glGenVertexArrays(1, &m_id);
+	if (GpuResources::DirectStateAccess())
+		glCreateVertexArrays(1, &m_id);
+	else
+		glGenVertexArrays(1, &m_id);
 }
 
 VertexArrayObject::~VertexArrayObject()
@@ -47,24 +52,54 @@ void VertexArrayObject::Unbind()
 
 VertexArrayObject& VertexArrayObject::SetIndices(const IndexBuffer& pIndexBuffer)
 {
+	if (GpuResources::DirectStateAccess())
+	{
+		glVertexArrayElementBuffer(m_id, pIndexBuffer);
+		return *this;
+	}
+
 	Bind();
 	pIndexBuffer.Bind();
 	return *this;
 }
 
-void VertexArrayObject::Init(std::initializer_list<std::pair<AttributeData, const ArrayBuffer&>> pDataBuffers)
+VertexArrayObject& VertexArrayObject::SetAttribDivisor(GLuint pIndex, GLuint pDivisor)
 {
+	// every attribute has the vertex buffer binding of its own index, so this is the attribute's divisor
+	if (GpuResources::DirectStateAccess())
+	{
+		glVertexArrayBindingDivisor(m_id, pIndex, pDivisor);
+		return *this;
+	}
+
 	Bind();
-	for (auto val : pDataBuffers)
+	glVertexAttribDivisor(pIndex, pDivisor);
+	return *this;
+}
+
+VertexArrayObject& VertexArrayObject::AddAttribute(const AttributeData& pAttrib, GLuint pBuffer)
+{
+	if (GpuResources::DirectStateAccess())
 	{
-		val.second.Bind();
-		val.first.Apply();
+		pAttrib.Apply(m_id, pBuffer);
+		return *this;
 	}
+
+	Bind();
+	glBindBuffer(GL_ARRAY_BUFFER, pBuffer);
+	pAttrib.Apply();
+	return *this;
+}
+
+void VertexArrayObject::Init(std::initializer_list<std::pair<AttributeData, const ArrayBuffer&>> pDataBuffers)
+{
+	for (auto val : pDataBuffers)
+		AddAttribute(val.first, static_cast<GLuint>(val.second));
 }
 
 void VertexArrayObject::Init(std::initializer_list<std::pair<AttributeData, const ArrayBuffer&>> pDataBuffers, const IndexBuffer& pIndexBuffer)
 {
 	Init(pDataBuffers);
-	pIndexBuffer.Bind();
+	SetIndices(pIndexBuffer);
 	Unbind();
 }
\ No newline at end of file
@@ -14,12 +14,22 @@ struct AttributeData
 	AttributeData(GLuint pIndex, GLint pSize, GLenum pType, GLboolean pNormalized, GLsizei pStride, void* pPtr) : index(pIndex), size(pSize), type(pType), normalized(pNormalized), stride(pStride), ptr(pPtr) 
 	{ }
 
-	void Apply()
+	void Apply() const
 	{
 		glEnableVertexAttribArray(index);
 		glVertexAttribPointer(index, size, type, normalized, stride, ptr);
 	}
 
+	// direct state access: the attribute reads the vertex buffer binding of the same index, which gets the buffer
+	// at offset ptr; unlike glVertexAttribPointer, stride 0 does not mean tightly packed here
+	void Apply(GLuint vao, GLuint buffer) const
+	{
+		glEnableVertexArrayAttrib(vao, index);
+		glVertexArrayAttribFormat(vao, index, size, type, normalized, 0);
+		glVertexArrayAttribBinding(vao, index, index);
+		glVertexArrayVertexBuffer(vao, index, buffer, reinterpret_cast<GLintptr>(ptr), stride);
+	}
+
 	GLuint		index{};
 	GLint		size{};
 	GLenum		type{};
@@ -42,6 +52,10 @@ AttributeData CreateAttribute(size_t pOffsetInBytes = 0, GLsizei pStrideInBytes
 */
 
 
+/*
+	With direct state access (GL 4.5) the array is edited by name, so setting it up binds nothing. Otherwise it
+	is bound to be edited and left bound.
+*/
 class VertexArrayObject final
 {
 public:
@@ -65,9 +79,14 @@ public:
 
 	template <BufferType type, BufferUsage usage>
 	VertexArrayObject& AddAttribute(AttributeData&, BufferObject<type, usage>&);
+	// for buffers not wrapped in a BufferObject
+	VertexArrayObject& AddAttribute(const AttributeData&, GLuint buffer);
 
 	VertexArrayObject& SetIndices(const IndexBuffer&);
 
+	// 0: the attribute advances per vertex, n: it advances once every n instances
+	VertexArrayObject& SetAttribDivisor(GLuint pIndex, GLuint pDivisor);
+
 private:
 	GLuint m_id = 0;
 };
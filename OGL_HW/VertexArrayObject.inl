@@ -1,8 +1,5 @@
 template<BufferType type, BufferUsage usage>
 inline VertexArrayObject & VertexArrayObject::AddAttribute(AttributeData& pAttrib, BufferObject<type, usage>& pBuffer)
 {
-	pBuffer.Bind();
-	pAttrib.Apply();
-
-	return *this;
+	return AddAttribute(pAttrib, static_cast<GLuint>(pBuffer));
 }
\ No newline at end of file
@@ -1,19 +1,40 @@
-#version 130
+#version 400
+
+#ifdef LIGHTS_FROM_SSBO
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
 
 in vec2 vs_out_tex;
 
 out vec4 fs_out_col;
 
-uniform vec3 eye_pos;
+#include "frame_uniforms.glsl"
 
 uniform sampler2D colorTexture;
 uniform sampler2D normalTexture;
 uniform sampler2D positionTexture;
 uniform sampler2D materialTexture;
 
-uniform vec3 lightPositions[100];
-uniform float lightStrengths[100];
-uniform vec3 lightColors[100];
+#include "light_markers.glsl"
+
+// NUM_POINT_LIGHTS is injected by the host
+#ifdef LIGHTS_FROM_SSBO
+// the light marker buffer, animated on the GPU
+layout(std430, binding = 0) readonly buffer LightMarkers
+{
+	LightMarker lights[];
+};
+#else
+// the markers written by the CPU this frame, a range of the stream buffer
+layout(std140) uniform PointLights
+{
+	LightMarker lights[NUM_POINT_LIGHTS];
+};
+#endif
+
+#define LIGHT_POSITION(i)	lights[i].position
+#define LIGHT_STRENGTH(i)	lights[i].radius
+#define LIGHT_COLOR(i)		lights[i].color
 
 void main()
 {
@@ -30,16 +51,16 @@ void main()
 		vec3 normal = normalize(normalTex);
 		vec4 material = texture(materialTexture, vs_out_tex);
 
-		for (int i = 0; i < 100; ++i)
+		for (int i = 0; i < NUM_POINT_LIGHTS; ++i)
 		{
-			vec3 toLight = lightPositions[i] - pos;
-			float unscaledStrength = lightStrengths[i]; 
+			vec3 toLight = LIGHT_POSITION(i) - pos;
+			float unscaledStrength = LIGHT_STRENGTH(i); 
 			float strength = unscaledStrength * unscaledStrength * unscaledStrength * 50.0f / (length(toLight) * length(toLight));
 			if (strength > 0.02f)
 			{
-				vec4 La = vec4(0.5 * normalize(lightColors[i]), 1.0f);
-				vec4 Ld = vec4(0.8 * normalize(lightColors[i]), 1.0f);
-				vec4 Ls = vec4(0.6 * normalize(lightColors[i]), 1.0f);
+				vec4 La = vec4(0.5 * normalize(LIGHT_COLOR(i)), 1.0f);
+				vec4 Ld = vec4(0.8 * normalize(LIGHT_COLOR(i)), 1.0f);
+				vec4 Ls = vec4(0.6 * normalize(LIGHT_COLOR(i)), 1.0f);
 				
 				toLight = normalize(toLight);
 
@@ -1,11 +1,10 @@
-#version 130
+#version 400
 
 in vec2 vs_out_tex;
 
 out vec4 fs_out_col;
 
-uniform vec3 eye_pos;
-uniform mat4 shadowVP;
+#include "frame_uniforms.glsl"
 
 uniform sampler2D colorTexture;
 uniform sampler2D normalTexture;
@@ -33,36 +32,44 @@ void main()
 		vec3 normal = normalize(normalTex);
 		vec4 material = texture(materialTexture, vs_out_tex);
 
-		vec4 lightspace_pos = shadowVP * vec4(pos, 1);
+		// without ENABLE_SHADOWS the shadow map is neither rendered nor sampled
+		bool lit = true;
+#ifdef ENABLE_SHADOWS
+		vec4 lightspace_pos = lightViewProj * vec4(pos, 1);
 		vec3 lightCoords = (0.5 * lightspace_pos.xyz + 0.5) / lightspace_pos.w;
 		vec2 lightuv = lightCoords.xy;
 
-		if (lightuv == clamp(lightuv, 0, 1))
+		// outside of the shadow map the light has no effect
+		if (lightuv != clamp(lightuv, 0, 1))
 		{
-			float fromLightDepth = texture(shadowDepthTexture, lightuv).x;
-		
-			ambient += La * vec4(material.r);
+			fs_out_col = vec4(0);
+			return;
+		}
 
-			if (fromLightDepth + 0.01 >= lightCoords.z)
-			{		
-		
-				float di = clamp(dot(toLight, normal), 0.0f, 1.0f);
-				diffuse += vec4(di * Ld.rgb * vec3(material.g), material.g);
-		
-				if (di > 0.0f)
-				{
-					vec3 toEye = normalize(eye_pos - pos);
-					vec3 r = reflect(-toLight, normal);
-					float si = pow(clamp(dot(toEye, r), 0.0f, 1.0f), material.a);
-					specular += Ls * vec4(material.b) * si;
-				}
+		float fromLightDepth = texture(shadowDepthTexture, lightuv).x;
+		lit = fromLightDepth + 0.01 >= lightCoords.z;
+#endif
 
-				fs_out_col = (ambient + diffuse + specular) * baseCol;
-			}
-			else
+		ambient += La * vec4(material.r);
+
+		if (lit)
+		{		
+			float di = clamp(dot(toLight, normal), 0.0f, 1.0f);
+			diffuse += vec4(di * Ld.rgb * vec3(material.g), material.g);
+		
+			if (di > 0.0f)
 			{
-				fs_out_col = ambient * baseCol;
+				vec3 toEye = normalize(eye_pos - pos);
+				vec3 r = reflect(-toLight, normal);
+				float si = pow(clamp(dot(toEye, r), 0.0f, 1.0f), material.a);
+				specular += Ls * vec4(material.b) * si;
 			}
+
+			fs_out_col = (ambient + diffuse + specular) * baseCol;
+		}
+		else
+		{
+			fs_out_col = ambient * baseCol;
 		}
 	}
 	else
@@ -0,0 +1,8 @@
+// 4x4 ordered dither threshold in (0, 1) for the current pixel. Geometry keeps the pixels where
+// fade <= threshold and the impostor the rest, so during the fade they never overlap or leave holes.
+float DitherThreshold()
+{
+	const float bayer[16] = float[16](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+	ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+	return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+}
@@ -3,10 +3,17 @@
 layout(location = 0) in vec3 vs_in_pos;
 layout(location = 1) in vec3 vs_in_normal;
 layout(location = 2) in vec2 vs_in_tex0;
+#ifdef INSTANCED
+// per instance transform of the vegetation (rotation and uniform scale only, so it also transforms the normals)
+layout(location = 3) in mat4 vs_in_world;
+#endif
 
 out vec3 vs_out_pos;
 out vec3 vs_out_normal;
 out vec2 vs_out_tex0;
+#ifdef INSTANCED
+flat out float vs_out_fade;
+#endif
 
 uniform mat4 world = mat4(1, 0, 0, 0,
 						  0, 1, 0, 0,
@@ -16,13 +23,28 @@ uniform mat4 worldIT = mat4(1, 0, 0, 0,
 						    0, 1, 0, 0,
 						    0, 0, 1, 0, 
 						    0, 0, 0, 1);
-uniform mat4 MVP;
+
+#include "frame_uniforms.glsl"
+#include "impostor_fade.glsl"
+
+// has to match the depth pre-pass (shadow_map.vert with DEPTH_PREPASS) bit for bit
+invariant gl_Position;
 
 void main()
 {
-	gl_Position = MVP * vec4(vs_in_pos, 1);
+#ifdef INSTANCED
+	mat4 model = vs_in_world;
+	mat4 modelIT = vs_in_world;
+#else
+	mat4 model = world;
+	mat4 modelIT = worldIT;
+#endif
+	gl_Position = viewProj * (model * vec4(vs_in_pos, 1));
 
-	vs_out_pos = (world * vec4(vs_in_pos, 1)).xyz;
-	vs_out_normal  = (worldIT * vec4(vs_in_normal, 0)).xyz;
+	vs_out_pos = (model * vec4(vs_in_pos, 1)).xyz;
+	vs_out_normal  = (modelIT * vec4(vs_in_normal, 0)).xyz;
 	vs_out_tex0 = vs_in_tex0;
+#ifdef INSTANCED
+	vs_out_fade = ImpostorFade(vs_in_world[3].xyz);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+// Per-frame constants shared by every program, see PerFrameUniforms in UniformBlocks.h
+layout(std140) uniform PerFrame
+{
+	mat4	view;
+	mat4	proj;
+	mat4	viewProj;
+	mat4	lightViewProj;
+	vec3	eye_pos;
+	float	time;
+	vec2	viewport_size;
+	vec2	target_scale;
+};
@@ -1,5 +1,9 @@
 #version 400
 
+// Fullscreen quad drawn as a 4 vertex triangle strip without any vertex buffer, shared by the deferred light passes
+
+#include "frame_uniforms.glsl"
+
 vec4 positions[4] = vec4[4](
 	vec4(-1,-1, 0, 1),
 	vec4( 1,-1, 0, 1),
@@ -19,5 +23,6 @@ out vec2 vs_out_tex;
 void main()
 {
 	gl_Position = positions[gl_VertexID];
-	vs_out_tex	= texCoords[gl_VertexID];
+	// the G-buffer only covers the lower left part of its textures
+	vs_out_tex	= texCoords[gl_VertexID] * target_scale;
 }
\ No newline at end of file
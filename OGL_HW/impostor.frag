@@ -0,0 +1,45 @@
+#version 400
+
+in block
+{
+	vec3		pos;
+	vec2		tex;
+	flat mat3	rotation;
+	flat float	fade;
+} In;
+
+// the same targets as forward.frag
+layout(location=0) out vec4 fs_out_color;
+layout(location=1) out vec3 fs_out_normal;
+layout(location=2) out vec4 fs_out_position;
+layout(location=3) out vec4 fs_out_material;
+
+layout(std140) uniform PerMaterial
+{
+	float	Ka;
+	float	Kd;
+	float	Ks;
+	float	specular_power;
+};
+
+uniform sampler2D color_atlas;
+uniform sampler2D normal_atlas;
+uniform uint opacity = 255;
+
+#include "dither.glsl"
+
+void main()
+{
+	// near instances are still drawn as geometry
+	if (In.fade <= DitherThreshold())
+		discard;
+
+	vec4 color = texture(color_atlas, In.tex);
+	if (color.a < 0.5)
+		discard;
+
+	fs_out_color = vec4(color.rgb, opacity);
+	fs_out_normal = normalize(In.rotation * texture(normal_atlas, In.tex).xyz);
+	fs_out_position = vec4(In.pos, 1);
+	fs_out_material = vec4(Ka, Kd, Ks, specular_power);
+}
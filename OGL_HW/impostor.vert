@@ -0,0 +1,55 @@
+#version 400
+
+// per instance transform, the same buffer the geometry is drawn from
+layout(location = 3) in mat4 vs_in_world;
+
+out block
+{
+	vec3		pos;
+	vec2		tex;
+	flat mat3	rotation;
+	flat float	fade;
+} Out;
+
+#include "frame_uniforms.glsl"
+#include "impostor_fade.glsl"
+
+// atlas layout and the prototype's bounds it was baked with, see ImpostorAtlas
+uniform int view_count;
+uniform float bounds_radius;
+uniform vec2 bounds_height;
+
+const float PI = 3.14159265;
+
+void main()
+{
+	// the four corners of the quad as a triangle strip
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+	vec3 center = vs_in_world[3].xyz;
+	float scale = length(vs_in_world[0].xyz);
+	mat3 rotation = mat3(vs_in_world) / scale;
+
+	// straight above the instance the horizontal direction to the eye vanishes; the quad is seen edge on
+	// there whichever way it faces, so it takes the instance's own x axis as its right instead of NaN
+	vec3 toEye = eye_pos - center;
+	vec3 flatToEye = vec3(toEye.x, 0, toEye.z);
+	if (dot(flatToEye, flatToEye) < 1e-6)
+		flatToEye = cross(rotation[0], vec3(0, 1, 0));
+
+	// the baked view closest to the direction the instance is seen from
+	vec3 localToEye = transpose(rotation) * flatToEye;
+	float yaw = atan(localToEye.x, localToEye.z);
+	float view = mod(round(yaw / (2 * PI) * view_count), float(view_count));
+
+	// upright quad turned towards the eye, laid out like the baking camera's image plane
+	vec3 up = vec3(0, 1, 0);
+	vec3 right = normalize(cross(-flatToEye, up));
+	vec3 pos = center + scale * (right * bounds_radius * (2 * corner.x - 1) + up * mix(bounds_height.x, bounds_height.y, corner.y));
+	gl_Position = viewProj * vec4(pos, 1);
+
+	Out.pos			= pos;
+	Out.tex			= vec2((view + corner.x) / view_count, corner.y);
+	Out.rotation	= rotation;
+	Out.fade		= ImpostorFade(center);
+}
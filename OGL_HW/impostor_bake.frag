@@ -0,0 +1,17 @@
+#version 400
+
+in vec3 vs_out_normal;
+in vec2 vs_out_tex0;
+
+// same meaning as the G-buffer's first two targets, alpha marks the covered texels
+layout(location=0) out vec4 fs_out_color;
+layout(location=1) out vec4 fs_out_normal;
+
+uniform sampler2D texImage;
+
+void main()
+{
+	fs_out_color = vec4(texture(texImage, vs_out_tex0.st).xyz, 1);
+	// prototype space, the impostor rotates it with its instance
+	fs_out_normal = vec4(normalize(vs_out_normal), 1);
+}
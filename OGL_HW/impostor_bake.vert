@@ -0,0 +1,19 @@
+#version 400
+
+layout(location = 0) in vec3 vs_in_pos;
+layout(location = 1) in vec3 vs_in_normal;
+layout(location = 2) in vec2 vs_in_tex0;
+
+out vec3 vs_out_normal;
+out vec2 vs_out_tex0;
+
+// orthographic view of one atlas tile, in the prototype's own space
+uniform mat4 bake_view_proj;
+
+void main()
+{
+	gl_Position = bake_view_proj * vec4(vs_in_pos, 1);
+
+	vs_out_normal = vs_in_normal;
+	vs_out_tex0 = vs_in_tex0;
+}
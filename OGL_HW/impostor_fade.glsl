@@ -0,0 +1,12 @@
+// Distance based cross-fade between vegetation geometry and its impostors, needs eye_pos from frame_uniforms.glsl.
+// The defaults never fade, so programs that do not set them always draw the geometry.
+uniform float impostor_fade_start = 1e20;
+uniform float impostor_fade_end = 2e20;
+
+// 0: full geometry, 1: full impostor. Computed the same way in every program, so the depth pre-pass
+// and the G-buffer pass agree on which pixels are kept.
+float ImpostorFade(vec3 instancePos)
+{
+	precise float fade = smoothstep(impostor_fade_start, impostor_fade_end, distance(eye_pos, instancePos));
+	return fade;
+}
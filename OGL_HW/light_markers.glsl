@@ -0,0 +1,9 @@
+// One light as stored in the light marker buffer, see LightMarker in MyApp.h.
+// In std430 and std140 a vec3 followed by a float shares one 16 byte slot, so the 32 byte host struct matches.
+struct LightMarker
+{
+	vec3	position;
+	float	radius;		// the light's strength
+	vec3	color;
+	float	padding;
+};
@@ -14,21 +14,85 @@
 #include <sstream>
 
 #include "MyApp.h"
+#include "CpuProfiler.h"
+#include "Benchmark.h"
+#include "GpuResources.h"
+#include "JobSystem.h"
+#include "AllocationCounter.h"
+
+// Where the CPU zones are dumped (F9, and on exit)
+static const char* const CPU_TRACE_FILE = "cpu_trace.json";
 
 // Starting window size
 static const int INIT_WIDTH = 640;
 static const int INIT_HEIGHT = 480;
 
+// Benchmark runs exit without waiting for a key press
+static bool waitForKeyOnExit = true;
+
 // This switches to dedicated graphics card on some laptops
 extern "C"
 {
 	__declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001;
 }
 
+// Colour, depth and profile of the context, set before every window creation
+static void SetContextAttributes()
+{
+	// 2a: Start-up configuration of OpenGL, this has to be done before the creation of any window
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+	// Set the color depth (how many bits do we want to store red, green, blue and alpha(transparency) properties per pixel)
+    SDL_GL_SetAttribute(SDL_GL_BUFFER_SIZE,         32);
+    SDL_GL_SetAttribute(SDL_GL_RED_SIZE,            8);
+    SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE,          8);
+    SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE,           8);
+    SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE,          8);
+	// Double buffering
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER,		1);
+	// Size of depth buffer in bits
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE,          24);
+
+	// Antialiasing - if needed
+	//SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS,  1);
+	//SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES,  2);
+}
+
+// Benchmarks need no display: SDL's offscreen video driver (SDL 2.0.12 and later) renders into an EGL pbuffer,
+// without X11, Wayland or a desktop session. GLEW has to be built to load through EGL too. If anything is
+// missing, video is shut down again and false returned, so that the caller can open a hidden window instead.
+// The driver is picked by name, the environment (and the user's SDL_VIDEODRIVER) is left alone
+static bool CreateOffscreenContext(int width, int height, SDL_Window*& win, SDL_GLContext& context)
+{
+	if (SDL_VideoInit("offscreen") == 0)
+	{
+		SetContextAttributes();
+		win = SDL_CreateWindow("OGL_HW benchmark", 0, 0, width, height, SDL_WINDOW_OPENGL);
+		context = win != 0 ? SDL_GL_CreateContext(win) : 0;
+		if (context != 0 && glewInit() == GLEW_OK)
+		{
+			std::cout << "Rendering offscreen into an EGL pbuffer" << std::endl;
+			return true;
+		}
+	}
+
+	std::cout << "[Offscreen] No EGL context (" << SDL_GetError() << "), falling back to a hidden window" << std::endl;
+	if (context != 0)
+		SDL_GL_DeleteContext(context);
+	if (win != 0)
+		SDL_DestroyWindow(win);
+	context = 0;
+	win = 0;
+	SDL_VideoQuit();
+	return false;
+}
+
 void exitProgram()
 {
 	SDL_Quit();
 
+	if (!waitForKeyOnExit)
+		return;
 	std::cout << "Press a button to exit..." << std::endl;
 	std::cin.get();
 }
@@ -38,6 +102,27 @@ int main( int argc, char* args[] )
 	// By this setting, the system will call exitProgram before this process terminates
 	// Question: What would happen without this?
 	atexit( exitProgram );
+	CpuProfiler::SetThreadName("main");
+
+	BenchmarkOptions benchmark;
+	if (!ParseBenchmarkOptions(argc, args, benchmark))
+		return 1;
+	waitForKeyOnExit = !benchmark.enabled;
+	if (benchmark.jobBenchmark)
+	{
+		waitForKeyOnExit = false;
+		return JobSystem::RunScalingBenchmark(std::cout) ? 0 : 1;
+	}
+	int width = benchmark.enabled ? benchmark.width : INIT_WIDTH;
+	int height = benchmark.enabled ? benchmark.height : INIT_HEIGHT;
+	CameraPath cameraPath = CameraPath::Default();
+	if (!benchmark.cameraPath.empty() && !cameraPath.LoadFromFile(benchmark.cameraPath))
+		return 1;
+
+	// A benchmark renders without a window if it can, the steps below are skipped then
+	SDL_Window *win = 0;
+	SDL_GLContext context = 0;
+	const bool offscreen = benchmark.enabled && CreateOffscreenContext(width, height, win, context);
 
 	//
 	// Step 1: initialize SDL
@@ -45,7 +130,7 @@ int main( int argc, char* args[] )
 
 	// Turn on the graphical subsystem
 	// If there is an error, notify and exit
-	if ( SDL_Init( SDL_INIT_VIDEO ) == -1 )
+	if ( !offscreen && SDL_Init( SDL_INIT_VIDEO ) == -1 )
 	{
 		// Print the error and terminate
 		std::cout << "[SDL start]Error during the initialization of SDL: " << SDL_GetError() << std::endl;
@@ -56,32 +141,17 @@ int main( int argc, char* args[] )
 	// Step 2: set OpenGL requirements, create our window, start OpenGL
 	//
 
-	// 2a: Start-up configuration of OpenGL, this has to be done before the creation of any window
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-
-	// Set the color depth (how many bits do we want to store red, green, blue and alpha(transparency) properties per pixel)
-    SDL_GL_SetAttribute(SDL_GL_BUFFER_SIZE,         32);
-    SDL_GL_SetAttribute(SDL_GL_RED_SIZE,            8);
-    SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE,          8);
-    SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE,           8);
-    SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE,          8);
-	// Double buffering
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER,		1);
-	// Size of depth buffer in bits
-    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE,          24);
-
-	// Antialiasing - if needed
-	//SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS,  1);
-	//SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES,  2);
-
-	// Create our window
-	SDL_Window *win = 0;
-    win = SDL_CreateWindow( "Hello SDL&OpenGL!",		// az ablak fejlce
-							100,						// az ablak bal-fels sarknak kezdeti X koordintja
-							100,						// az ablak bal-fels sarknak kezdeti Y koordintja
-							INIT_WIDTH,					// ablak szlessge
-							INIT_HEIGHT,				// s magassga
-							SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);			// megjelentsi tulajdonsgok
+	// Create our window, unless the benchmark renders offscreen
+	if (!offscreen)
+	{
+		SetContextAttributes();
+		win = SDL_CreateWindow( "Hello SDL&OpenGL!",		// az ablak fejlce
+								100,						// az ablak bal-fels sarknak kezdeti X koordintja
+								100,						// az ablak bal-fels sarknak kezdeti Y koordintja
+								width,						// ablak szlessge
+								height,						// s magassga
+								SDL_WINDOW_OPENGL | (benchmark.enabled ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE));			// megjelentsi tulajdonsgok
+	}
 
 
 	// If the window creation failed, print the error and exit
@@ -95,18 +165,16 @@ int main( int argc, char* args[] )
 	// Step 3: Create the OpenGL context: we will draw using this
 	//
 
-	SDL_GLContext	context	= SDL_GL_CreateContext(win);
+	if (!offscreen)
+		context = SDL_GL_CreateContext(win);
     if (context == 0)
 	{
 		std::cout << "[OGL context creation]Error during the initialization of SDL: " << SDL_GetError() << std::endl;
         return 1;
     }	
 
-	// Display: wait for vertical sync
-	SDL_GL_SetSwapInterval(1);
-
-	// Start GLEW
-	GLenum error = glewInit();
+	// Start GLEW, the offscreen context did already
+	GLenum error = offscreen ? GLEW_OK : glewInit();
 	if ( error != GLEW_OK )
 	{
 		std::cout << "[GLEW] Error during the initialization!" << std::endl;
@@ -140,14 +208,18 @@ int main( int argc, char* args[] )
 	//
 	// Step 4: Start the event loop
 	// 
+	int exitCode = 0;
 	{
 		// Should the program end?
 		bool quit = false;
 		// Event to be processed
 		SDL_Event ev;
 
+		// The calling thread is the job system's main thread, the GL jobs queued for it run at the start of every frame
+		JobSystem jobs(benchmark.workerThreads);
+
 		// Instance of the application
-		CMyApp app(INIT_WIDTH, INIT_HEIGHT);
+		CMyApp app(width, height, jobs, benchmark.seed);
 		if (!app.Init())
 		{
 			SDL_GL_DeleteContext(context);
@@ -156,63 +228,147 @@ int main( int argc, char* args[] )
 			return 1;
 		}
 
+		// Benchmark: a fixed timestep and a camera path make every run render the same frames,
+		// and the profiler waits for late GPU results so that no frame is missing from the report
+		BenchmarkReport report(benchmark);
+		uint64_t frameNumber = 0;
+		if (benchmark.enabled)
+		{
+			app.SetFixedTimestep(benchmark.timestep);
+			app.SetCameraPath(&cameraPath);
+			app.GetGpuProfiler().SetWaitForResults(true);
+			app.GetGpuProfiler().SetFrameListener([&report](uint64_t frame, double ms) { report.AddGpuTime(frame, ms); });
+		}
+
+		// Display: wait for vertical sync, except when benchmarking; the pacer keeps the driver from queueing frames up
+		FramePacer& pacer = app.GetFramePacer();
+		FramePacer::Settings pacing;
+		pacing.swapMode = benchmark.swapMode >= 0 ? static_cast<SwapMode>(benchmark.swapMode) : (benchmark.enabled ? SwapMode::Immediate : SwapMode::Vsync);
+		pacing.framesInFlight = benchmark.framesInFlight;
+		pacing.frameCap = benchmark.frameCap;
+		pacer.Apply(pacing);
+		if (benchmark.enabled)
+			pacer.SetFrameListener([&report](uint64_t frame, double frameMs, double latencyMs) { report.AddPacing(frame, frameMs, latencyMs); });
+
+		// From here on the next frame is simulated while the current one is rendered
+		app.SetSimulationThread(!benchmark.serialUpdate);
+
 		while (!quit)
 		{
+			CPU_ZONE("Frame");
+			// waits for the GPU before the input is read, not after
+			pacer.BeginFrame();
+			uint64_t frameBegin = CpuProfiler::Now();
+			uint64_t allocationsBegin = AllocationCounter::Now().allocations;
+
 			// While there is an event to process, process all of them
-			while (SDL_PollEvent(&ev))
 			{
-				ImGui_ImplSdlGL3_ProcessEvent(&ev);
-				bool is_mouse_captured = ImGui::GetIO().WantCaptureMouse; // Do we need mouse for imgui?
-				bool is_keyboard_captured = ImGui::GetIO().WantCaptureKeyboard;	// Do we need keyboard for imgui?
-				switch (ev.type)
+				CPU_ZONE("SDL_PollEvent");
+				while (SDL_PollEvent(&ev))
 				{
-				case SDL_QUIT:
-					quit = true;
-					break;
-				case SDL_KEYDOWN:
-					if (ev.key.keysym.sym == SDLK_ESCAPE)
-						quit = true;
-					if (!is_keyboard_captured)
-						app.KeyboardDown(ev.key);
-					break;
-				case SDL_KEYUP:
-					if (!is_keyboard_captured)
-						app.KeyboardUp(ev.key);
-					break;
-				case SDL_MOUSEBUTTONDOWN:
-					if (!is_mouse_captured)
-						app.MouseDown(ev.button);
-					break;
-				case SDL_MOUSEBUTTONUP:
-					if (!is_mouse_captured)
-						app.MouseUp(ev.button);
-					break;
-				case SDL_MOUSEWHEEL:
-					if (!is_mouse_captured)
-						app.MouseWheel(ev.wheel);
-					break;
-				case SDL_MOUSEMOTION:
-					if (!is_mouse_captured)
-						app.MouseMove(ev.motion);
-					break;
-				case SDL_WINDOWEVENT:
-					if (ev.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+					ImGui_ImplSdlGL3_ProcessEvent(&ev);
+					bool is_mouse_captured = ImGui::GetIO().WantCaptureMouse; // Do we need mouse for imgui?
+					bool is_keyboard_captured = ImGui::GetIO().WantCaptureKeyboard;	// Do we need keyboard for imgui?
+					switch (ev.type)
 					{
-						app.Resize(ev.window.data1, ev.window.data2);
+					case SDL_QUIT:
+						quit = true;
+						break;
+					case SDL_KEYDOWN:
+						if (ev.key.keysym.sym == SDLK_ESCAPE)
+							quit = true;
+						if (ev.key.keysym.sym == SDLK_F9 && CpuProfiler::WriteChromeTrace(CPU_TRACE_FILE))
+							std::cout << "CPU trace written to " << CPU_TRACE_FILE << std::endl;
+						if (ev.key.keysym.sym == SDLK_F10)
+							GpuResources::Dump(std::cout);
+						if (!is_keyboard_captured)
+							app.KeyboardDown(ev.key);
+						break;
+					case SDL_KEYUP:
+						if (!is_keyboard_captured)
+							app.KeyboardUp(ev.key);
+						break;
+					case SDL_MOUSEBUTTONDOWN:
+						if (!is_mouse_captured)
+							app.MouseDown(ev.button);
+						break;
+					case SDL_MOUSEBUTTONUP:
+						if (!is_mouse_captured)
+							app.MouseUp(ev.button);
+						break;
+					case SDL_MOUSEWHEEL:
+						if (!is_mouse_captured)
+							app.MouseWheel(ev.wheel);
+						break;
+					case SDL_MOUSEMOTION:
+						if (!is_mouse_captured)
+							app.MouseMove(ev.motion);
+						break;
+					case SDL_WINDOWEVENT:
+						if (ev.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+						{
+							app.Resize(ev.window.data1, ev.window.data2);
+						}
+						break;
 					}
-					break;
-				}
 
+				}
+				app.SetInputTime(CpuProfiler::Now());
 			}
 			ImGui_ImplSdlGL3_NewFrame(win); //After this we can call imgui commands until ImGui::Render()
 
-			app.Update();
-			app.Render();
-			ImGui::Render();
+			// reference images of a benchmark run, read back without stalling the measured frames
+			if (benchmark.enabled && benchmark.captureInterval > 0 && frameNumber >= static_cast<uint64_t>(benchmark.warmupFrames)
+				&& (frameNumber - benchmark.warmupFrames) % benchmark.captureInterval == 0)
+				app.RequestCapture("benchmark_" + std::to_string(frameNumber - benchmark.warmupFrames) + ".tga");
+
+			app.GetGpuProfiler().BeginFrame();
+			{
+				CPU_ZONE("JobSystem::RunMainThreadJobs");
+				jobs.RunMainThreadJobs();
+			}
+			if (!app.HasSimulationThread())
+			{
+				CPU_ZONE("CMyApp::Update");
+				app.Update();
+			}
+			{
+				CPU_ZONE("CMyApp::Render");
+				app.Render();
+			}
+			{
+				CPU_ZONE("ImGui::Render");
+				GpuProfiler::Scope scope(app.GetGpuProfiler(), "ImGui");
+				ImGui::Render();
+			}
+			app.GetGpuProfiler().EndFrame();
+
+			if (benchmark.enabled)
+			{
+				// CPU time of the frame's work, without the wait in the swap
+				report.AddCpuTime(frameNumber, (CpuProfiler::Now() - frameBegin) / 1e6);
+				report.AddAllocations(frameNumber, AllocationCounter::Now().allocations - allocationsBegin);
+				if (++frameNumber == static_cast<uint64_t>(benchmark.warmupFrames + benchmark.frames))
+					quit = true;
+			}
 
+			CPU_ZONE("SDL_GL_SwapWindow");
 			SDL_GL_SwapWindow(win);
+			pacer.EndFrame();
 		}
 
+		if (benchmark.enabled)
+		{
+			app.GetGpuProfiler().Flush();
+			pacer.Flush();
+			report.Write(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+			if (!report.CheckAllocations())
+				exitCode = 1;
+		}
+
+		if (CpuProfiler::WriteChromeTrace(CPU_TRACE_FILE))
+			std::cout << "CPU trace written to " << CPU_TRACE_FILE << std::endl;
+
 		// The object should clean after itself
 		app.Clean();
 	}	// the destructor of the app will run while our context is alive => destructors of classes including the GPU resources will run here too
@@ -224,5 +380,5 @@ int main( int argc, char* args[] )
 	SDL_GL_DeleteContext(context);
 	SDL_DestroyWindow( win );
 
-	return 0;
+	return exitCode;
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 420
+
+// Overdraw heat map: every fragment of the G-buffer pass adds one to its pixel's counter.
+// With early tests, fragments hidden by what is already in the depth buffer are not counted
+// (discarded fragments still write depth then, which is close enough for a debug view).
+layout(early_fragment_tests) in;
+
+layout(binding = 0, r32ui) uniform coherent uimage2D overdraw_count;
+
+#ifdef INSTANCED
+flat in float vs_out_fade;
+
+#include "dither.glsl"
+#endif
+
+void main()
+{
+#ifdef INSTANCED
+	if (vs_out_fade > DitherThreshold())
+		discard;
+#endif
+	imageAtomicAdd(overdraw_count, ivec2(gl_FragCoord.xy), 1u);
+}
@@ -0,0 +1,33 @@
+#version 400
+
+// Turns the overdraw counts into colours: black where nothing was drawn, then blue, green, yellow
+// and red as the count climbs to overdraw_max, white above it
+
+in vec2 vs_out_tex;
+
+out vec4 fs_out_col;
+
+uniform usampler2D overdraw_count;
+uniform float overdraw_max = 8.0;
+
+void main()
+{
+	uint count = texelFetch(overdraw_count, ivec2(gl_FragCoord.xy), 0).r;
+	if (count == 0u)
+	{
+		fs_out_col = vec4(0, 0, 0, 1);
+		return;
+	}
+
+	const vec3 ramp[4] = vec3[4](vec3(0, 0, 1), vec3(0, 1, 0), vec3(1, 1, 0), vec3(1, 0, 0));
+	float x = (float(count) - 1.0) / max(overdraw_max - 1.0, 1.0);
+	if (x > 1.0)
+	{
+		fs_out_col = vec4(1);
+		return;
+	}
+
+	float position = x * 3.0;
+	int segment = min(int(position), 2);
+	fs_out_col = vec4(mix(ramp[segment], ramp[segment + 1], position - float(segment)), 1);
+}
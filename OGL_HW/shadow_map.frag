@@ -1,5 +1,15 @@
 #version 400
 
+#if defined(DEPTH_PREPASS) && defined(INSTANCED)
+flat in float vs_out_fade;
+
+#include "dither.glsl"
+#endif
+
 void main()
 {
+#if defined(DEPTH_PREPASS) && defined(INSTANCED)
+	if (vs_out_fade > DitherThreshold())
+		discard;
+#endif
 }
\ No newline at end of file
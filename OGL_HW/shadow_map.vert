@@ -1,9 +1,42 @@
 #version 400
 
 layout(location = 0) in vec3 vs_in_pos;
-uniform mat4 MVP;
+#ifdef INSTANCED
+layout(location = 3) in mat4 vs_in_world;
+#endif
+
+uniform mat4 world = mat4(1, 0, 0, 0,
+						  0, 1, 0, 0,
+						  0, 0, 1, 0, 
+						  0, 0, 0, 1);
+
+#include "frame_uniforms.glsl"
+#include "impostor_fade.glsl"
+
+// DEPTH_PREPASS: the same position-only path, seen from the camera. The G-buffer pass then tests with
+// GL_EQUAL against this depth, so both must compute gl_Position in exactly the same way.
+#ifdef DEPTH_PREPASS
+invariant gl_Position;
+#ifdef INSTANCED
+// the pre-pass has to drop the same faded out pixels as forward.frag
+flat out float vs_out_fade;
+#endif
+#endif
 
 void main()
 {
-	gl_Position = MVP * vec4( vs_in_pos, 1 );
+#ifdef INSTANCED
+	mat4 model = vs_in_world;
+#else
+	mat4 model = world;
+#endif
+
+#ifdef DEPTH_PREPASS
+	gl_Position = viewProj * (model * vec4(vs_in_pos, 1));
+#ifdef INSTANCED
+	vs_out_fade = ImpostorFade(vs_in_world[3].xyz);
+#endif
+#else
+	gl_Position = lightViewProj * (model * vec4( vs_in_pos, 1 ));
+#endif
 }
\ No newline at end of file
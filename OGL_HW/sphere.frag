@@ -11,7 +11,7 @@ in block
 layout(location=0) out vec4 fs_out_color;
 layout(location=1) out vec3 fs_out_normal;
 
-uniform vec3 eye_pos;
+#include "frame_uniforms.glsl"
 
 uniform float patch_boundary_width = 0.015f;
 
@@ -1,8 +1,9 @@
 #version 420
 
-uniform vec3 lightPoints[100];
-uniform float lightRads[100];
-uniform vec3 lightColors[100];
+// one vertex per light, see LightMarker in MyApp.h
+layout(location = 0) in vec3 vs_in_pos;
+layout(location = 1) in float vs_in_rad;
+layout(location = 2) in vec3 vs_in_color;
 
 // a pipeline-ban tovbb adand rtkek
 out block
@@ -14,7 +15,7 @@ out block
 
 void main()
 {
-	Out.pos		= lightPoints[gl_VertexID];
-	Out.rad		= lightRads[gl_VertexID];
-	Out.color	= lightColors[gl_VertexID];
+	Out.pos		= vs_in_pos;
+	Out.rad		= vs_in_rad;
+	Out.color	= vs_in_color;
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#version 400
+
+in block
+{
+	vec3	quad_pos;
+	flat vec3	center;
+	flat float	rad;
+	flat vec3	color;
+} In;
+
+layout(location=0) out vec4 fs_out_color;
+layout(location=1) out vec3 fs_out_normal;
+
+#include "frame_uniforms.glsl"
+
+void main()
+{
+	// ray from the eye through this fragment of the quad, intersected with the sphere
+	vec3 dir = normalize(In.quad_pos - eye_pos);
+	vec3 oc = eye_pos - In.center;
+	float b = dot(oc, dir);
+	float c = dot(oc, oc) - In.rad * In.rad;
+	float discriminant = b * b - c;
+	if (discriminant < 0)
+		discard;
+
+	vec3 hit = eye_pos + (-b - sqrt(discriminant)) * dir;
+	vec3 n = (hit - In.center) / In.rad;
+
+	// the quad lies in the middle of the sphere, so the depth has to come from the hit point
+	vec4 clip = viewProj * vec4(hit, 1);
+	gl_FragDepth = 0.5 * (clip.z / clip.w) + 0.5;
+
+	// same look as the tessellated spheres: middle of lights are almost white
+	vec3 additionalLightness = vec3(pow(dot(n, normalize(eye_pos - hit)), 3));
+	fs_out_color = vec4(In.color + additionalLightness, 1.0f);
+	// zero normal marks the pixel as a light source for the lighting passes
+	fs_out_normal = vec3(0);
+}
@@ -0,0 +1,43 @@
+#version 400
+
+// one instance per light, see LightMarker in MyApp.h
+layout(location = 0) in vec3 vs_in_pos;
+layout(location = 1) in float vs_in_rad;
+layout(location = 2) in vec3 vs_in_color;
+
+out block
+{
+	vec3	quad_pos;
+	flat vec3	center;
+	flat float	rad;
+	flat vec3	color;
+} Out;
+
+#include "frame_uniforms.glsl"
+
+vec2 corners[4] = vec2[4](
+	vec2(-1,-1),
+	vec2( 1,-1),
+	vec2(-1, 1),
+	vec2( 1, 1)
+);
+
+void main()
+{
+	vec3 toEye = eye_pos - vs_in_pos;
+	float dist = length(toEye);
+
+	// the quad faces the eye and is just large enough to cover the silhouette cone of the sphere
+	vec3 forward = toEye / dist;
+	vec3 right = normalize(cross(abs(forward.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0), forward));
+	vec3 up = cross(forward, right);
+	float halfSize = dist > vs_in_rad ? vs_in_rad * dist / sqrt(dist * dist - vs_in_rad * vs_in_rad) : 0.0;
+
+	vec3 pos = vs_in_pos + halfSize * (corners[gl_VertexID].x * right + corners[gl_VertexID].y * up);
+	gl_Position = viewProj * vec4(pos, 1);
+
+	Out.quad_pos	= pos;
+	Out.center		= vs_in_pos;
+	Out.rad			= vs_in_rad;
+	Out.color		= vs_in_color;
+}